@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# dispatch.sh
+#
+# Compares instructions/second of table, threaded and compact dispatch.
+# When perf is installed also reports instruction cache misses.
+#
+# usage: bench/dispatch.sh [program.pg] [runs]
+#
+PLG=${PLG:-./plg}
+PROGRAM=${1:-bench/count.pg}
+RUNS=${2:-5}
+
+for mode in table threaded compact
+do
+    i=0
+    while [ $i -lt $RUNS ]
+    do
+        $PLG --stats --dispatch=$mode $PROGRAM 2>&1 >/dev/null |
+            awk -v mode=$mode '/^instructions\/second/ { print mode, $3 }'
+        i=$((i + 1))
+    done
+done | sort -k1,1 -k2,2n | awk '
+    { v[$1, ++n[$1]] = $2 }
+    END {
+        for (m in n) {
+            printf "%-8s median %d instructions/second (%d runs)\n", m, v[m, int((n[m] + 1) / 2)], n[m]
+        }
+    }'
+
+if command -v perf >/dev/null 2>&1
+then
+    for mode in table threaded compact
+    do
+        perf stat -x, -e instructions,L1-icache-load-misses \
+            $PLG --dispatch=$mode $PROGRAM 2>&1 >/dev/null |
+            awk -F, -v mode=$mode '/icache|instructions/ { printf "%-8s %s %s\n", mode, $3, $1 }'
+    done
+fi
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# ngrams.sh
+#
+# Counts executed instruction pairs and triples over benchmark programs
+# and prints the most frequent ones, candidates for superinstructions.
+#
+# usage: bench/ngrams.sh [program.pg ...]
+#
+#   PLG   interpreter (default ./plg)
+#   TOP   sequences printed (default 30)
+#
+PLG=${PLG:-./plg}
+TOP=${TOP:-30}
+
+if [ $# -eq 0 ]
+then
+    set -- bench/nrev.pg bench/nqueens.pg bench/tak.pg bench/fib.pg bench/deriv.pg \
+           bench/zebra.pg bench/crypt.pg bench/join.pg bench/unify.pg
+fi
+
+NGRAMS=/tmp/plg_ngrams_$$
+trap 'rm -f $NGRAMS $NGRAMS.all' EXIT
+
+for program in "$@"
+do
+    if ! $PLG --ngrams=$NGRAMS $program >/dev/null
+    then
+        echo "$(basename $program .pg): run failed" >&2
+        exit 1
+    fi
+    cat $NGRAMS >>$NGRAMS.all
+done
+
+awk '
+    { key = $2; for (i = 3; i <= NF; i++) key = key " " $i; count[key] += $1; total[NF - 1] += $1 }
+    END {
+        for (key in count) {
+            n = split(key, ops, " ")
+            name = key; gsub(/BYTECODE_/, "", name)
+            printf "%d %12d %6.2f%%  %s\n", n, count[key], 100.0 * count[key] / total[n], name
+        }
+    }' $NGRAMS.all | sort -k1,1n -k2,2nr | awk -v top=$TOP '
+    $1 != n { n = $1; shown = 0; printf "%s\n", n == 2 ? "pairs" : "triples" }
+    shown < top { shown++; $1 = ""; print }'
@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+# run.sh
+#
+# Runs benchmark programs several times and reports median time, LIPS
+# (logical inferences per second) and peak heap/stack/trail use.
+# Results are also written as JSON to $JSON for comparing versions.
+#
+# usage: bench/run.sh [program.pg ...]
+#
+#   PLG   interpreter (default ./plg)
+#   RUNS  runs of each program (default 5)
+#   JSON  machine readable results (default bench/results.json)
+#
+PLG=${PLG:-./plg}
+RUNS=${RUNS:-5}
+JSON=${JSON:-bench/results.json}
+
+if [ $# -eq 0 ]
+then
+    set -- bench/nrev.pg bench/nqueens.pg bench/tak.pg bench/fib.pg bench/deriv.pg \
+           bench/zebra.pg bench/crypt.pg bench/join.pg bench/unify.pg \
+           bench/lists.pg bench/lists_pl.pg bench/answers.pg
+fi
+
+VERSION=$(git describe --always --dirty 2>/dev/null || echo unknown)
+STATS=/tmp/plg_bench_$$
+trap 'rm -f $STATS $STATS.runs' EXIT
+
+for program in "$@"
+do
+    name=$(basename $program .pg)
+    i=0
+    while [ $i -lt $RUNS ]
+    do
+        if ! $PLG --stats $program 2>$STATS >/dev/null
+        then
+            echo "$name: run failed" >&2
+            cat $STATS >&2
+            exit 1
+        fi
+        awk -v name=$name '
+            /^time /              { time = $3 }
+            /^inferences /        { calls = $3 }
+            /^peak stack /        { stack = $4 }
+            /^peak trail /        { trail = $4 }
+            /^gc peak heap cells/ { heap = $6 }
+            END { print name, time, calls, heap, stack, trail }' $STATS >>$STATS.runs
+        i=$((i + 1))
+    done
+done
+
+sort -k1,1 -k2,2g $STATS.runs | awk -v runs=$RUNS -v json=$JSON -v version=$VERSION '
+    {
+        if (!($1 in n)) { order[++count] = $1 }
+        n[$1]++
+        time[$1, n[$1]] = $2
+        calls[$1] = $3
+        if ($4 > heap[$1]) heap[$1] = $4
+        if ($5 > stack[$1]) stack[$1] = $5
+        if ($6 > trail[$1]) trail[$1] = $6
+    }
+    END {
+        printf "%-10s %12s %12s %12s %10s %10s %10s\n",
+               "benchmark", "median s", "inferences", "LIPS", "heap", "stack", "trail"
+        printf "{\n  \"version\": \"%s\",\n  \"runs\": %d,\n  \"benchmarks\": [", version, runs > json
+        for (i = 1; i <= count; i++)
+        {
+            b = order[i]
+            median = time[b, int((n[b] + 1) / 2)]
+            lips = median > 0 ? calls[b] / median : 0
+            printf "%-10s %12.6f %12d %12.0f %10d %10d %10d\n",
+                   b, median, calls[b], lips, heap[b], stack[b], trail[b]
+            printf "%s\n    { \"name\": \"%s\", \"median_time\": %.6f, \"inferences\": %d, " \
+                   "\"lips\": %.0f, \"peak_heap\": %d, \"peak_stack\": %d, \"peak_trail\": %d }",
+                   (i > 1 ? "," : ""), b, median, calls[b], lips, heap[b], stack[b], trail[b] > json
+        }
+        printf "\n  ]\n}\n" > json
+    }'
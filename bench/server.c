@@ -0,0 +1,191 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "libplg.h"
+
+/**
+ * Query server benchmark. One compiled program is shared by worker threads,
+ * each query compiles its own goal, runs on its own machine and all its
+ * solutions are read. Goals of queries differ, queens(N, [Q|Qs]) with N
+ * and first queen Q taken from the number of the query, so program must
+ * define queens/2 as bench/server.pg does. The same queries are answered
+ * with 1, 2, 4, ... threads and throughput is compared with one thread.
+ *
+ * usage: bench/server [-t max_threads] [-n queries] program.pg
+ */
+typedef struct server_worker {
+    pthread_t thread;
+    plg_program * program_value;
+    unsigned int first; /* number of first query */
+    unsigned int queries;
+    unsigned long solutions;
+    unsigned int errors;
+} server_worker;
+
+static void * server_worker_run(void * arg)
+{
+    server_worker * worker = (server_worker *)arg;
+    unsigned int i;
+
+    for (i = 0; i < worker->queries; i++)
+    {
+        unsigned int n = worker->first + i;
+        unsigned int size = 4 + n % 4;
+        char goal[64];
+        plg_query * query_value = NULL;
+        const plg_solution * solution = NULL;
+        plg_result result;
+
+        snprintf(goal, sizeof(goal), "queens(%u, [%u|Qs])", size, 1 + n / 4 % size);
+        query_value = plg_query_open(worker->program_value, goal);
+        if (query_value == NULL)
+        {
+            worker->errors++;
+            continue;
+        }
+        while ((result = plg_next_solution(query_value, &solution)) == PLG_SOLUTION)
+        {
+            worker->solutions++;
+        }
+        if (result == PLG_ERROR)
+        {
+            worker->errors++;
+        }
+        plg_query_close(query_value);
+    }
+
+    return NULL;
+}
+
+static double server_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* answers queries with threads workers, returns wall time in seconds */
+static double server_run(plg_program * program_value, unsigned int threads, unsigned int queries,
+                         unsigned long * solutions, unsigned int * errors)
+{
+    server_worker * workers = (server_worker *)calloc(threads, sizeof(server_worker));
+    unsigned int first = 0;
+    double start, end;
+    unsigned int i;
+
+    start = server_now();
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].program_value = program_value;
+        workers[i].first = first;
+        workers[i].queries = queries / threads + (i < queries % threads ? 1 : 0);
+        first += workers[i].queries;
+        pthread_create(&workers[i].thread, NULL, server_worker_run, &workers[i]);
+    }
+    *solutions = 0;
+    *errors = 0;
+    for (i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        *solutions += workers[i].solutions;
+        *errors += workers[i].errors;
+    }
+    end = server_now();
+
+    free(workers);
+
+    return end - start;
+}
+
+int main(int argc, char * argv[])
+{
+    int opt;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_threads = cores > 0 ? (unsigned int)cores : 1;
+    unsigned int queries = 500;
+    unsigned int threads;
+    double base = 0.0;
+    plg_program * program_value = NULL;
+
+    while ((opt = getopt(argc, argv, "t:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                max_threads = (unsigned int)atoi(optarg);
+            break;
+            case 'n':
+                queries = (unsigned int)atoi(optarg);
+            break;
+            default:
+                fprintf(stderr, "usage: %s [-t max_threads] [-n queries] program.pg\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || max_threads == 0 || queries == 0)
+    {
+        fprintf(stderr, "usage: %s [-t max_threads] [-n queries] program.pg\n", argv[0]);
+        return 1;
+    }
+
+    program_value = plg_load_file(argv[optind]);
+    if (program_value == NULL)
+    {
+        fprintf(stderr, "cannot load %s\n", argv[optind]);
+        return 1;
+    }
+
+    printf("%-8s %10s %12s %12s %8s\n", "threads", "time s", "queries/s", "solutions", "speedup");
+    for (threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+    {
+        unsigned long solutions = 0;
+        unsigned int errors = 0;
+        double time = server_run(program_value, threads, queries, &solutions, &errors);
+
+        if (threads == 1)
+        {
+            base = time;
+        }
+        printf("%-8u %10.3f %12.0f %12lu %8.2f\n",
+               threads, time, queries / time, solutions, time > 0 ? base / time : 0.0);
+        if (errors > 0)
+        {
+            fprintf(stderr, "%u queries failed\n", errors);
+            plg_program_delete(program_value);
+            return 1;
+        }
+        if (threads == max_threads)
+        {
+            break;
+        }
+    }
+
+    plg_program_delete(program_value);
+
+    return 0;
+}
@@ -19,34 +19,701 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <assert.h>
 #include "builtin.h"
+#include "object.h"
+#include "vm.h"
 
-clause * builtin_write()
+static var_list * builtin_vars(unsigned int n, const char ** names)
 {
+    unsigned int i;
     var_list * vars = var_list_new();
-    var_list_add_end(vars, var_new(strdup("X")));
 
-    goal_list * goals = goal_list_new();
-    goal_list_add_end(goals, goal_new_builtin(BUILT_IN_WRITE));
+    for (i = 0; i < n; i++)
+    {
+        var_list_add_end(vars, var_new(strdup(names[i])));
+    }
+    return vars;
+}
+
+static term * builtin_var(const char * name)
+{
+    return term_new_var(TERM_TYPE_VAR, var_new(strdup(name)));
+}
+
+static term * builtin_nil()
+{
+    return term_new_basic(TERM_TYPE_ATOM, strdup("[]"));
+}
+
+/* [head|tail] */
+static term * builtin_cons(term * head, term * tail)
+{
+    term_list * terms = term_list_new();
+    term_list_add_end(terms, head);
 
-    return clause_new(strdup("write"), vars, goals);
+    return term_new_list_constructor(terms, tail);
 }
 
-clause * builtin_nl()
+static goal * builtin_unify(const char * name, term * value)
 {
+    return goal_new_unification(var_new(strdup(name)), value);
+}
+
+static goal * builtin_call(const char * name, unsigned int n, term ** args)
+{
+    unsigned int i;
+    term_list * terms = term_list_new();
+
+    for (i = 0; i < n; i++)
+    {
+        term_list_add_end(terms, args[i]);
+    }
+    return goal_new_literal(strdup(name), terms);
+}
+
+/* name(Args) <= builtin, followed by $name(Args) when there is ProL version */
+static clause * builtin_clause(const builtin_desc * desc)
+{
+    unsigned int i;
+    char name[16];
+    var_list * vars = var_list_new();
+    term_list * terms = term_list_new();
     goal_list * goals = goal_list_new();
-    goal_list_add_end(goals, goal_new_builtin(BUILT_IN_NL));
 
-    return clause_new(strdup("nl"), NULL, goals);
+    for (i = 0; i < desc->arity; i++)
+    {
+        sprintf(name, "A%u", i + 1);
+        var_list_add_end(vars, var_new(strdup(name)));
+        term_list_add_end(terms, builtin_var(name));
+    }
+
+    goal_list_add_end(goals, goal_new_builtin(desc->id));
+    if (desc->add_clauses != NULL)
+    {
+        char * fallback = (char *)malloc(strlen(desc->name) + 2);
+        sprintf(fallback, "$%s", desc->name);
+        goal_list_add_end(goals, goal_new_literal(fallback, terms));
+    }
+    else
+    {
+        term_list_delete(terms);
+    }
+
+    return clause_new(strdup(desc->name), vars, goals);
 }
 
-void builtin_add_all(clause_list * clauses)
+/*
+ * $append(X, Y, Z) <= X = [], Y = Z
+ * $append(X, Y, Z) <= X = [H|T], Z = [H|R], $append(T, Y, R)
+ */
+static void builtin_append_clauses(clause_list * clauses)
+{
+    const char * names[] = { "X", "Y", "Z" };
+    goal_list * goals;
+
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("X", builtin_nil()));
+    goal_list_add_end(goals, builtin_unify("Y", builtin_var("Z")));
+    clause_list_add_end(clauses, clause_new(strdup("$append"), builtin_vars(3, names), goals));
+
+    term * args[] = { builtin_var("T"), builtin_var("Y"), builtin_var("R") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("X", builtin_cons(builtin_var("H"), builtin_var("T"))));
+    goal_list_add_end(goals, builtin_unify("Z", builtin_cons(builtin_var("H"), builtin_var("R"))));
+    goal_list_add_end(goals, builtin_call("$append", 3, args));
+    clause_list_add_end(clauses, clause_new(strdup("$append"), builtin_vars(3, names), goals));
+}
+
+/*
+ * $member(X, L) <= L = [X|T]
+ * $member(X, L) <= L = [H|T], $member(X, T)
+ */
+static void builtin_member_clauses(clause_list * clauses)
+{
+    const char * names[] = { "X", "L" };
+    goal_list * goals;
+
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("X"), builtin_var("T"))));
+    clause_list_add_end(clauses, clause_new(strdup("$member"), builtin_vars(2, names), goals));
+
+    term * args[] = { builtin_var("X"), builtin_var("T") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("H"), builtin_var("T"))));
+    goal_list_add_end(goals, builtin_call("$member", 2, args));
+    clause_list_add_end(clauses, clause_new(strdup("$member"), builtin_vars(2, names), goals));
+}
+
+/*
+ * $length(L, N) <= L = [], N = 0
+ * $length(L, N) <= L = [H|T], $length(T, M), N is M + 1
+ */
+static void builtin_length_clauses(clause_list * clauses)
+{
+    const char * names[] = { "L", "N" };
+    goal_list * goals;
+
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_nil()));
+    goal_list_add_end(goals, builtin_unify("N", term_new_int(TERM_TYPE_INT, 0)));
+    clause_list_add_end(clauses, clause_new(strdup("$length"), builtin_vars(2, names), goals));
+
+    term * args[] = { builtin_var("T"), builtin_var("M") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("H"), builtin_var("T"))));
+    goal_list_add_end(goals, builtin_call("$length", 2, args));
+    goal_list_add_end(goals, goal_new_is(var_new(strdup("N")),
+                                         expr_new_add(expr_new_var(var_new(strdup("M"))), expr_new_int(1))));
+    clause_list_add_end(clauses, clause_new(strdup("$length"), builtin_vars(2, names), goals));
+}
+
+/*
+ * $reverse(L, R) <= $reverse(L, [], R)
+ * $reverse(L, A, R) <= L = [], R = A
+ * $reverse(L, A, R) <= L = [H|T], $reverse(T, [H|A], R)
+ */
+static void builtin_reverse_clauses(clause_list * clauses)
+{
+    const char * names[] = { "L", "R" };
+    const char * acc_names[] = { "L", "A", "R" };
+    goal_list * goals;
+
+    term * args[] = { builtin_var("L"), builtin_nil(), builtin_var("R") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_call("$reverse", 3, args));
+    clause_list_add_end(clauses, clause_new(strdup("$reverse"), builtin_vars(2, names), goals));
+
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_nil()));
+    goal_list_add_end(goals, builtin_unify("R", builtin_var("A")));
+    clause_list_add_end(clauses, clause_new(strdup("$reverse"), builtin_vars(3, acc_names), goals));
+
+    term * acc_args[] = { builtin_var("T"), builtin_cons(builtin_var("H"), builtin_var("A")), builtin_var("R") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("H"), builtin_var("T"))));
+    goal_list_add_end(goals, builtin_call("$reverse", 3, acc_args));
+    clause_list_add_end(clauses, clause_new(strdup("$reverse"), builtin_vars(3, acc_names), goals));
+}
+
+/*
+ * first element of list is at N = 1
+ * $nth(N, L, X) <= $nth(L, 1, N, X)
+ * $nth(L, I, N, X) <= L = [X|T], N = I
+ * $nth(L, I, N, X) <= L = [H|T], J is I + 1, $nth(T, J, N, X)
+ */
+static void builtin_nth_clauses(clause_list * clauses)
+{
+    const char * names[] = { "N", "L", "X" };
+    const char * acc_names[] = { "L", "I", "N", "X" };
+    goal_list * goals;
+
+    term * args[] = { builtin_var("L"), term_new_int(TERM_TYPE_INT, 1), builtin_var("N"), builtin_var("X") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_call("$nth", 4, args));
+    clause_list_add_end(clauses, clause_new(strdup("$nth"), builtin_vars(3, names), goals));
+
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("X"), builtin_var("T"))));
+    goal_list_add_end(goals, builtin_unify("N", builtin_var("I")));
+    clause_list_add_end(clauses, clause_new(strdup("$nth"), builtin_vars(4, acc_names), goals));
+
+    term * acc_args[] = { builtin_var("T"), builtin_var("J"), builtin_var("N"), builtin_var("X") };
+    goals = goal_list_new();
+    goal_list_add_end(goals, builtin_unify("L", builtin_cons(builtin_var("H"), builtin_var("T"))));
+    goal_list_add_end(goals, goal_new_is(var_new(strdup("J")),
+                                         expr_new_add(expr_new_var(var_new(strdup("I"))), expr_new_int(1))));
+    goal_list_add_end(goals, builtin_call("$nth", 4, acc_args));
+    clause_list_add_end(clauses, clause_new(strdup("$nth"), builtin_vars(4, acc_names), goals));
+}
+
+/* program clause with the same name and arity */
+static char builtin_is_defined(clause_list * clauses, const char * name, unsigned int arity)
+{
+    clause_node * node = clauses->head;
+    while (node != NULL)
+    {
+        if (node->value != NULL &&
+            strcmp(node->value->name, name) == 0 &&
+            clause_arity(node->value) == arity)
+        {
+            return 1;
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+/* variables of term in order of first occurrence */
+static void builtin_term_vars(term * value, var_list * vars)
 {
-    clause_list_add_end(clauses, builtin_write());
-    clause_list_add_end(clauses, builtin_nl());
+    var_node * node = NULL;
+    term * arg = NULL;
+
+    switch (value->type)
+    {
+        case TERM_TYPE_VAR:
+            for (node = vars->head; node != NULL; node = node->next)
+            {
+                if (strcmp(node->value->name, value->t_var.value->name) == 0)
+                {
+                    return;
+                }
+            }
+            var_list_add_end(vars, var_new(strdup(value->t_var.value->name)));
+        break;
+        case TERM_TYPE_STRUCT:
+            for (arg = value->t_struct.terms ? value->t_struct.terms->head : NULL; arg != NULL; arg = arg->next)
+            {
+                builtin_term_vars(arg, vars);
+            }
+        break;
+        default:
+        break;
+    }
 }
 
+/**
+ * once(p(Args)) becomes call of $onceN(Vars) defined as
+ * $onceN(Vars) <= p(Args), ! so choice points left by p are cut.
+ */
+static void builtin_once_goals(clause_list * clauses, goal_list * goals, unsigned int * count)
+{
+    goal * value = NULL;
 
+    for (value = goals != NULL ? goals->head : NULL; value != NULL; value = value->next)
+    {
+        char name[32];
+        term * arg = NULL;
+        goal * body_literal = NULL;
+        var_node * node = NULL;
+        var_list * vars = NULL;
+        term_list * terms = NULL;
+        goal_list * body = NULL;
 
+        if (value->type != GOAL_TYPE_LITERAL || strcmp(value->literal.name, "once") != 0 ||
+            value->literal.terms == NULL || value->literal.terms->size != 1)
+        {
+            continue;
+        }
 
+        arg = value->literal.terms->head;
+        if (arg->type == TERM_TYPE_STRUCT)
+        {
+            body_literal = goal_new_literal(arg->t_struct.name, arg->t_struct.terms);
+            vars = var_list_new();
+            builtin_term_vars(arg, vars);
+            arg->t_struct.name = NULL;
+            arg->t_struct.terms = NULL;
+        }
+        else if (arg->type == TERM_TYPE_ATOM)
+        {
+            body_literal = goal_new_literal(arg->t_basic.name, NULL);
+            arg->t_basic.name = NULL;
+        }
+        else
+        {
+            continue;
+        }
+        body_literal->line_no = value->line_no;
+
+        body = goal_list_new();
+        goal_list_add_end(body, body_literal);
+        goal_list_add_end(body, goal_new_cut());
+
+        if (vars != NULL && vars->size > 0)
+        {
+            terms = term_list_new();
+            for (node = vars->head; node != NULL; node = node->next)
+            {
+                term_list_add_end(terms, builtin_var(node->value->name));
+            }
+        }
+        else if (vars != NULL)
+        {
+            var_list_delete(vars);
+            vars = NULL;
+        }
+
+        sprintf(name, "$once%u", ++(*count));
+        term_list_delete(value->literal.terms);
+        free(value->literal.name);
+        value->literal.name = strdup(name);
+        value->literal.terms = terms;
+
+        clause_list_add_end(clauses, clause_new(strdup(name), vars, body));
+    }
+}
+
+/* rewrites once/1 goals unless program defines once/1, clauses added here are rewritten too */
+void builtin_add_once(clause_list * clauses, query * query_value)
+{
+    unsigned int count = 0;
+    clause_node * node = NULL;
+
+    if (builtin_is_defined(clauses, "once", 1))
+    {
+        return;
+    }
+
+    if (query_value != NULL)
+    {
+        builtin_once_goals(clauses, query_value->goals, &count);
+    }
+    for (node = clauses->head; node != NULL; node = node->next)
+    {
+        if (node->value != NULL)
+        {
+            builtin_once_goals(clauses, node->value->goals, &count);
+        }
+    }
+}
+
+/* argument i of called predicate, counted from 0 */
+static heap_ptr builtin_arg(vm * machine, stack_ptr args, unsigned int i)
+{
+    return vm_execute_deref(machine, machine->stack[args + i].addr);
+}
+
+static builtin_result builtin_write_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    writer_term(machine->out, machine->collector, builtin_arg(machine, args, 0));
+
+    return BUILTIN_DET;
+}
+
+static builtin_result builtin_nl_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    writer_str(machine->out, "\n");
+
+    return BUILTIN_DET;
+}
+
+static char builtin_is_cons(gc * collector, heap_ptr ref)
+{
+    return gc_get_object_type(collector, ref) == OBJECT_STRUCT &&
+           gc_get_struct_addr(collector, ref) == BUILTIN_LIST_ADDR &&
+           gc_get_struct_size(collector, ref) == 2;
+}
+
+static char builtin_is_nil(gc * collector, heap_ptr ref, atom_idx_t nil)
+{
+    return gc_get_object_type(collector, ref) == OBJECT_ATOM &&
+           gc_get_atom_idx(collector, ref) == nil;
+}
+
+static heap_ptr builtin_head(vm * machine, heap_ptr cell)
+{
+    return vm_execute_deref(machine, gc_get_struct_ref(machine->collector, cell, 0));
+}
+
+static heap_ptr builtin_tail(vm * machine, heap_ptr cell)
+{
+    return vm_execute_deref(machine, gc_get_struct_ref(machine->collector, cell, 1));
+}
+
+/* number of list cells from ref, end is the dereferenced term after them */
+static unsigned int builtin_list_walk(vm * machine, heap_ptr ref, heap_ptr * end)
+{
+    unsigned int length = 0;
+
+    while (builtin_is_cons(machine->collector, ref))
+    {
+        ref = builtin_tail(machine, ref);
+        length++;
+    }
+    *end = ref;
+    return length;
+}
+
+/* new list cell [head|tail], 0 when heap is full */
+static heap_ptr builtin_cons_alloc(vm * machine, heap_ptr head, heap_ptr tail)
+{
+    heap_ptr cell = gc_alloc_struct(machine->collector, 2, BUILTIN_LIST_ADDR);
+    if (cell == 0)
+    {
+        machine->state = VM_ERROR_OUT_OF_MEMORY;
+        return 0;
+    }
+    gc_set_struct_ref(machine->collector, cell, 0, head);
+    gc_set_struct_ref(machine->collector, cell, 1, tail);
+    return cell;
+}
+
+static heap_ptr builtin_nil_alloc(vm * machine, atom_idx_t nil)
+{
+    heap_ptr ref = gc_alloc_atom(machine->collector, nil);
+    if (ref == 0)
+    {
+        machine->state = VM_ERROR_OUT_OF_MEMORY;
+    }
+    return ref;
+}
+
+static builtin_result builtin_unify_result(vm * machine, heap_ptr ref_u, heap_ptr ref_v)
+{
+    if (machine->state != VM_RUNNING || !vm_execute_unify(machine, ref_u, ref_v))
+    {
+        return BUILTIN_FAIL;
+    }
+    return BUILTIN_DET;
+}
+
+/* test of outermost functor, 0 when terms cannot unify */
+static char builtin_may_unify(gc * collector, heap_ptr ref_u, heap_ptr ref_v)
+{
+    object_type type = gc_get_object_type(collector, ref_u);
+
+    if (type == OBJECT_REF || gc_get_object_type(collector, ref_v) == OBJECT_REF)
+    {
+        return 1;
+    }
+    if (type != gc_get_object_type(collector, ref_v))
+    {
+        return 0;
+    }
+    switch (type)
+    {
+        case OBJECT_ATOM:
+            return gc_get_atom_idx(collector, ref_u) == gc_get_atom_idx(collector, ref_v);
+        case OBJECT_INT:
+            return gc_get_int_value(collector, ref_u) == gc_get_int_value(collector, ref_v);
+        case OBJECT_STRUCT:
+            return gc_get_struct_addr(collector, ref_u) == gc_get_struct_addr(collector, ref_v) &&
+                   gc_get_struct_size(collector, ref_u) == gc_get_struct_size(collector, ref_v);
+        default:
+            return 1;
+    }
+}
+
+/* deterministic when X is a proper list, Z is a copy of X ending with Y */
+static builtin_result builtin_append_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    heap_ptr x = builtin_arg(machine, args, 0);
+    heap_ptr end = 0;
+    heap_ptr first = 0;
+    heap_ptr last = 0;
+
+    builtin_list_walk(machine, x, &end);
+    if (!builtin_is_nil(machine->collector, end, nil))
+    {
+        return BUILTIN_NONDET;
+    }
+
+    first = builtin_arg(machine, args, 1);
+    for (; builtin_is_cons(machine->collector, x); x = builtin_tail(machine, x))
+    {
+        heap_ptr cell = builtin_cons_alloc(machine, builtin_head(machine, x), builtin_arg(machine, args, 1));
+        if (cell == 0)
+        {
+            return BUILTIN_FAIL;
+        }
+        if (last == 0)
+        {
+            first = cell;
+        }
+        else
+        {
+            gc_set_struct_ref(machine->collector, last, 1, cell);
+        }
+        last = cell;
+    }
+
+    return builtin_unify_result(machine, first, builtin_arg(machine, args, 2));
+}
+
+/**
+ * Deterministic when L is a proper list with at most one element whose
+ * outermost functor matches X. Duplicates leave several solutions which
+ * ProL version enumerates.
+ */
+static builtin_result builtin_member_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    heap_ptr x = builtin_arg(machine, args, 0);
+    heap_ptr list = builtin_arg(machine, args, 1);
+    heap_ptr match = 0;
+    unsigned int count = 0;
+
+    for (; builtin_is_cons(machine->collector, list); list = builtin_tail(machine, list))
+    {
+        heap_ptr head = builtin_head(machine, list);
+        if (builtin_may_unify(machine->collector, x, head))
+        {
+            if (++count > 1)
+            {
+                return BUILTIN_NONDET;
+            }
+            match = head;
+        }
+    }
+    if (!builtin_is_nil(machine->collector, list, nil))
+    {
+        return BUILTIN_NONDET;
+    }
+    if (count == 0)
+    {
+        return BUILTIN_FAIL;
+    }
+
+    return builtin_unify_result(machine, x, match);
+}
+
+/**
+ * Deterministic when L is a proper list, or a partial list and N is an
+ * integer, then L is completed with fresh variables.
+ */
+static builtin_result builtin_length_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    heap_ptr end = 0;
+    heap_ptr n = builtin_arg(machine, args, 1);
+    unsigned int length = builtin_list_walk(machine, builtin_arg(machine, args, 0), &end);
+
+    if (builtin_is_nil(machine->collector, end, nil))
+    {
+        heap_ptr ref = gc_alloc_int(machine->collector, (int)length);
+        if (ref == 0)
+        {
+            machine->state = VM_ERROR_OUT_OF_MEMORY;
+            return BUILTIN_FAIL;
+        }
+        return builtin_unify_result(machine, n, ref);
+    }
+    if (gc_get_object_type(machine->collector, end) != OBJECT_REF)
+    {
+        return BUILTIN_FAIL;
+    }
+    if (gc_get_object_type(machine->collector, n) != OBJECT_INT)
+    {
+        return BUILTIN_NONDET;
+    }
+    if (gc_get_int_value(machine->collector, n) < (int)length)
+    {
+        return BUILTIN_FAIL;
+    }
+
+    heap_ptr tail = builtin_nil_alloc(machine, nil);
+    for (length = gc_get_int_value(machine->collector, n) - length; length > 0 && tail != 0; length--)
+    {
+        heap_ptr var = gc_alloc_var(machine->collector);
+        tail = var != 0 ? builtin_cons_alloc(machine, var, tail) : 0;
+    }
+    if (tail == 0)
+    {
+        machine->state = VM_ERROR_OUT_OF_MEMORY;
+        return BUILTIN_FAIL;
+    }
+
+    return builtin_unify_result(machine, end, tail);
+}
+
+/* deterministic when L is a proper list */
+static builtin_result builtin_reverse_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    heap_ptr end = 0;
+    heap_ptr list = builtin_arg(machine, args, 0);
+    heap_ptr reversed = 0;
+
+    builtin_list_walk(machine, list, &end);
+    if (!builtin_is_nil(machine->collector, end, nil))
+    {
+        return gc_get_object_type(machine->collector, end) == OBJECT_REF ? BUILTIN_NONDET : BUILTIN_FAIL;
+    }
+
+    reversed = builtin_nil_alloc(machine, nil);
+    for (; reversed != 0 && builtin_is_cons(machine->collector, list); list = builtin_tail(machine, list))
+    {
+        reversed = builtin_cons_alloc(machine, builtin_head(machine, list), reversed);
+    }
+    if (reversed == 0)
+    {
+        return BUILTIN_FAIL;
+    }
+
+    return builtin_unify_result(machine, reversed, builtin_arg(machine, args, 1));
+}
+
+/* deterministic when N is an integer and L has N cells */
+static builtin_result builtin_nth_execute(vm * machine, stack_ptr args, atom_idx_t nil)
+{
+    heap_ptr n = builtin_arg(machine, args, 0);
+    heap_ptr list = builtin_arg(machine, args, 1);
+    int i;
+
+    if (gc_get_object_type(machine->collector, n) != OBJECT_INT)
+    {
+        return BUILTIN_NONDET;
+    }
+    for (i = gc_get_int_value(machine->collector, n); i > 1 && builtin_is_cons(machine->collector, list); i--)
+    {
+        list = builtin_tail(machine, list);
+    }
+    if (i < 1)
+    {
+        return BUILTIN_FAIL;
+    }
+    if (builtin_is_cons(machine->collector, list))
+    {
+        return builtin_unify_result(machine, builtin_head(machine, list), builtin_arg(machine, args, 2));
+    }
+
+    return gc_get_object_type(machine->collector, list) == OBJECT_REF ? BUILTIN_NONDET : BUILTIN_FAIL;
+}
+
+/* indexed by builtin_type */
+static const builtin_desc builtin_table[] = {
+    { BUILT_IN_UKNOWN, NULL, 0, 0, 0, NULL, NULL },
+    { BUILT_IN_WRITE, "write", 1, 1, 0, builtin_write_execute, NULL },
+    { BUILT_IN_NL, "nl", 0, 1, 0, builtin_nl_execute, NULL },
+    { BUILT_IN_APPEND, "append", 3, 0, 1, builtin_append_execute, builtin_append_clauses },
+    { BUILT_IN_MEMBER, "member", 2, 0, 1, builtin_member_execute, builtin_member_clauses },
+    { BUILT_IN_LENGTH, "length", 2, 0, 1, builtin_length_execute, builtin_length_clauses },
+    { BUILT_IN_REVERSE, "reverse", 2, 0, 1, builtin_reverse_execute, builtin_reverse_clauses },
+    { BUILT_IN_NTH, "nth", 3, 0, 1, builtin_nth_execute, builtin_nth_clauses }
+};
+
+const builtin_desc * builtin_get(unsigned int id)
+{
+    assert(id > BUILT_IN_UKNOWN && id < sizeof(builtin_table) / sizeof(builtin_table[0]));
+    assert(builtin_table[id].id == id);
+
+    return &builtin_table[id];
+}
+
+/* deterministic builtin if value is its clause, call is then replaced with handler */
+const builtin_desc * builtin_clause_inline(clause * value)
+{
+    const builtin_desc * desc;
+
+    if (value == NULL || value->goals == NULL || value->goals->head == NULL ||
+        value->goals->head->type != GOAL_TYPE_BUILTIN)
+    {
+        return NULL;
+    }
+
+    desc = builtin_get(value->goals->head->builtin.id);
+    return desc->det ? desc : NULL;
+}
+
+/* predicates defined by program take precedence over builtins */
+void builtin_add_all(clause_list * clauses)
+{
+    unsigned int id;
+
+    for (id = BUILT_IN_UKNOWN + 1; id < sizeof(builtin_table) / sizeof(builtin_table[0]); id++)
+    {
+        const builtin_desc * desc = builtin_get(id);
+        if (builtin_is_defined(clauses, desc->name, desc->arity))
+        {
+            continue;
+        }
+
+        clause_list_add_end(clauses, builtin_clause(desc));
+        if (desc->add_clauses != NULL)
+        {
+            desc->add_clauses(clauses);
+        }
+    }
+}
@@ -23,16 +23,56 @@
 #define __BUILTIN_H__
 
 #include "clause.h"
+#include "query.h"
+#include "vm_types.h"
+
+typedef struct vm vm;
 
 typedef enum builtin_type {
     BUILT_IN_UKNOWN = 0,
     BUILT_IN_WRITE = 1,
-    BUILT_IN_NL = 2
+    BUILT_IN_NL = 2,
+    BUILT_IN_APPEND = 3,
+    BUILT_IN_MEMBER = 4,
+    BUILT_IN_LENGTH = 5,
+    BUILT_IN_REVERSE = 6,
+    BUILT_IN_NTH = 7
 } builtin_type;
 
-clause * builtin_write();
-clause * builtin_nl();
+/**
+ * Native list predicates are called as clause p(Args) <= builtin, $p(Args).
+ * Deterministic modes are handled in C and return from the clause without
+ * a choice point, other modes continue with ProL version $p.
+ */
+typedef enum builtin_result {
+    BUILTIN_FAIL = 0, /* no solution, backtrack */
+    BUILTIN_DET = 1, /* one solution, return to caller */
+    BUILTIN_NONDET = 2 /* continue with ProL version */
+} builtin_result;
+
+/* functor address of list cells, list_clause of program is not placed in code */
+#define BUILTIN_LIST_ADDR 0
+
+/**
+ * Handler of builtin predicate, arguments are on vm stack at args, args + 1,
+ * ... and nil is index of [] atom for predicates working on lists.
+ */
+typedef builtin_result (*builtin_execute)(vm * machine, stack_ptr args, atom_idx_t nil);
+
+typedef struct builtin_desc {
+    builtin_type id;
+    const char * name;
+    unsigned int arity;
+    char det; /* always one solution, called inline without clause */
+    char list; /* handler gets index of [] */
+    builtin_execute execute;
+    void (*add_clauses)(clause_list * clauses); /* ProL version $name */
+} builtin_desc;
+
+const builtin_desc * builtin_get(unsigned int id);
+const builtin_desc * builtin_clause_inline(clause * value);
 
 void builtin_add_all(clause_list * clauses);
+void builtin_add_once(clause_list * clauses, query * query_value);
 
 #endif /* __BUILTIN_H__ */
@@ -23,6 +23,8 @@
 #include "clause.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 bytecode_print_func bytecode_print_arr[] = {
@@ -69,16 +71,106 @@ bytecode_print_func bytecode_print_arr[] = {
     { BYTECODE_INT_SUB, bytecode_print_int_sub },
     { BYTECODE_INT_MUL, bytecode_print_int_mul },
     { BYTECODE_INT_DIV, bytecode_print_int_div },
+    { BYTECODE_INT_PUSH, bytecode_print_int_push },
+    { BYTECODE_INT_PUSH_REF, bytecode_print_int_push_ref },
+    { BYTECODE_INT_UNBOX, bytecode_print_int_unbox },
+    { BYTECODE_INT_BOX, bytecode_print_int_box },
+    { BYTECODE_INT_SHL, bytecode_print_int_shl },
+    { BYTECODE_INT_SHR, bytecode_print_int_shr },
     { BYTECODE_BUILTIN, bytecode_print_builtin },
+    { BYTECODE_CALL_BUILTIN, bytecode_print_call_builtin },
     { BYTECODE_LT, bytecode_print_lt },
-    { BYTECODE_GT, bytecode_print_gt }
+    { BYTECODE_GT, bytecode_print_gt },
+    { BYTECODE_SWITCH_ON_TERM, bytecode_print_switch_on_term },
+    { BYTECODE_SWITCH_ON_CONST, bytecode_print_switch_on_const },
+    { BYTECODE_SWITCH_ON_STRUCT, bytecode_print_switch_on_struct },
+    { BYTECODE_CASE_CONST, bytecode_print_case_const },
+    { BYTECODE_CASE_STRUCT, bytecode_print_case_struct },
+    { BYTECODE_CASE_STRUCT_ADDR, bytecode_print_case_struct_addr },
+    { BYTECODE_PUT_REF_REF, bytecode_print_put_ref_ref },
+    { BYTECODE_PUT_REF_INT, bytecode_print_put_ref_int },
+    { BYTECODE_PUT_REF_U_ATOM, bytecode_print_put_ref_u_atom },
+    { BYTECODE_PUT_REF_U_STRUCT_ADDR, bytecode_print_put_ref_u_struct_addr },
+    { BYTECODE_SON_U_VAR, bytecode_print_son_u_var }
 };
 
+#define BYTECODE_FIELD(member, width) { offsetof(bytecode, member), width }
+
+bytecode_format bytecode_format_arr[] = {
+    { BYTECODE_UNKNOWN, 1, 0, { { 0 } } },
+    { BYTECODE_POP, 1, 0, { { 0 } } },
+    { BYTECODE_PUT_REF, 3, 1, { BYTECODE_FIELD(put_ref.index, 2) } },
+    { BYTECODE_PUT_VAR, 3, 1, { BYTECODE_FIELD(put_var.index, 2) } },
+    { BYTECODE_U_REF, 3, 1, { BYTECODE_FIELD(u_ref.index, 2) } },
+    { BYTECODE_U_VAR, 3, 1, { BYTECODE_FIELD(u_var.index, 2) } },
+    { BYTECODE_CHECK, 3, 1, { BYTECODE_FIELD(check.index, 2) } },
+    { BYTECODE_PUT_ANON, 1, 0, { { 0 } } },
+    { BYTECODE_PUT_ATOM, 5, 1, { BYTECODE_FIELD(put_atom.idx, 4) } },
+    { BYTECODE_PUT_INT, 5, 1, { BYTECODE_FIELD(put_int.value, 4) } },
+    { BYTECODE_PUT_STRUCT, 0, 0, { { 0 } } },
+    { BYTECODE_PUT_STRUCT_ADDR, 7, 2, { BYTECODE_FIELD(put_struct.n, 2), BYTECODE_FIELD(put_struct.addr, 4) } },
+    { BYTECODE_U_ATOM, 5, 1, { BYTECODE_FIELD(u_atom.idx, 4) } },
+    { BYTECODE_U_INT, 5, 1, { BYTECODE_FIELD(u_int.value, 4) } },
+    { BYTECODE_U_STRUCT, 0, 0, { { 0 } } },
+    { BYTECODE_U_STRUCT_ADDR, 11, 3, { BYTECODE_FIELD(u_struct.offset, 4), BYTECODE_FIELD(u_struct.n, 2), BYTECODE_FIELD(u_struct.addr, 4) } },
+    { BYTECODE_UP, 5, 1, { BYTECODE_FIELD(up.offset, 4) } },
+    { BYTECODE_BIND, 1, 0, { { 0 } } },
+    { BYTECODE_SON, 3, 1, { BYTECODE_FIELD(son.number, 2) } },
+    { BYTECODE_MARK, 5, 1, { BYTECODE_FIELD(mark.offset, 4) } },
+    { BYTECODE_LAST_MARK, 1, 0, { { 0 } } },
+    { BYTECODE_CALL, 0, 0, { { 0 } } },
+    { BYTECODE_CALL_ADDR, 7, 2, { BYTECODE_FIELD(call.n, 2), BYTECODE_FIELD(call.addr, 4) } },
+    { BYTECODE_LAST_CALL, 0, 0, { { 0 } } },
+    { BYTECODE_LAST_CALL_ADDR, 9, 3, { BYTECODE_FIELD(last_call.size, 2), BYTECODE_FIELD(last_call.n, 2), BYTECODE_FIELD(last_call.addr, 4) } },
+    { BYTECODE_PUSH_ENV, 3, 1, { BYTECODE_FIELD(push_env.size, 2) } },
+    { BYTECODE_POP_ENV, 1, 0, { { 0 } } },
+    { BYTECODE_SET_BTP, 1, 0, { { 0 } } },
+    { BYTECODE_DEL_BTP, 1, 0, { { 0 } } },
+    { BYTECODE_TRY, 5, 1, { BYTECODE_FIELD(try.offset, 4) } },
+    { BYTECODE_PRUNE, 1, 0, { { 0 } } },
+    { BYTECODE_SET_CUT, 1, 0, { { 0 } } },
+    { BYTECODE_FAIL, 1, 0, { { 0 } } },
+    { BYTECODE_INIT, 5, 1, { BYTECODE_FIELD(init.offset, 4) } },
+    { BYTECODE_HALT, 3, 1, { BYTECODE_FIELD(halt.size, 2) } },
+    { BYTECODE_NO, 1, 0, { { 0 } } },
+    { BYTECODE_JUMP, 5, 1, { BYTECODE_FIELD(jump.offset, 4) } },
+    { BYTECODE_LABEL, 1, 0, { { 0 } } },
+    { BYTECODE_INT_NEG, 1, 0, { { 0 } } },
+    { BYTECODE_INT_ADD, 1, 0, { { 0 } } },
+    { BYTECODE_INT_SUB, 1, 0, { { 0 } } },
+    { BYTECODE_INT_MUL, 1, 0, { { 0 } } },
+    { BYTECODE_INT_DIV, 1, 0, { { 0 } } },
+    { BYTECODE_INT_PUSH, 5, 1, { BYTECODE_FIELD(int_push.value, 4) } },
+    { BYTECODE_INT_PUSH_REF, 3, 1, { BYTECODE_FIELD(int_push_ref.index, 2) } },
+    { BYTECODE_INT_UNBOX, 1, 0, { { 0 } } },
+    { BYTECODE_INT_BOX, 1, 0, { { 0 } } },
+    { BYTECODE_INT_SHL, 2, 1, { BYTECODE_FIELD(int_shl.bits, 1) } },
+    { BYTECODE_INT_SHR, 2, 1, { BYTECODE_FIELD(int_shr.bits, 1) } },
+    { BYTECODE_BUILTIN, 7, 2, { BYTECODE_FIELD(builtin.id, 2), BYTECODE_FIELD(builtin.nil, 4) } },
+    { BYTECODE_CALL_BUILTIN, 9, 3, { BYTECODE_FIELD(builtin.id, 2), BYTECODE_FIELD(builtin.nil, 4), BYTECODE_FIELD(builtin.n, 2) } },
+    { BYTECODE_LT, 1, 0, { { 0 } } },
+    { BYTECODE_GT, 1, 0, { { 0 } } },
+    { BYTECODE_SWITCH_ON_TERM, 13, 3, { BYTECODE_FIELD(switch_on_term.var_offset, 4), BYTECODE_FIELD(switch_on_term.const_offset, 4), BYTECODE_FIELD(switch_on_term.struct_offset, 4) } },
+    { BYTECODE_SWITCH_ON_CONST, 5, 1, { BYTECODE_FIELD(switch_on_const.size, 4) } },
+    { BYTECODE_SWITCH_ON_STRUCT, 5, 1, { BYTECODE_FIELD(switch_on_struct.size, 4) } },
+    { BYTECODE_CASE_CONST, 10, 3, { BYTECODE_FIELD(case_const.type, 1), BYTECODE_FIELD(case_const.idx, 4), BYTECODE_FIELD(case_const.offset, 4) } },
+    { BYTECODE_CASE_STRUCT, 0, 0, { { 0 } } },
+    { BYTECODE_CASE_STRUCT_ADDR, 11, 3, { BYTECODE_FIELD(case_struct.offset, 4), BYTECODE_FIELD(case_struct.n, 2), BYTECODE_FIELD(case_struct.addr, 4) } },
+    { BYTECODE_PUT_REF_REF, 5, 2, { BYTECODE_FIELD(put_ref_ref.index, 2), BYTECODE_FIELD(put_ref_ref.index2, 2) } },
+    { BYTECODE_PUT_REF_INT, 7, 2, { BYTECODE_FIELD(put_ref_int.index, 2), BYTECODE_FIELD(put_ref_int.value, 4) } },
+    { BYTECODE_PUT_REF_U_ATOM, 7, 2, { BYTECODE_FIELD(put_ref_u_atom.index, 2), BYTECODE_FIELD(put_ref_u_atom.idx, 4) } },
+    { BYTECODE_PUT_REF_U_STRUCT_ADDR, 13, 4, { BYTECODE_FIELD(put_ref_u_struct.index, 2), BYTECODE_FIELD(put_ref_u_struct.offset, 4), BYTECODE_FIELD(put_ref_u_struct.n, 2), BYTECODE_FIELD(put_ref_u_struct.addr, 4) } },
+    { BYTECODE_SON_U_VAR, 5, 2, { BYTECODE_FIELD(son_u_var.number, 2), BYTECODE_FIELD(son_u_var.index, 2) } }
+};
+
+#undef BYTECODE_FIELD
+
 bytecode * bytecode_new()
 {
     bytecode * value = (bytecode *)malloc(sizeof(bytecode));
 
     bytecode_print_test();
+    bytecode_format_test();
 
     return value;
 }
@@ -311,9 +403,45 @@ void bytecode_print_int_div(bytecode * value)
     printf("%d: %s\n", value->addr, bytecode_type_str(value->type));
 }
 
+void bytecode_print_int_push(bytecode * value)
+{
+    printf("%d: %s value %d\n", value->addr, bytecode_type_str(value->type), value->int_push.value);
+}
+
+void bytecode_print_int_push_ref(bytecode * value)
+{
+    printf("%d: %s index %u\n", value->addr, bytecode_type_str(value->type), value->int_push_ref.index);
+}
+
+void bytecode_print_int_unbox(bytecode * value)
+{
+    printf("%d: %s\n", value->addr, bytecode_type_str(value->type));
+}
+
+void bytecode_print_int_box(bytecode * value)
+{
+    printf("%d: %s\n", value->addr, bytecode_type_str(value->type));
+}
+
+void bytecode_print_int_shl(bytecode * value)
+{
+    printf("%d: %s bits %u\n", value->addr, bytecode_type_str(value->type), value->int_shl.bits);
+}
+
+void bytecode_print_int_shr(bytecode * value)
+{
+    printf("%d: %s bits %u\n", value->addr, bytecode_type_str(value->type), value->int_shr.bits);
+}
+
 void bytecode_print_builtin(bytecode * value)
 {
-    printf("%d: %s id %u\n", value->addr, bytecode_type_str(value->type), value->builtin.id);
+    printf("%d: %s id %u nil %u\n", value->addr, bytecode_type_str(value->type), value->builtin.id, value->builtin.nil);
+}
+
+void bytecode_print_call_builtin(bytecode * value)
+{
+    printf("%d: %s id %u nil %u n %u\n", value->addr, bytecode_type_str(value->type),
+           value->builtin.id, value->builtin.nil, value->builtin.n);
 }
 
 void bytecode_print_lt(bytecode * value)
@@ -325,6 +453,85 @@ void bytecode_print_gt(bytecode * value)
 {
     printf("%d: %s\n", value->addr, bytecode_type_str(value->type));
 }
+
+void bytecode_print_switch_on_term(bytecode * value)
+{
+    printf("%d: %s var %d const %d struct %d\n", value->addr, bytecode_type_str(value->type),
+           value->switch_on_term.var_offset, value->switch_on_term.const_offset,
+           value->switch_on_term.struct_offset);
+}
+
+void bytecode_print_switch_on_const(bytecode * value)
+{
+    printf("%d: %s size %u\n", value->addr, bytecode_type_str(value->type), value->switch_on_const.size);
+}
+
+void bytecode_print_switch_on_struct(bytecode * value)
+{
+    printf("%d: %s size %u\n", value->addr, bytecode_type_str(value->type), value->switch_on_struct.size);
+}
+
+void bytecode_print_case_const(bytecode * value)
+{
+    switch (value->case_const.type)
+    {
+        case BYTECODE_CASE_EMPTY:
+            printf("%d: %s empty\n", value->addr, bytecode_type_str(value->type));
+        break;
+        case BYTECODE_CASE_ATOM:
+            printf("%d: %s idx %u addr %d\n", value->addr, bytecode_type_str(value->type),
+                   value->case_const.idx, value->case_const.offset);
+        break;
+        case BYTECODE_CASE_INT:
+            printf("%d: %s value %d addr %d\n", value->addr, bytecode_type_str(value->type),
+                   value->case_const.value, value->case_const.offset);
+        break;
+    }
+}
+
+void bytecode_print_case_struct(bytecode * value)
+{
+    printf("%d: %s %s/%u addr %d\n", value->addr, bytecode_type_str(value->type),
+           value->case_struct.predicate_ref->name, clause_arity(value->case_struct.predicate_ref),
+           value->case_struct.offset);
+}
+
+void bytecode_print_case_struct_addr(bytecode * value)
+{
+    printf("%d: %s addr %u n %u addr %d\n", value->addr, bytecode_type_str(value->type),
+           value->case_struct.addr, value->case_struct.n, value->case_struct.offset);
+}
+
+void bytecode_print_put_ref_ref(bytecode * value)
+{
+    printf("%d: %s index %u index %u\n", value->addr, bytecode_type_str(value->type),
+           value->put_ref_ref.index, value->put_ref_ref.index2);
+}
+
+void bytecode_print_put_ref_int(bytecode * value)
+{
+    printf("%d: %s index %u value %d\n", value->addr, bytecode_type_str(value->type),
+           value->put_ref_int.index, value->put_ref_int.value);
+}
+
+void bytecode_print_put_ref_u_atom(bytecode * value)
+{
+    printf("%d: %s index %u idx %u\n", value->addr, bytecode_type_str(value->type),
+           value->put_ref_u_atom.index, value->put_ref_u_atom.idx);
+}
+
+void bytecode_print_put_ref_u_struct_addr(bytecode * value)
+{
+    printf("%d: %s index %u addr %u n %u offset %d\n", value->addr, bytecode_type_str(value->type),
+           value->put_ref_u_struct.index, value->put_ref_u_struct.addr,
+           value->put_ref_u_struct.n, value->put_ref_u_struct.offset);
+}
+
+void bytecode_print_son_u_var(bytecode * value)
+{
+    printf("%d: %s number %u index %u\n", value->addr, bytecode_type_str(value->type),
+           value->son_u_var.number, value->son_u_var.index);
+}
 void bytecode_print_test()
 {
     unsigned int i = 0;
@@ -334,6 +541,15 @@ void bytecode_print_test()
     }
 }
 
+void bytecode_format_test()
+{
+    unsigned int i = 0;
+    for (i = 0; i < BYTECODE_END; i++)
+    {
+        assert(i == bytecode_format_arr[i].type);
+    }
+}
+
 void bytecode_print(bytecode * value)
 {
     bytecode_print_arr[value->type].print(value);
@@ -386,14 +602,41 @@ const char * bytecode_type_str(bytecode_type type)
         case BYTECODE_INT_SUB: return "BYTECODE_INT_SUB";
         case BYTECODE_INT_MUL: return "BYTECODE_INT_MUL";
         case BYTECODE_INT_DIV: return "BYTECODE_INT_DIV";
+        case BYTECODE_INT_PUSH: return "BYTECODE_INT_PUSH";
+        case BYTECODE_INT_PUSH_REF: return "BYTECODE_INT_PUSH_REF";
+        case BYTECODE_INT_UNBOX: return "BYTECODE_INT_UNBOX";
+        case BYTECODE_INT_BOX: return "BYTECODE_INT_BOX";
+        case BYTECODE_INT_SHL: return "BYTECODE_INT_SHL";
+        case BYTECODE_INT_SHR: return "BYTECODE_INT_SHR";
         case BYTECODE_BUILTIN: return "BYTECODE_BUILTIN";
+        case BYTECODE_CALL_BUILTIN: return "BYTECODE_CALL_BUILTIN";
         case BYTECODE_LT: return "BYTECODE_LT";
         case BYTECODE_GT: return "BYTECODE_GT";
+        case BYTECODE_SWITCH_ON_TERM: return "BYTECODE_SWITCH_ON_TERM";
+        case BYTECODE_SWITCH_ON_CONST: return "BYTECODE_SWITCH_ON_CONST";
+        case BYTECODE_SWITCH_ON_STRUCT: return "BYTECODE_SWITCH_ON_STRUCT";
+        case BYTECODE_CASE_CONST: return "BYTECODE_CASE_CONST";
+        case BYTECODE_CASE_STRUCT: return "BYTECODE_CASE_STRUCT";
+        case BYTECODE_CASE_STRUCT_ADDR: return "BYTECODE_CASE_STRUCT_ADDR";
+        case BYTECODE_PUT_REF_REF: return "BYTECODE_PUT_REF_REF";
+        case BYTECODE_PUT_REF_INT: return "BYTECODE_PUT_REF_INT";
+        case BYTECODE_PUT_REF_U_ATOM: return "BYTECODE_PUT_REF_U_ATOM";
+        case BYTECODE_PUT_REF_U_STRUCT_ADDR: return "BYTECODE_PUT_REF_U_STRUCT_ADDR";
+        case BYTECODE_SON_U_VAR: return "BYTECODE_SON_U_VAR";
         case BYTECODE_END: return "BYTECODE_END";
     }
     return "BYTECODE_UNKNOWN";
 }
 
+/**
+ * Slot of key in a SWITCH_ON_CONST table. Size is a power of two and
+ * the table is probed linearly from this slot until an empty entry.
+ */
+unsigned int bytecode_case_hash(unsigned int key, unsigned int size)
+{
+    return (key * 2654435761u) & (size - 1);
+}
+
 bytecode_node * bytecode_node_new(bytecode * value)
 {
     bytecode_node * node = (bytecode_node *)malloc(sizeof(bytecode_node));
@@ -463,6 +706,12 @@ void bytecode_list_set_addr(bytecode_list * list)
             unsigned int addr = value->last_call.predicate_ref->addr;
             value->last_call.addr = addr;
         }
+        else if (value->type == BYTECODE_CASE_STRUCT)
+        {
+            value->type = BYTECODE_CASE_STRUCT_ADDR;
+            unsigned int addr = value->case_struct.predicate_ref->addr;
+            value->case_struct.addr = addr;
+        }
 
         node = node->next;
     }
@@ -489,10 +738,11 @@ void bytecode_list_print(bytecode_list * list)
     }
 }
 
-void bytecode_to_array(bytecode_list * code, bytecode ** code_arr,
+/* code addressed from base is placed in array from index 0 */
+void bytecode_to_array(bytecode_list * code, pc_ptr base, bytecode ** code_arr,
                        unsigned int * code_size)
 {
-    unsigned int addr = 0;
+    unsigned int addr = base;
     bytecode_node * node = NULL;
 
     *code_size = code->size;
@@ -514,7 +764,7 @@ void bytecode_to_array(bytecode_list * code, bytecode ** code_arr,
             assert(0);
         }
 
-        (*code_arr)[addr++] = node->value;
+        (*code_arr)[addr++ - base] = node->value;
 
         node = node->next;
     }
@@ -522,6 +772,131 @@ void bytecode_to_array(bytecode_list * code, bytecode ** code_arr,
 
 void bytecode_array_delete(bytecode * code_arr) { free(code_arr); }
 
+/**
+ * Code addresses execution continues at. Relative JUMP offset and
+ * addresses of structures, which identify them, are not returned.
+ */
+unsigned int bytecode_targets(bytecode * value, pc_offset * fields[3])
+{
+    switch (value->type)
+    {
+        case BYTECODE_U_STRUCT_ADDR:
+            fields[0] = &value->u_struct.offset;
+            return 1;
+        case BYTECODE_PUT_REF_U_STRUCT_ADDR:
+            fields[0] = &value->put_ref_u_struct.offset;
+            return 1;
+        case BYTECODE_UP:
+            fields[0] = &value->up.offset;
+            return 1;
+        case BYTECODE_MARK:
+            fields[0] = &value->mark.offset;
+            return 1;
+        case BYTECODE_TRY:
+            fields[0] = &value->try.offset;
+            return 1;
+        case BYTECODE_CALL_ADDR:
+            fields[0] = (pc_offset *)&value->call.addr;
+            return 1;
+        case BYTECODE_LAST_CALL_ADDR:
+            fields[0] = (pc_offset *)&value->last_call.addr;
+            return 1;
+        case BYTECODE_INIT:
+            fields[0] = &value->init.offset;
+            return 1;
+        case BYTECODE_SWITCH_ON_TERM:
+            fields[0] = &value->switch_on_term.var_offset;
+            fields[1] = &value->switch_on_term.const_offset;
+            fields[2] = &value->switch_on_term.struct_offset;
+            return 3;
+        case BYTECODE_CASE_CONST:
+            if (value->case_const.type == BYTECODE_CASE_EMPTY)
+            {
+                return 0;
+            }
+            fields[0] = &value->case_const.offset;
+            return 1;
+        case BYTECODE_CASE_STRUCT_ADDR:
+            fields[0] = &value->case_struct.offset;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Encodes linked code, see bytecode_format. Code addresses become byte
+ * offsets, addr_map gives byte offset of each instruction and of the end
+ * of code. Addresses of structures stay instruction indexes. Entries of
+ * SWITCH_ON_CONST and SWITCH_ON_STRUCT tables have the same size so
+ * they are still found by slot. Returns 0 when an operand does not fit.
+ */
+char bytecode_array_encode(bytecode * code_arr, unsigned int size,
+                           unsigned char ** compact, unsigned int * compact_size,
+                           pc_ptr ** addr_map)
+{
+    unsigned int i, j, n;
+    unsigned int bytes = 0;
+    pc_offset * fields[3];
+    pc_ptr * map = (pc_ptr *)malloc(sizeof(pc_ptr) * (size + 1));
+    unsigned char * code = NULL;
+    unsigned char * ip = NULL;
+
+    for (i = 0; i < size; i++)
+    {
+        if (bytecode_format_arr[code_arr[i].type].size == 0)
+        {
+            free(map);
+            return 0;
+        }
+        map[i] = bytes;
+        bytes += bytecode_format_arr[code_arr[i].type].size;
+    }
+    map[size] = bytes;
+
+    /* decoder reads operands with 4 byte loads */
+    code = (unsigned char *)calloc(bytes + 4, 1);
+    ip = code;
+    for (i = 0; i < size; i++)
+    {
+        bytecode value = code_arr[i];
+        bytecode_format * format = bytecode_format_arr + value.type;
+
+        n = bytecode_targets(&value, fields);
+        for (j = 0; j < n; j++)
+        {
+            *fields[j] = map[*fields[j]];
+        }
+        if (value.type == BYTECODE_JUMP)
+        {
+            value.jump.offset = (pc_offset)map[i + 1 + value.jump.offset] - (pc_offset)map[i + 1];
+        }
+
+        *ip++ = (unsigned char)value.type;
+        for (j = 0; j < format->count; j++)
+        {
+            unsigned int operand;
+            memcpy(&operand, (char *)&value + format->fields[j].offset, sizeof(operand));
+            if (format->fields[j].width < 4 && operand >> (8 * format->fields[j].width) != 0)
+            {
+                free(code);
+                free(map);
+                return 0;
+            }
+            for (n = 0; n < format->fields[j].width; n++)
+            {
+                *ip++ = (unsigned char)(operand >> (8 * n));
+            }
+        }
+    }
+
+    *compact = code;
+    *compact_size = bytes;
+    *addr_map = map;
+
+    return 1;
+}
+
 void bytecode_array_print(bytecode * code_arr, unsigned int size)
 {
     unsigned int i;
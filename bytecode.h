@@ -70,12 +70,36 @@ typedef enum bytecode_type {
     BYTECODE_INT_SUB,
     BYTECODE_INT_MUL,
     BYTECODE_INT_DIV,
+    BYTECODE_INT_PUSH,
+    BYTECODE_INT_PUSH_REF,
+    BYTECODE_INT_UNBOX,
+    BYTECODE_INT_BOX,
+    BYTECODE_INT_SHL,
+    BYTECODE_INT_SHR,
     BYTECODE_BUILTIN,
+    BYTECODE_CALL_BUILTIN,
     BYTECODE_LT,
     BYTECODE_GT,
+    BYTECODE_SWITCH_ON_TERM,
+    BYTECODE_SWITCH_ON_CONST,
+    BYTECODE_SWITCH_ON_STRUCT,
+    BYTECODE_CASE_CONST,
+    BYTECODE_CASE_STRUCT,
+    BYTECODE_CASE_STRUCT_ADDR,
+    BYTECODE_PUT_REF_REF,
+    BYTECODE_PUT_REF_INT,
+    BYTECODE_PUT_REF_U_ATOM,
+    BYTECODE_PUT_REF_U_STRUCT_ADDR,
+    BYTECODE_SON_U_VAR,
     BYTECODE_END
 } bytecode_type;
 
+typedef enum bytecode_case_type {
+    BYTECODE_CASE_EMPTY = 0,
+    BYTECODE_CASE_ATOM = 1,
+    BYTECODE_CASE_INT = 2
+} bytecode_case_type;
+
 typedef struct bytecode {
     bytecode_type type;
     unsigned int addr;
@@ -161,9 +185,73 @@ typedef struct bytecode {
         struct {
             pc_offset offset;
         } jump;
+        struct {
+            int value;
+        } int_push;
+        struct {
+            unsigned int index;
+        } int_push_ref;
+        struct {
+            unsigned int bits;
+        } int_shl;
+        struct {
+            unsigned int bits;
+        } int_shr;
         struct {
             unsigned int id;
+            atom_idx_t nil;
+            unsigned int n;
         } builtin;
+        struct {
+            pc_offset var_offset;
+            pc_offset const_offset;
+            pc_offset struct_offset;
+        } switch_on_term;
+        struct {
+            unsigned int size;
+        } switch_on_const;
+        struct {
+            unsigned int size;
+        } switch_on_struct;
+        struct {
+            bytecode_case_type type;
+            union {
+                atom_idx_t idx;
+                int value;
+            };
+            pc_offset offset;
+        } case_const;
+        struct {
+            pc_offset offset;
+            unsigned int n;
+            union {
+                pc_ptr addr;
+                clause * predicate_ref;
+            };
+        } case_struct;
+        /* superinstructions, see peephole_fuse */
+        struct {
+            unsigned int index;
+            unsigned int index2;
+        } put_ref_ref;
+        struct {
+            unsigned int index;
+            int value;
+        } put_ref_int;
+        struct {
+            unsigned int index;
+            atom_idx_t idx;
+        } put_ref_u_atom;
+        struct {
+            pc_offset offset;
+            unsigned int n;
+            pc_ptr addr;
+            unsigned int index;
+        } put_ref_u_struct;
+        struct {
+            unsigned int number;
+            unsigned int index;
+        } son_u_var;
     };
 } bytecode;
 
@@ -178,6 +266,26 @@ typedef struct bytecode_list {
     unsigned int size;
 } bytecode_list;
 
+/**
+ * Compact encoding of an instruction, see bytecode_array_encode. One byte
+ * opcode is followed by operands, each stored little endian in width bytes
+ * and decoded into the bytecode field at offset. Size is 0 for
+ * instructions which are replaced when code is linked.
+ */
+typedef struct bytecode_field {
+    unsigned char offset;
+    unsigned char width;
+} bytecode_field;
+
+typedef struct bytecode_format {
+    bytecode_type type;
+    unsigned char size;
+    unsigned char count;
+    bytecode_field fields[4];
+} bytecode_format;
+
+extern bytecode_format bytecode_format_arr[];
+
 typedef struct bytecode_print_func {
     bytecode_type type;
     void (*print)(bytecode * value);
@@ -229,13 +337,33 @@ void bytecode_print_int_add(bytecode * value);
 void bytecode_print_int_sub(bytecode * value);
 void bytecode_print_int_mul(bytecode * value);
 void bytecode_print_int_div(bytecode * value);
+void bytecode_print_int_push(bytecode * value);
+void bytecode_print_int_push_ref(bytecode * value);
+void bytecode_print_int_unbox(bytecode * value);
+void bytecode_print_int_box(bytecode * value);
+void bytecode_print_int_shl(bytecode * value);
+void bytecode_print_int_shr(bytecode * value);
 void bytecode_print_builtin(bytecode * value);
+void bytecode_print_call_builtin(bytecode * value);
 void bytecode_print_lt(bytecode * value);
 void bytecode_print_gt(bytecode * value);
+void bytecode_print_switch_on_term(bytecode * value);
+void bytecode_print_switch_on_const(bytecode * value);
+void bytecode_print_switch_on_struct(bytecode * value);
+void bytecode_print_case_const(bytecode * value);
+void bytecode_print_case_struct(bytecode * value);
+void bytecode_print_case_struct_addr(bytecode * value);
+void bytecode_print_put_ref_ref(bytecode * value);
+void bytecode_print_put_ref_int(bytecode * value);
+void bytecode_print_put_ref_u_atom(bytecode * value);
+void bytecode_print_put_ref_u_struct_addr(bytecode * value);
+void bytecode_print_son_u_var(bytecode * value);
 
 void bytecode_print(bytecode * value);
 void bytecode_print_test();
+void bytecode_format_test();
 const char * bytecode_type_str(bytecode_type type);
+unsigned int bytecode_case_hash(unsigned int key, unsigned int size);
 
 bytecode_node * bytecode_node_new();
 void bytecode_node_delete(bytecode_node * value);
@@ -247,9 +375,13 @@ void bytecode_list_set_addr(bytecode_list * list);
 bytecode * bytecode_list_add_end(bytecode_list * list, bytecode * value);
 void bytecode_list_print(bytecode_list * list);
 
-void bytecode_to_array(bytecode_list * code, bytecode ** code_arr,
+void bytecode_to_array(bytecode_list * code, pc_ptr base, bytecode ** code_arr,
                        unsigned int * code_size);
 void bytecode_array_delete(bytecode * code_arr);
+unsigned int bytecode_targets(bytecode * value, pc_offset * fields[3]);
+char bytecode_array_encode(bytecode * code_arr, unsigned int size,
+                           unsigned char ** compact, unsigned int * compact_size,
+                           pc_ptr ** addr_map);
 void bytecode_array_print(bytecode * code_arr, unsigned int size);
 
 #endif /* __BYTECODE_H__ */
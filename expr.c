@@ -21,6 +21,7 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include "expr.h"
 #include "var.h"
 
@@ -116,6 +117,30 @@ expr * expr_new_sup(expr * expr_value)
     return value;
 }
 
+expr * expr_new_shl(expr * expr_value, unsigned int bits)
+{
+    expr * value = (expr *)malloc(sizeof(expr));
+
+    value->type = EXPR_SHL;
+    value->shl.expr_value = expr_value;
+    value->shl.bits = bits;
+    value->line_no = 0;
+
+    return value;
+}
+
+expr * expr_new_shr(expr * expr_value, unsigned int bits)
+{
+    expr * value = (expr *)malloc(sizeof(expr));
+
+    value->type = EXPR_SHR;
+    value->shr.expr_value = expr_value;
+    value->shr.bits = bits;
+    value->line_no = 0;
+
+    return value;
+}
+
 void expr_delete(expr * value)
 {
     switch (value->type)
@@ -192,6 +217,12 @@ void expr_delete(expr * value)
          }
       }
       break;
+      case EXPR_SHL:
+        expr_delete(value->shl.expr_value);
+      break;
+      case EXPR_SHR:
+        expr_delete(value->shr.expr_value);
+      break;
     }
     free(value);
 }
@@ -280,10 +311,205 @@ void expr_print(expr * value)
          }
       }
       break;
+      case EXPR_SHL:
+        expr_print(value->shl.expr_value);
+        printf("<<%u", value->shl.bits);
+      break;
+      case EXPR_SHR:
+        expr_print(value->shr.expr_value);
+        printf(">>%u", value->shr.bits);
+      break;
     }
     printf("\n");
 }
 
+/* k when value is 2^k for k > 0, otherwise 0 */
+static unsigned int expr_power_of_two(expr * value)
+{
+    unsigned int bits = 0;
+    int n;
+
+    if (value->type != EXPR_INT || value->int_t.value < 2 ||
+        (value->int_t.value & (value->int_t.value - 1)) != 0)
+    {
+        return 0;
+    }
+    for (n = value->int_t.value; n > 1; n >>= 1)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+static char expr_is_int(expr * value, int int_value)
+{
+    return value->type == EXPR_INT && value->int_t.value == int_value;
+}
+
+/* replaces node by one of its operands, other operand is deleted */
+static expr * expr_fold_keep(expr * value, expr * keep, expr * drop)
+{
+    expr_delete(drop);
+    free(value);
+    return keep;
+}
+
+/* binary node with folded operands */
+static expr * expr_fold_binary(expr * value)
+{
+    expr * left = value->add.left_value;
+    expr * right = value->add.right_value;
+    unsigned int bits;
+
+    if (left->type == EXPR_INT && right->type == EXPR_INT)
+    {
+        unsigned int a = (unsigned int)left->int_t.value;
+        unsigned int b = (unsigned int)right->int_t.value;
+        int result;
+
+        switch (value->type)
+        {
+            case EXPR_ADD:
+                result = (int)(a + b);
+            break;
+            case EXPR_SUB:
+                result = (int)(a - b);
+            break;
+            case EXPR_MUL:
+                result = (int)(a * b);
+            break;
+            default:
+                /* division by zero is reported when executed */
+                if (right->int_t.value == 0 ||
+                    (left->int_t.value == INT_MIN && right->int_t.value == -1))
+                {
+                    return value;
+                }
+                result = left->int_t.value / right->int_t.value;
+            break;
+        }
+        left->int_t.value = result;
+        return expr_fold_keep(value, left, right);
+    }
+
+    switch (value->type)
+    {
+        case EXPR_ADD:
+            if (expr_is_int(right, 0))
+            {
+                return expr_fold_keep(value, left, right);
+            }
+            if (expr_is_int(left, 0))
+            {
+                return expr_fold_keep(value, right, left);
+            }
+        break;
+        case EXPR_SUB:
+            if (expr_is_int(right, 0))
+            {
+                return expr_fold_keep(value, left, right);
+            }
+            if (expr_is_int(left, 0))
+            {
+                expr_delete(left);
+                value->type = EXPR_NEG;
+                value->neg.expr_value = right;
+            }
+        break;
+        case EXPR_MUL:
+            if (expr_is_int(right, 1))
+            {
+                return expr_fold_keep(value, left, right);
+            }
+            if (expr_is_int(left, 1))
+            {
+                return expr_fold_keep(value, right, left);
+            }
+            if ((bits = expr_power_of_two(right)) > 0)
+            {
+                expr_delete(right);
+                value->type = EXPR_SHL;
+                value->shl.expr_value = left;
+                value->shl.bits = bits;
+            }
+            else if ((bits = expr_power_of_two(left)) > 0)
+            {
+                expr_delete(left);
+                value->type = EXPR_SHL;
+                value->shl.expr_value = right;
+                value->shl.bits = bits;
+            }
+        break;
+        case EXPR_DIV:
+            if (expr_is_int(right, 1))
+            {
+                return expr_fold_keep(value, left, right);
+            }
+            if ((bits = expr_power_of_two(right)) > 0)
+            {
+                expr_delete(right);
+                value->type = EXPR_SHR;
+                value->shr.expr_value = left;
+                value->shr.bits = bits;
+            }
+        break;
+        default:
+        break;
+    }
+
+    return value;
+}
+
+/**
+ * Folds constant subexpressions, removes parentheses and identities such
+ * as x + 0 and x * 1 and replaces multiplication and division by a power
+ * of two with shifts. x * 0 is kept unless x is an integer, so x is still
+ * checked to be an integer. Called after expression is checked so
+ * variables are known to be bound or not. Returns the new root, replaced
+ * nodes are deleted.
+ */
+expr * expr_fold(expr * value)
+{
+    switch (value->type)
+    {
+        case EXPR_INT:
+        case EXPR_VAR:
+        break;
+        case EXPR_NEG:
+            value->neg.expr_value = expr_fold(value->neg.expr_value);
+            if (value->neg.expr_value->type == EXPR_INT &&
+                value->neg.expr_value->int_t.value != INT_MIN)
+            {
+                expr * operand = value->neg.expr_value;
+                operand->int_t.value = -operand->int_t.value;
+                free(value);
+                return operand;
+            }
+        break;
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+        case EXPR_DIV:
+            value->add.left_value = expr_fold(value->add.left_value);
+            value->add.right_value = expr_fold(value->add.right_value);
+            return expr_fold_binary(value);
+        case EXPR_SUP:
+        {
+            expr * operand = expr_fold(value->sup.expr_value);
+            free(value);
+            return operand;
+        }
+        case EXPR_SHL:
+            value->shl.expr_value = expr_fold(value->shl.expr_value);
+        break;
+        case EXPR_SHR:
+            value->shr.expr_value = expr_fold(value->shr.expr_value);
+        break;
+    }
+
+    return value;
+}
+
 const char * expr_type_to_str(expr_type type)
 {
     switch (type)
@@ -296,6 +522,8 @@ const char * expr_type_to_str(expr_type type)
         case EXPR_MUL: return "EXPR_MUL";
         case EXPR_DIV: return "EXPR_DIV";
         case EXPR_SUP: return "EXPR_SUP";
+        case EXPR_SHL: return "EXPR_SHL";
+        case EXPR_SHR: return "EXPR_SHR";
     }
     return "EXPR_UNKNOWN";
 }
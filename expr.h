@@ -33,7 +33,9 @@ typedef enum expr_type
     EXPR_SUB,
     EXPR_MUL,
     EXPR_DIV,
-    EXPR_SUP
+    EXPR_SUP,
+    EXPR_SHL, /* multiplication by power of two, see expr_fold */
+    EXPR_SHR /* division by power of two */
 } expr_type;
 
 typedef struct expr
@@ -68,6 +70,14 @@ typedef struct expr
         struct {
             struct expr * expr_value;
         } sup;
+        struct {
+            struct expr * expr_value;
+            unsigned int bits;
+        } shl;
+        struct {
+            struct expr * expr_value;
+            unsigned int bits;
+        } shr;
     };
     unsigned int line_no;
 } expr;
@@ -80,9 +90,13 @@ expr * expr_new_sub(expr * left_value, expr * right_value);
 expr * expr_new_mul(expr * left_value, expr * right_value);
 expr * expr_new_div(expr * left_value, expr * right_value);
 expr * expr_new_sup(expr * expr_value);
+expr * expr_new_shl(expr * expr_value, unsigned int bits);
+expr * expr_new_shr(expr * expr_value, unsigned int bits);
 
 void expr_delete(expr * expr_value);
 
+expr * expr_fold(expr * value);
+
 void expr_print(expr * expr_value);
 const char * expr_type_to_str(expr_type type);
 
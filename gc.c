@@ -22,101 +22,357 @@
 #include "gc.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
 
 gc * gc_new(heap_size_t size)
 {
-    heap_size_t i = 0;
     gc * collector = (gc *)malloc(sizeof(gc));
 
-    collector->free[0] = 1;
-    collector->free[1] = 1;
-    collector->heap[0] = (gc_heap *)malloc(sizeof(gc_heap) * size);
-    collector->heap[1] = (gc_heap *)malloc(sizeof(gc_heap) * size);
-    collector->heap_idx = 0;
+    collector->free = 1;
+    collector->heap = (gc_heap *)calloc(size, sizeof(gc_heap));
+    collector->mark = (char *)calloc(size, sizeof(char));
+    collector->mark_size = 64;
+    collector->mark_top = 0;
+    collector->mark_stack = (heap_ptr *)malloc(sizeof(heap_ptr) * collector->mark_size);
     collector->size = size;
-
-    for (i = 0; i < size; i++)
-    {
-        collector->heap[0][i].mark = 0;
-        collector->heap[0][i].object_value = NULL;
-        collector->heap[1][i].mark = 0;
-        collector->heap[1][i].object_value = NULL;
-    }
+    collector->max_size = size;
+
+    collector->old_top = 1;
+    collector->nursery_size = GC_NURSERY_SIZE;
+    collector->remembered_size = 64;
+    collector->remembered_top = 0;
+    collector->remembered = (heap_ptr *)malloc(sizeof(heap_ptr) * collector->remembered_size);
+    collector->forward_size = 0;
+    collector->forward = NULL;
+
+    collector->stats.run_count = 0;
+    collector->stats.reclaimed = 0;
+    collector->stats.max_live = 0;
+    collector->stats.max_used = 0;
+    collector->stats.run_time = 0.0;
+    collector->stats.max_pause = 0.0;
+    collector->stats.minor_count = 0;
+    collector->stats.promoted = 0;
+    collector->stats.minor_time = 0.0;
+    collector->stats.minor_max_pause = 0.0;
+    memset(collector->stats.alloc_count, 0, sizeof(collector->stats.alloc_count));
+    collector->stats.alloc_cells = 0;
+
+    gc_set_policy(collector, GC_POLICY_THRESHOLD, 0.75, 2.0);
 
     return collector;
 }
 
 void gc_delete(gc * collector)
 {
-    heap_size_t mi;
-    for (mi = 0; mi < collector->size; mi++)
+    if (collector->heap)
     {
-        void * object_value;
-        if ((object_value = collector->heap[collector->heap_idx][mi].object_value) != NULL)
-        {
-            object_delete(object_value);
-        }
+        free(collector->heap);
+    }
+    if (collector->mark)
+    {
+        free(collector->mark);
+    }
+    if (collector->mark_stack)
+    {
+        free(collector->mark_stack);
     }
-    if (collector->heap[0])
+    if (collector->remembered)
     {
-        free(collector->heap[0]);
+        free(collector->remembered);
     }
-    if (collector->heap[1])
+    if (collector->forward)
     {
-        free(collector->heap[1]);
+        free(collector->forward);
     }
     free(collector);
 }
 
+void gc_set_max_size(gc * collector, heap_size_t max_size)
+{
+    collector->max_size = max_size > collector->size ? max_size : collector->size;
+}
+
+char gc_grow(gc * collector, heap_size_t min_size)
+{
+    heap_size_t new_size = collector->size > 0 ? collector->size : 1;
+
+    if (min_size > collector->max_size)
+    {
+        return 0;
+    }
+    while (new_size < min_size)
+    {
+        new_size = new_size > collector->max_size / 2 ? collector->max_size : new_size * 2;
+    }
+
+    gc_heap * heap = (gc_heap *)realloc(collector->heap, new_size * sizeof(gc_heap));
+    char * mark = (char *)realloc(collector->mark, new_size * sizeof(char));
+    if (heap != NULL)
+    {
+        collector->heap = heap;
+    }
+    if (mark != NULL)
+    {
+        collector->mark = mark;
+    }
+    if (heap == NULL || mark == NULL)
+    {
+        return 0;
+    }
+
+    memset(heap + collector->size, 0, (new_size - collector->size) * sizeof(gc_heap));
+    memset(mark + collector->size, 0, (new_size - collector->size) * sizeof(char));
+
+    collector->size = new_size;
+    if (collector->trigger < (heap_size_t)(collector->size * collector->threshold))
+    {
+        collector->trigger = (heap_size_t)(collector->size * collector->threshold);
+    }
+
+    return 1;
+}
+
+void gc_set_policy(gc * collector, gc_policy policy, double threshold, double growth)
+{
+    assert(threshold > 0.0 && threshold <= 1.0);
+
+    collector->policy = policy;
+    collector->threshold = threshold;
+    collector->growth = growth;
+    collector->trigger = (heap_size_t)(collector->size * threshold);
+    if (policy != GC_POLICY_GENERATIONAL)
+    {
+        collector->old_top = 1;
+        collector->remembered_top = 0;
+    }
+}
+
+void gc_set_nursery(gc * collector, heap_size_t nursery_size)
+{
+    collector->nursery_size = nursery_size > 0 ? nursery_size : 1;
+}
+
+char gc_need_run(gc * collector)
+{
+    switch (collector->policy)
+    {
+        case GC_POLICY_ALWAYS:
+            return 1;
+        case GC_POLICY_THRESHOLD:
+            return collector->free >= collector->trigger;
+        case GC_POLICY_GENERATIONAL:
+            return collector->free - collector->old_top >= collector->nursery_size ||
+                   collector->remembered_top >= collector->nursery_size ||
+                   collector->free >= collector->trigger;
+    }
+    return 1;
+}
+
+static heap_size_t gc_cell_count(gc_heap cell)
+{
+    if (GC_CELL_TAG(cell) == GC_TAG_STRUCT)
+    {
+        return 1 + GC_CELL_STRUCT_SIZE(cell);
+    }
+    return 1;
+}
+
+static void gc_mark_push(gc * collector, heap_ptr addr)
+{
+    if (collector->mark_top == collector->mark_size)
+    {
+        collector->mark_size *= 2;
+        collector->mark_stack = (heap_ptr *)realloc(collector->mark_stack,
+                                    sizeof(heap_ptr) * collector->mark_size);
+        assert(collector->mark_stack != NULL);
+    }
+    collector->mark_stack[collector->mark_top++] = addr;
+}
+
+/**
+ * Depth first on explicit stack, long lists do not recurse in C.
+ * Cells below low are not marked nor followed, nor cells above heap top
+ * which were released by backtracking and may still be pointed to from
+ * dead stack entries.
+ */
+static void gc_mark_from(gc * collector, heap_ptr addr, heap_ptr low)
+{
+    gc_heap * heap = collector->heap;
+    heap_ptr high = collector->free;
+
+    gc_mark_push(collector, addr);
+    while (collector->mark_top > 0)
+    {
+        addr = collector->mark_stack[--collector->mark_top];
+        if (addr == 0 || addr < low || addr >= high || collector->mark[addr] == 1)
+        {
+            continue;
+        }
+        switch (GC_CELL_TAG(heap[addr]))
+        {
+            case GC_TAG_EMPTY:
+            break;
+            case GC_TAG_ATOM:
+            case GC_TAG_INT:
+                collector->mark[addr] = 1;
+            break;
+            case GC_TAG_REF:
+                collector->mark[addr] = 1;
+                gc_mark_push(collector, (heap_ptr)GC_CELL_VALUE(heap[addr]));
+            break;
+            case GC_TAG_STRUCT:
+            {
+                heap_size_t i;
+                heap_size_t size = GC_CELL_STRUCT_SIZE(heap[addr]);
+                collector->mark[addr] = 1;
+                for (i = size; i >= 1; i--)
+                {
+                    gc_mark_push(collector, (heap_ptr)GC_CELL_VALUE(heap[addr + i]));
+                }
+            }
+            break;
+        }
+    }
+}
+
 void gc_mark(gc * collector, heap_ptr addr)
 {
-    if (addr == 0)
+    gc_mark_from(collector, addr, 0);
+}
+
+/* old cells stay, cells above hp were released by backtracking */
+static inline heap_ptr gc_forward(gc * collector, heap_ptr addr, heap_ptr low, heap_ptr hp)
+{
+    if (addr < low)
     {
-        return;
+        return addr;
     }
-    if (collector->heap[collector->heap_idx][addr].mark == 1)
+    if (addr >= hp || collector->mark[addr] == 0)
     {
-        return;
+        return 0;
     }
-    if (collector->heap[collector->heap_idx][addr].object_value == NULL)
+    return collector->forward[addr - low];
+}
+
+/**
+ * Slide marked cells at low and above down to low keeping their order.
+ * Forward gets new address of each cell and, for structure arguments,
+ * of the cell which follows the structure. Returns new heap top.
+ */
+static heap_ptr gc_slide(gc * collector, heap_ptr low)
+{
+    gc_heap * heap = collector->heap;
+    heap_ptr hp = collector->free;
+    heap_ptr to = low;
+    heap_ptr mi;
+
+    if (collector->forward_size < hp - low)
     {
-        return;
+        collector->forward_size = hp - low;
+        collector->forward = (heap_ptr *)realloc(collector->forward,
+                                 sizeof(heap_ptr) * collector->forward_size);
+        assert(collector->forward != NULL);
     }
-    switch (collector->heap[collector->heap_idx][addr].object_value->type)
+
+    for (mi = low; mi < hp; )
     {
-        case OBJECT_UNKNOWN:
-            assert(0);
-        break;
-        case OBJECT_ATOM:
-            collector->heap[collector->heap_idx][addr].mark = 1;
-        break;
-        case OBJECT_INT:
-            collector->heap[collector->heap_idx][addr].mark = 1;
-        break;
-        case OBJECT_REF:
-            collector->heap[collector->heap_idx][addr].mark = 1;
-            gc_mark(collector, collector->heap[collector->heap_idx][addr].object_value->ref_value.ref);
-        break;
-        case OBJECT_STRUCT:
+        heap_size_t idx;
+        heap_size_t count = gc_cell_count(heap[mi]);
+        collector->forward[mi - low] = to;
+        if (collector->mark[mi] == 1)
+        {
+            memmove(heap + to, heap + mi, count * sizeof(gc_heap));
+            to += count;
+        }
+        for (idx = 1; idx < count; idx++)
+        {
+            collector->forward[mi + idx - low] = to;
+        }
+        mi += count;
+    }
+
+    return to;
+}
+
+/**
+ * Change addresses in moved cells, stack and trail after gc_slide.
+ * Heap size marks saved by choice points move with the cells, a mark
+ * stays between cells created before and after its choice point, so
+ * backtracking still releases the heap above it at once.
+ */
+static void gc_update(
+    gc * collector, heap_ptr low, heap_ptr hp, heap_ptr to,
+    gc_stack * omfalos, stack_ptr stack_size,
+    gc_stack * trail, stack_ptr trail_size)
+{
+    gc_heap * heap = collector->heap;
+    stack_ptr si;
+    heap_ptr mi;
+
+    for (mi = low; mi < to; )
+    {
+        heap_size_t count = gc_cell_count(heap[mi]);
+        switch (GC_CELL_TAG(heap[mi]))
         {
-            unsigned int i;
-            collector->heap[collector->heap_idx][addr].mark = 1;
-            object * value = collector->heap[collector->heap_idx][addr].object_value;
-            for (i = 0; i < value->struct_value.size; i++)
+            case GC_TAG_EMPTY:
+            case GC_TAG_ATOM:
+            case GC_TAG_INT:
+            break;
+            case GC_TAG_REF:
+                heap[mi] = GC_MAKE_CELL(GC_TAG_REF, gc_forward(collector, GC_CELL_VALUE(heap[mi]), low, hp));
+            break;
+            case GC_TAG_STRUCT:
             {
-                gc_mark(collector, value->struct_value.refs[i]);
+                for (heap_size_t idx = 1; idx < count; idx++)
+                {
+                    heap[mi + idx] = GC_MAKE_CELL(GC_TAG_REF, gc_forward(collector, GC_CELL_VALUE(heap[mi + idx]), low, hp));
+                }
             }
+            break;
         }
-        break;
+        mi += count;
     }
+    for (si = 0; si <= stack_size; si++)
+    {
+        if (omfalos[si].type == STACK_TYPE_HEAP_PTR)
+        {
+            omfalos[si].addr = gc_forward(collector, omfalos[si].addr, low, hp);
+        }
+        else if (omfalos[si].type == STACK_TYPE_HEAP_SIZE && omfalos[si].addr > low)
+        {
+            omfalos[si].addr = omfalos[si].addr < hp ? collector->forward[omfalos[si].addr - low] : to;
+        }
+    }
+    for (si = 0; si <= trail_size; si++)
+    {
+        if (trail[si].type == STACK_TYPE_HEAP_PTR)
+        {
+            trail[si].addr = gc_forward(collector, trail[si].addr, low, hp);
+        }
+    }
+    // reset unused memory, dead stack entries may point inside structures so clear all marks
+    memset(heap + to, 0, (hp - to) * sizeof(gc_heap));
+    memset(collector->mark + low, 0, hp - low);
+
+    gc_update_max_used(collector);
+    collector->free = to;
 }
 
+/**
+ * Mark and compact whole heap. Cells keep their order, which is what
+ * heap size marks of choice points rely on.
+ */
 void gc_run(
     gc * collector,
     gc_stack * omfalos, stack_ptr stack_size,
     gc_stack * trail, stack_ptr trail_size)
 {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     // mark reachable objects
     stack_ptr si;
     for (si = 0; si <= stack_size; si++)
@@ -126,333 +382,525 @@ void gc_run(
             gc_mark(collector, omfalos[si].addr);
         }
     }
-    // move reachable objects
-    heap_size_t mi;
-    unsigned int curr_mem = collector->heap_idx;
-    unsigned int next_mem = 1 - curr_mem; 
+    // move reachable objects down and change addresses
+    heap_ptr hp = collector->free;
+    heap_ptr live = gc_slide(collector, 1);
+    gc_update(collector, 1, hp, live, omfalos, stack_size, trail, trail_size);
+
+    // update statistics
+    collector->stats.run_count++;
+    collector->stats.reclaimed += hp - live;
+    if (live > collector->stats.max_live)
+    {
+        collector->stats.max_live = live;
+    }
+    // move trigger away from live cells so collection does not run on every call
+    collector->trigger = (heap_size_t)(collector->size * collector->threshold);
+    if (collector->growth > 1.0 && live * collector->growth > collector->trigger)
+    {
+        collector->trigger = (heap_size_t)(live * collector->growth);
+        if (collector->trigger > collector->max_size)
+        {
+            collector->trigger = collector->max_size;
+        }
+    }
+    // everything which survived is old
+    if (collector->policy == GC_POLICY_GENERATIONAL)
+    {
+        collector->old_top = live;
+    }
+    collector->remembered_top = 0;
 
-    for (mi = 0; mi < collector->free[curr_mem]; mi++)
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double pause = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    collector->stats.run_time += pause;
+    if (pause > collector->stats.max_pause)
     {
-        if (collector->heap[curr_mem][mi].mark == 1)
-        {   // move object from one side to other
-            collector->heap[curr_mem][mi].mark = 0;
-            collector->heap[next_mem][collector->free[next_mem]] = collector->heap[curr_mem][mi];
-            collector->heap[curr_mem][mi].back_ptr = collector->free[next_mem];
-            collector->free[next_mem]++;
+        collector->stats.max_pause = pause;
+    }
+}
+
+/**
+ * Collect nursery only. Roots are stack and old cells from remembered
+ * set, old cells are assumed live. Survivors slide down to old_top and
+ * are promoted.
+ */
+void gc_run_minor(
+    gc * collector,
+    gc_stack * omfalos, stack_ptr stack_size,
+    gc_stack * trail, stack_ptr trail_size)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    gc_heap * heap = collector->heap;
+    heap_ptr old_top = collector->old_top;
+    heap_ptr hp = collector->free;
+    heap_size_t ri;
+    stack_ptr si;
+
+    // mark nursery cells reachable from stack and remembered set
+    for (si = 0; si <= stack_size; si++)
+    {
+        if (omfalos[si].type == STACK_TYPE_HEAP_PTR)
+        {
+            gc_mark_from(collector, omfalos[si].addr, old_top);
         }
-        else
-        {   // reclaim memory
-            if (collector->heap[curr_mem][mi].object_value != NULL)
-            {
-                object_delete(collector->heap[curr_mem][mi].object_value);
-                collector->heap[curr_mem][mi].object_value = NULL;
-            }
+    }
+    for (ri = 0; ri < collector->remembered_top; ri++)
+    {
+        heap_ptr addr = collector->remembered[ri];
+        if (addr < old_top && GC_CELL_TAG(heap[addr]) == GC_TAG_REF)
+        {
+            gc_mark_from(collector, (heap_ptr)GC_CELL_VALUE(heap[addr]), old_top);
         }
     }
-    // change addresses in objects
-    for (mi = 0; mi < collector->free[next_mem]; mi++)
+    // move survivors down, change addresses in remembered old cells before marks are cleared
+    heap_ptr to = gc_slide(collector, old_top);
+    for (ri = 0; ri < collector->remembered_top; ri++)
     {
-        if (collector->heap[next_mem][mi].object_value != NULL)
+        heap_ptr addr = collector->remembered[ri];
+        if (addr < old_top && GC_CELL_TAG(heap[addr]) == GC_TAG_REF)
         {
-            switch (collector->heap[next_mem][mi].object_value->type)
-            {
-                case OBJECT_UNKNOWN:
-                    assert(0);
-                break;
-                case OBJECT_ATOM:
-                break;
-                case OBJECT_INT:
-                break;
-                case OBJECT_REF:
-                {
-                    heap_ptr * ref_ptr = &(collector->heap[next_mem][mi].object_value->ref_value.ref);
-                    *ref_ptr = collector->heap[curr_mem][*ref_ptr].back_ptr;
-                }
-                break;
-                case OBJECT_STRUCT:
-                {
-                    object * object_value = collector->heap[next_mem][mi].object_value;
-                    for (unsigned int idx = 0; idx < object_value->struct_value.size; idx++)
-                    {
-                        heap_ptr * ref_ptr = &(object_value->struct_value.refs[idx]);
-                        *ref_ptr = collector->heap[curr_mem][*ref_ptr].back_ptr;
-                    }
-                }
-                break;
-            }
+            heap[addr] = GC_MAKE_CELL(GC_TAG_REF, gc_forward(collector, GC_CELL_VALUE(heap[addr]), old_top, hp));
         }
     }
-    // change addresses in stack
-    for (si = 0; si <= stack_size; si++)
+    gc_update(collector, old_top, hp, to, omfalos, stack_size, trail, trail_size);
+
+    // promote survivors
+    collector->old_top = to;
+    collector->remembered_top = 0;
+    collector->stats.minor_count++;
+    collector->stats.promoted += to - old_top;
+    collector->stats.reclaimed += hp - to;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double pause = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    collector->stats.minor_time += pause;
+    if (pause > collector->stats.minor_max_pause)
     {
-        if (omfalos[si].type == STACK_TYPE_HEAP_PTR)
+        collector->stats.minor_max_pause = pause;
+    }
+}
+
+/* collection requested by gc_need_run, whole heap when old generation passed trigger */
+void gc_collect(
+    gc * collector,
+    gc_stack * omfalos, stack_ptr stack_size,
+    gc_stack * trail, stack_ptr trail_size)
+{
+    if (collector->policy == GC_POLICY_GENERATIONAL)
+    {
+        gc_run_minor(collector, omfalos, stack_size, trail, trail_size);
+        if (collector->free < collector->trigger)
         {
-            heap_ptr * ref_ptr = &(omfalos[si].addr);
-            *ref_ptr = collector->heap[curr_mem][*ref_ptr].back_ptr;
+            return;
         }
     }
-    // change addresses in trail
-    for (si = 0; si <= trail_size; si++)
+    gc_run(collector, omfalos, stack_size, trail, trail_size);
+}
+
+/* heap occupancy peaks before a collection, on backtracking and at the end */
+void gc_update_max_used(gc * collector)
+{
+    if (collector->free > collector->stats.max_used)
     {
-        if (trail[si].type == STACK_TYPE_HEAP_PTR)
+        collector->stats.max_used = collector->free;
+    }
+}
+
+void gc_print_stats(gc * collector)
+{
+    unsigned int i;
+
+    fprintf(stderr, "gc policy           : %s", gc_policy_to_str(collector->policy));
+    if (collector->policy != GC_POLICY_ALWAYS)
+    {
+        fprintf(stderr, " (threshold %.2f growth %.2f)", collector->threshold, collector->growth);
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "gc runs             : %lu\n", collector->stats.run_count);
+    fprintf(stderr, "gc reclaimed cells  : %lu\n", collector->stats.reclaimed);
+    fprintf(stderr, "gc max live cells   : %u\n", collector->stats.max_live);
+    fprintf(stderr, "gc peak heap cells  : %u\n", collector->stats.max_used);
+    fprintf(stderr, "gc time             : %.6f s\n", collector->stats.run_time);
+    fprintf(stderr, "gc max pause        : %.6f s\n", collector->stats.max_pause);
+    fprintf(stderr, "gc allocated cells  : %lu\n", collector->stats.alloc_cells);
+    for (i = 0; i < GC_SIZE_CLASSES; i++)
+    {
+        if (collector->stats.alloc_count[i] > 0)
         {
-            heap_ptr * ref_ptr = &(trail[si].addr);
-            *ref_ptr = collector->heap[curr_mem][*ref_ptr].back_ptr;
+            char name[32];
+            snprintf(name, sizeof(name), "gc alloc %u%s cell%s", i + 1,
+                     i + 1 < GC_SIZE_CLASSES ? "" : "+", i > 0 ? "s" : "");
+            fprintf(stderr, "%-20s: %lu\n", name, collector->stats.alloc_count[i]);
         }
     }
-    // reset unused memory
-    for (mi = 0; mi < collector->free[curr_mem]; mi++)
+    if (collector->policy == GC_POLICY_GENERATIONAL)
     {
-        collector->heap[curr_mem][mi].object_value = NULL;
+        fprintf(stderr, "gc nursery cells    : %u\n", collector->nursery_size);
+        fprintf(stderr, "gc minor runs       : %lu\n", collector->stats.minor_count);
+        fprintf(stderr, "gc promoted cells   : %lu\n", collector->stats.promoted);
+        fprintf(stderr, "gc minor time       : %.6f s\n", collector->stats.minor_time);
+        fprintf(stderr, "gc minor max pause  : %.6f s\n", collector->stats.minor_max_pause);
+        fprintf(stderr, "gc minor mean pause : %.6f s\n",
+                collector->stats.minor_count > 0 ? collector->stats.minor_time / collector->stats.minor_count : 0.0);
     }
-    // change memory side
-    collector->free[curr_mem] = 1;
-    collector->heap_idx = next_mem;
 }
 
-heap_ptr gc_alloc_any(gc * collector, object * value)
+const char * gc_policy_to_str(gc_policy policy)
 {
-    heap_ptr loc = collector->free[collector->heap_idx];
+    switch (policy)
+    {
+        case GC_POLICY_ALWAYS: return "always";
+        case GC_POLICY_THRESHOLD: return "threshold";
+        case GC_POLICY_GENERATIONAL: return "generational";
+    }
+    return "unknown";
+}
 
-    if (loc == 0)
+heap_ptr gc_alloc_cells(gc * collector, heap_size_t count)
+{
+    heap_ptr loc = collector->free;
+
+    if (loc + count > collector->size && !gc_grow(collector, loc + count))
     {
-        fprintf(stderr, "out of memory\n");
-        exit(1);
+        return 0;
     }
 
-    collector->heap[collector->heap_idx][loc].mark = 0;
-    collector->heap[collector->heap_idx][loc].object_value = value;
-    collector->free[collector->heap_idx]++;
+    collector->free += count;
+    collector->stats.alloc_count[count < GC_SIZE_CLASSES ? count - 1 : GC_SIZE_CLASSES - 1]++;
+    collector->stats.alloc_cells += count;
 
     return loc;
 }
 
 heap_ptr gc_alloc_atom(gc * collector, atom_idx_t idx)
 {
-    return gc_alloc_any(collector, object_new_atom(idx));
+    heap_ptr loc = gc_alloc_cells(collector, 1);
+    if (loc != 0)
+    {
+        collector->heap[loc] = GC_MAKE_CELL(GC_TAG_ATOM, idx);
+    }
+    return loc;
 }
 
 heap_ptr gc_alloc_int(gc * collector, int value)
 {
-    return gc_alloc_any(collector, object_new_int(value));
+    heap_ptr loc = gc_alloc_cells(collector, 1);
+    if (loc != 0)
+    {
+        collector->heap[loc] = GC_MAKE_INT(value);
+    }
+    return loc;
 }
 
 heap_ptr gc_alloc_anon(gc * collector)
 {
-    heap_ptr value = gc_alloc_any(collector, object_new_anon());
-    collector->heap[collector->heap_idx][value].object_value->ref_value.ref = value;
-    return value;
+    heap_ptr loc = gc_alloc_cells(collector, 1);
+    if (loc != 0)
+    {
+        collector->heap[loc] = GC_MAKE_CELL(GC_TAG_REF, loc);
+    }
+    return loc;
 }
 
 heap_ptr gc_alloc_var(gc * collector)
 {
-    heap_ptr value = gc_alloc_any(collector, object_new_var());
-    collector->heap[collector->heap_idx][value].object_value->ref_value.ref = value;
-    return value;
+    heap_ptr loc = gc_alloc_cells(collector, 1);
+    if (loc != 0)
+    {
+        collector->heap[loc] = GC_MAKE_CELL(GC_TAG_REF, loc);
+    }
+    return loc;
 }
 
 heap_ptr gc_alloc_ref(gc * collector, heap_ptr ptr_value)
 {
-    return gc_alloc_any(collector, object_new_ref(ptr_value));
+    heap_ptr loc = gc_alloc_cells(collector, 1);
+    if (loc != 0)
+    {
+        collector->heap[loc] = GC_MAKE_CELL(GC_TAG_REF, ptr_value);
+    }
+    return loc;
 }
 
 heap_ptr gc_alloc_struct(gc * collector, heap_size_t size, pc_ptr addr)
 {
-    return gc_alloc_any(collector, object_new_struct(size, addr));
+    heap_size_t i;
+    heap_ptr loc = gc_alloc_cells(collector, 1 + size);
+    if (loc == 0)
+    {
+        return 0;
+    }
+    gc_heap * heap = collector->heap;
+
+    heap[loc] = GC_MAKE_STRUCT(size, addr);
+    for (i = 1; i <= size; i++)
+    {
+        heap[loc + i] = GC_MAKE_CELL(GC_TAG_REF, 0);
+    }
+    return loc;
 }
 
 object_type gc_get_object_type(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    if (collector->heap[collector->heap_idx][addr].object_value != NULL)
+    switch (GC_CELL_TAG(collector->heap[addr]))
     {
-        return collector->heap[collector->heap_idx][addr].object_value->type;
+        case GC_TAG_EMPTY: return OBJECT_UNKNOWN;
+        case GC_TAG_REF: return OBJECT_REF;
+        case GC_TAG_ATOM: return OBJECT_ATOM;
+        case GC_TAG_INT: return OBJECT_INT;
+        case GC_TAG_STRUCT: return OBJECT_STRUCT;
     }
     return OBJECT_UNKNOWN;
 }
 
 heap_ptr gc_get_hp(gc * collector)
 {
-    return collector->free[collector->heap_idx];
+    return collector->free;
 }
 
 void gc_reset_hp(gc * collector, heap_ptr new_hp)
 {
-    if (new_hp >= collector->free[collector->heap_idx])
+    if (new_hp >= collector->free)
     {
         return;
     }
-    heap_ptr h_ptr;
-    for (h_ptr = new_hp; h_ptr < collector->free[collector->heap_idx]; h_ptr++)
+    /* cells above new_hp are unreachable, nothing to release */
+    gc_update_max_used(collector);
+    collector->free = new_hp;
+    if (collector->old_top > new_hp)
     {
-        void * object_value;
-        if ((object_value = collector->heap[collector->heap_idx][h_ptr].object_value) != NULL)
-        {
-            object_delete(object_value);
-            collector->heap[collector->heap_idx][h_ptr].mark = 0;
-            collector->heap[collector->heap_idx][h_ptr].object_value = NULL;
-        }
+        collector->old_top = new_hp;
     }
-    collector->free[collector->heap_idx] = new_hp;
 }
 
+
 atom_idx_t gc_get_atom_idx(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_ATOM);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_ATOM);
 
-    return collector->heap[collector->heap_idx][addr].object_value->atom_value.idx;
+    return (atom_idx_t)GC_CELL_VALUE(GC_CELL(collector, addr));
 }
 
 int gc_get_int_value(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_INT);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_INT);
 
-    return collector->heap[collector->heap_idx][addr].object_value->int_value.value;
+    return GC_CELL_INT(GC_CELL(collector, addr));
 }
 
 void gc_set_int_value(gc * collector, heap_ptr addr, int value)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_INT);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_INT);
 
-    collector->heap[collector->heap_idx][addr].object_value->int_value.value = value;
+    GC_CELL(collector, addr) = GC_MAKE_INT(value);
 }
 
 heap_ptr gc_get_anon_ref(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref;
+    return (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr));
 }
 
 heap_ptr gc_get_var_ref(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref;
+    return (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr));
 }
 
 heap_ptr gc_get_ref_ref(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref;
+    return (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr));
 }
 
 heap_size_t gc_get_struct_size(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_STRUCT);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_STRUCT);
 
-    return collector->heap[collector->heap_idx][addr].object_value->struct_value.size;
+    return GC_CELL_STRUCT_SIZE(GC_CELL(collector, addr));
 }
 
 pc_ptr gc_get_struct_addr(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_STRUCT);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_STRUCT);
 
-    return collector->heap[collector->heap_idx][addr].object_value->struct_value.addr;
+    return GC_CELL_STRUCT_ADDR(GC_CELL(collector, addr));
 }
 
 heap_ptr gc_get_struct_ref(gc * collector, heap_ptr addr, heap_size_t idx)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_STRUCT);
-    assert(collector->heap[collector->heap_idx][addr].object_value->struct_value.size > idx);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_STRUCT);
+    assert(GC_CELL_STRUCT_SIZE(GC_CELL(collector, addr)) > idx);
 
-    return collector->heap[collector->heap_idx][addr].object_value->struct_value.refs[idx];
+    return (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + 1 + idx));
 }
 
 atom_idx_t gc_set_atom_idx(gc * collector, heap_ptr addr, atom_idx_t idx)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_ATOM);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_ATOM);
 
-    return collector->heap[collector->heap_idx][addr].object_value->atom_value.idx = idx;
+    GC_CELL(collector, addr) = GC_MAKE_CELL(GC_TAG_ATOM, idx);
+    return idx;
+}
+
+static void gc_remember(gc * collector, heap_ptr addr)
+{
+    if (collector->remembered_top == collector->remembered_size)
+    {
+        collector->remembered_size *= 2;
+        collector->remembered = (heap_ptr *)realloc(collector->remembered,
+                                    sizeof(heap_ptr) * collector->remembered_size);
+        assert(collector->remembered != NULL);
+    }
+    collector->remembered[collector->remembered_top++] = addr;
+}
+
+/* old cell addr gets pointer into nursery */
+static inline void gc_write_barrier(gc * collector, heap_ptr addr, heap_ptr ref)
+{
+    if (addr < collector->old_top && ref >= collector->old_top)
+    {
+        gc_remember(collector, addr);
+    }
 }
 
 heap_ptr gc_set_anon_ref(gc * collector, heap_ptr addr, heap_ptr ref)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref = ref;
+    gc_write_barrier(collector, addr, ref);
+    GC_CELL(collector, addr) = GC_MAKE_CELL(GC_TAG_REF, ref);
+    return ref;
 }
 
 heap_ptr gc_set_var_ref(gc * collector, heap_ptr addr, heap_ptr ref)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref = ref;
+    gc_write_barrier(collector, addr, ref);
+    GC_CELL(collector, addr) = GC_MAKE_CELL(GC_TAG_REF, ref);
+    return ref;
 }
 
 heap_ptr gc_set_ref_ref(gc * collector, heap_ptr addr, heap_ptr ref)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    return collector->heap[collector->heap_idx][addr].object_value->ref_value.ref = ref;
+    gc_write_barrier(collector, addr, ref);
+    GC_CELL(collector, addr) = GC_MAKE_CELL(GC_TAG_REF, ref);
+    return ref;
 }
 
 heap_ptr gc_reset_ref(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_REF);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_REF);
 
-    collector->heap[collector->heap_idx][addr].object_value->ref_value.ref = addr;
+    GC_CELL(collector, addr) = GC_MAKE_CELL(GC_TAG_REF, addr);
     return addr;
 }
 
 heap_ptr gc_set_struct_ref(gc * collector, heap_ptr addr, heap_size_t idx, heap_ptr ref)
 {
     assert(collector->size > addr);
-    assert(collector->heap[collector->heap_idx][addr].object_value->type == OBJECT_STRUCT);
-    assert(collector->heap[collector->heap_idx][addr].object_value->struct_value.size > idx);
+    assert(GC_CELL_TAG(GC_CELL(collector, addr)) == GC_TAG_STRUCT);
+    assert(GC_CELL_STRUCT_SIZE(GC_CELL(collector, addr)) > idx);
 
-    return collector->heap[collector->heap_idx][addr].object_value->struct_value.refs[idx] = ref;
+    gc_write_barrier(collector, addr + 1 + idx, ref);
+    GC_CELL(collector, addr + 1 + idx) = GC_MAKE_CELL(GC_TAG_REF, ref);
+    return ref;
 }
 
 void gc_print_ref(gc * collector, heap_ptr addr)
 {
     assert(collector->size > addr);
-    object_print_str(collector->heap[collector->heap_idx][addr].object_value, NULL, 0);
+
+    gc_heap cell = GC_CELL(collector, addr);
+    switch (GC_CELL_TAG(cell))
+    {
+        case GC_TAG_EMPTY:
+        break;
+        case GC_TAG_ATOM:
+            printf("%s %u\n", object_type_str(OBJECT_ATOM), (atom_idx_t)GC_CELL_VALUE(cell));
+        break;
+        case GC_TAG_INT:
+            printf("%s %d\n", object_type_str(OBJECT_INT), GC_CELL_INT(cell));
+        break;
+        case GC_TAG_REF:
+            printf("%s %u\n", object_type_str(OBJECT_REF), (heap_ptr)GC_CELL_VALUE(cell));
+        break;
+        case GC_TAG_STRUCT:
+        {
+            heap_size_t i;
+            printf("%s %u ", object_type_str(OBJECT_STRUCT), GC_CELL_STRUCT_SIZE(cell));
+            for (i = 1; i <= GC_CELL_STRUCT_SIZE(cell); i++) {
+                printf("%u ", (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + i)));
+            }
+            printf("\n");
+        }
+        break;
+    }
 }
 
 void gc_print_ref_str(gc * collector, heap_ptr addr, char ** strtab_array, unsigned int strtab_size)
 {
     assert(collector->size > addr);
 
-    switch (collector->heap[collector->heap_idx][addr].object_value->type)
+    gc_heap cell = GC_CELL(collector, addr);
+    switch (GC_CELL_TAG(cell))
     {
-        case OBJECT_UNKNOWN:
+        case GC_TAG_EMPTY:
             printf("%s\n", object_type_str(OBJECT_UNKNOWN));
         break;
-        case OBJECT_ATOM:
-            object_print_str(collector->heap[collector->heap_idx][addr].object_value, strtab_array, strtab_size);
+        case GC_TAG_ATOM:
+        {
+            atom_idx_t idx = (atom_idx_t)GC_CELL_VALUE(cell);
+            if (strtab_array != NULL && (idx < strtab_size))
+            {
+                printf("%s %u:%s\n", object_type_str(OBJECT_ATOM), idx, strtab_array[idx]);
+            }
+            else
+            {
+                printf("%s %u\n", object_type_str(OBJECT_ATOM), idx);
+            }
+        }
         break;
-        case OBJECT_INT:
-            object_print_str(collector->heap[collector->heap_idx][addr].object_value, strtab_array, strtab_size);
+        case GC_TAG_INT:
+            printf("%s %d\n", object_type_str(OBJECT_INT), GC_CELL_INT(cell));
         break;
-        case OBJECT_REF:
-            if (addr != collector->heap[collector->heap_idx][addr].object_value->ref_value.ref)
+        case GC_TAG_REF:
+            if (addr != GC_CELL_VALUE(cell))
             {
-                gc_print_ref_str(collector, collector->heap[collector->heap_idx][addr].object_value->ref_value.ref, strtab_array, strtab_size);
+                gc_print_ref_str(collector, (heap_ptr)GC_CELL_VALUE(cell), strtab_array, strtab_size);
             }
         break;
-        case OBJECT_STRUCT:
+        case GC_TAG_STRUCT:
         {
-            unsigned int i = 0;
-            printf("%s/%u\n", object_type_str(OBJECT_STRUCT), collector->heap[collector->heap_idx][addr].object_value->struct_value.size);
-            for (i = 0; i < collector->heap[collector->heap_idx][addr].object_value->struct_value.size; i++)
+            heap_size_t i = 0;
+            printf("%s/%u\n", object_type_str(OBJECT_STRUCT), GC_CELL_STRUCT_SIZE(cell));
+            for (i = 1; i <= GC_CELL_STRUCT_SIZE(cell); i++)
             {
-                gc_print_ref_str(collector, collector->heap[collector->heap_idx][addr].object_value->struct_value.refs[i], strtab_array, strtab_size);
+                gc_print_ref_str(collector, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + i)), strtab_array, strtab_size);
             }
         }
         break;
@@ -465,6 +913,9 @@ gc_stack * gc_stack_new(stack_size_t size)
     return stack;
 }
 
-void gc_stack_delete(gc_stack * stack) { free(stack); }
-
+gc_stack * gc_stack_resize(gc_stack * stack, stack_size_t size)
+{
+    return (gc_stack *)realloc(stack, size * sizeof(gc_stack));
+}
 
+void gc_stack_delete(gc_stack * stack) { free(stack); }
@@ -22,16 +22,45 @@
 #ifndef __GC_H__
 #define __GC_H__
 
+#include <stdint.h>
 #include "object.h"
 
-typedef struct gc_heap
-{
-    char mark;
-    union {
-        object * object_value;
-        heap_ptr back_ptr; // used to correct references
-    };
-} gc_heap;
+/**
+ * Heap is a flat array of tagged words. Tag is kept in the lowest bits,
+ * payload in the remaining ones:
+ *
+ *   GC_TAG_EMPTY   unused cell (word 0)
+ *   GC_TAG_REF     heap_ptr, unbound variable points to itself
+ *   GC_TAG_ATOM    atom_idx_t
+ *   GC_TAG_INT     int
+ *   GC_TAG_STRUCT  header, size and functor addr, followed by
+ *                  size argument cells holding heap_ptr (tagged as refs)
+ */
+typedef uint64_t gc_heap;
+
+typedef enum gc_tag {
+    GC_TAG_EMPTY = 0,
+    GC_TAG_REF = 1,
+    GC_TAG_ATOM = 2,
+    GC_TAG_INT = 3,
+    GC_TAG_STRUCT = 4
+} gc_tag;
+
+#define GC_TAG_BITS 3
+#define GC_TAG_MASK ((gc_heap)((1 << GC_TAG_BITS) - 1))
+
+#define GC_CELL_TAG(cell) ((gc_tag)((cell) & GC_TAG_MASK))
+#define GC_CELL_VALUE(cell) ((cell) >> GC_TAG_BITS)
+#define GC_CELL_INT(cell) ((int)((int64_t)(cell) >> GC_TAG_BITS))
+#define GC_CELL_STRUCT_SIZE(cell) ((heap_size_t)(((cell) >> GC_TAG_BITS) & 0x1fffffff))
+#define GC_CELL_STRUCT_ADDR(cell) ((pc_ptr)((cell) >> 32))
+
+#define GC_MAKE_CELL(tag, value) ((((gc_heap)(value)) << GC_TAG_BITS) | (tag))
+#define GC_MAKE_INT(value) ((((gc_heap)(int64_t)(value)) << GC_TAG_BITS) | GC_TAG_INT)
+#define GC_MAKE_STRUCT(size, addr) \
+    ((((gc_heap)(addr)) << 32) | (((gc_heap)(size)) << GC_TAG_BITS) | GC_TAG_STRUCT)
+
+#define GC_CELL(collector, addr) ((collector)->heap[addr])
 
 typedef enum gc_stack_type {
     STACK_TYPE_UNKNOWN = 0,
@@ -51,23 +80,88 @@ typedef struct gc_stack
     };
 } gc_stack;
 
+typedef enum gc_policy {
+    GC_POLICY_ALWAYS = 0, /* collect on every call */
+    GC_POLICY_THRESHOLD = 1, /* collect when heap occupancy passes trigger */
+    GC_POLICY_GENERATIONAL = 2 /* collect nursery when full, whole heap past trigger */
+} gc_policy;
+
+#define GC_NURSERY_SIZE 8192
+
+/* allocations of 1 .. GC_SIZE_CLASSES - 1 cells are counted apart, larger together */
+#define GC_SIZE_CLASSES 8
+
+typedef struct gc_stats
+{
+    unsigned long run_count; /* number of collections */
+    unsigned long reclaimed; /* cells reclaimed by collections */
+    heap_size_t max_live; /* largest heap occupancy after a collection */
+    heap_size_t max_used; /* largest heap occupancy */
+    double run_time; /* time spent in gc_run (seconds) */
+    double max_pause; /* longest gc_run (seconds) */
+    unsigned long minor_count; /* number of nursery collections */
+    unsigned long promoted; /* cells moved from nursery to old generation */
+    double minor_time; /* time spent in gc_run_minor (seconds) */
+    double minor_max_pause; /* longest gc_run_minor (seconds) */
+    unsigned long alloc_count[GC_SIZE_CLASSES]; /* allocations by size in cells */
+    unsigned long alloc_cells; /* cells allocated */
+} gc_stats;
+
 typedef struct gc
 {
-    gc_heap * heap[2];
-    heap_size_t free[2];
-    unsigned int heap_idx;
+    gc_heap * heap;
+    char * mark;
+    heap_ptr * mark_stack; /* pending cells of gc_mark */
+    heap_size_t mark_size;
+    heap_size_t mark_top;
+    heap_size_t free; /* heap top, cells are allocated and released in order */
     heap_size_t size;
+    heap_size_t max_size; /* heap grows on demand up to max_size */
+
+    gc_policy policy;
+    double threshold; /* fraction of size which triggers collection */
+    double growth; /* trigger growth factor relative to live cells, <= 1 disables */
+    heap_size_t trigger; /* collect when free passes trigger */
+
+    /*
+     * Generational policy. Cells below old_top are old, cells above form
+     * the nursery. Old cells which get a pointer into nursery are kept in
+     * remembered set by write barrier of gc_set_*_ref.
+     */
+    heap_ptr old_top;
+    heap_size_t nursery_size;
+    heap_ptr * remembered;
+    heap_size_t remembered_size;
+    heap_size_t remembered_top;
+    heap_ptr * forward; /* new addresses of cells during compaction */
+    heap_size_t forward_size;
+    gc_stats stats;
 } gc;
 
 gc * gc_new(heap_size_t size);
 void gc_delete(gc * collector);
 
+void gc_set_max_size(gc * collector, heap_size_t max_size);
+char gc_grow(gc * collector, heap_size_t min_size);
+void gc_set_policy(gc * collector, gc_policy policy, double threshold, double growth);
+void gc_set_nursery(gc * collector, heap_size_t nursery_size);
+char gc_need_run(gc * collector);
+
 void gc_mark(gc * collector, heap_size_t addr);
 void gc_run(gc * collector,
             gc_stack * omfalos, stack_ptr stack_size,
             gc_stack * trail, stack_ptr trail_size);
+void gc_run_minor(gc * collector,
+                  gc_stack * omfalos, stack_ptr stack_size,
+                  gc_stack * trail, stack_ptr trail_size);
+void gc_collect(gc * collector,
+                gc_stack * omfalos, stack_ptr stack_size,
+                gc_stack * trail, stack_ptr trail_size);
+void gc_update_max_used(gc * collector);
+void gc_print_stats(gc * collector);
+const char * gc_policy_to_str(gc_policy policy);
 
-heap_ptr gc_alloc_any(gc * collector, object * value);
+heap_ptr gc_alloc_cells(gc * collector, heap_size_t count);
 heap_ptr gc_alloc_atom(gc * collector, atom_idx_t idx);
 heap_ptr gc_alloc_int(gc * collector, int value);
 heap_ptr gc_alloc_anon(gc * collector);
@@ -100,6 +194,7 @@ void gc_print_ref(gc * collector, heap_ptr addr);
 void gc_print_ref_str(gc * collector, heap_ptr addr, char ** strtab_array, unsigned int strtab_size);
 
 gc_stack * gc_stack_new(stack_size_t size);
+gc_stack * gc_stack_resize(gc_stack * stack, stack_size_t size);
 void gc_stack_delete(gc_stack * stack);
 
 #endif /* __GC_H__ */
@@ -20,11 +20,17 @@
  * THE SOFTWARE.
  */
 #include "gencode.h"
+#include "peephole.h"
 #include "bytecode.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 gencode * gencode_new()
 {
@@ -33,6 +39,16 @@ gencode * gencode_new()
     value->strtab_value = strtab_new(32);
     value->current_addr = 0;
     value->list = bytecode_list_new();
+    value->index = 1;
+    value->occurs_check = 1;
+    value->peephole = 1;
+    value->fuse = 1;
+    value->generated_size = 0;
+    value->ground_vars = var_list_new();
+    value->predicates = clause_list_new();
+    value->predicate_arr = NULL;
+    value->predicate_size = 0;
+    value->base_atoms = NULL;
 
     return value;
 }
@@ -47,6 +63,18 @@ void gencode_delete(gencode * value)
     {
         bytecode_list_delete(value->list);
     }
+    if (value->ground_vars)
+    {
+        var_list_delete_null(value->ground_vars);
+    }
+    if (value->predicates)
+    {
+        clause_list_delete_null(value->predicates);
+    }
+    if (value->predicate_arr)
+    {
+        free(value->predicate_arr);
+    }
     free(value);
 }
 
@@ -58,12 +86,35 @@ gencode_binary * gencode_binary_new()
     value->strtab_size = 0;
     value->code_array = NULL;
     value->code_size = 0;
+    value->predicate_arr = NULL;
+    value->predicate_size = 0;
+    value->stack_reserve = 0;
+    value->int_stack_size = 0;
+    value->threaded_code = NULL;
+    value->compact_code = NULL;
+    value->compact_size = 0;
+    value->compact_addr = NULL;
+    value->image = NULL;
+    value->image_size = 0;
 
     return value;
 }
 
 void gencode_binary_delete(gencode_binary * value)
 {
+    if (value->image != NULL)
+    {
+        /* strings and code are in the mapped image */
+        free(value->strtab_array);
+        munmap(value->image, value->image_size);
+        value->strtab_array = NULL;
+        value->code_array = NULL;
+        value->predicate_arr = NULL;
+    }
+    if (value->predicate_arr != NULL)
+    {
+        free(value->predicate_arr);
+    }
     if (value->strtab_array != NULL)
     {
         strtab_array_delete(value->strtab_array, value->strtab_size);
@@ -72,14 +123,357 @@ void gencode_binary_delete(gencode_binary * value)
     {
         bytecode_array_delete(value->code_array);
     }
+    if (value->threaded_code != NULL)
+    {
+        free(value->threaded_code);
+    }
+    if (value->compact_code != NULL)
+    {
+        free(value->compact_code);
+        free(value->compact_addr);
+    }
     free(value);
 }
 
 void gencode_binary_generate(gencode_binary * value, gencode * gen)
 {
+    unsigned int i = 0;
+    clause_node * node = gen->predicates->head;
+
+    /* predicate names go after atoms so atom indexes do not change */
+    while (node != NULL)
+    {
+        gen->predicate_arr[i].name = strtab_add_string(gen->strtab_value, node->value->name);
+        gen->predicate_arr[i].arity = clause_arity(node->value);
+        gen->predicate_arr[i].addr = node->value->addr;
+        node = node->next;
+        i++;
+    }
+
     bytecode_list_set_addr(gen->list);
+    gen->generated_size = gen->current_addr;
+    if (gen->peephole)
+    {
+        peephole_strip_labels(gen);
+        peephole_jump_chains(gen);
+        peephole_unreachable(gen);
+    }
+    if (gen->fuse)
+    {
+        peephole_fuse(gen);
+    }
+
+    value->predicate_size = gen->predicate_size;
+    value->predicate_arr = (gencode_predicate *)malloc(sizeof(gencode_predicate) * (gen->predicate_size + 1));
+    memcpy(value->predicate_arr, gen->predicate_arr, sizeof(gencode_predicate) * gen->predicate_size);
     strtab_to_array(gen->strtab_value, &value->strtab_array, &value->strtab_size);
-    bytecode_to_array(gen->list, &value->code_array, &value->code_size);
+    bytecode_to_array(gen->list, 0, &value->code_array, &value->code_size);
+    value->stack_reserve = gencode_stack_reserve(value->code_array, value->code_size);
+    value->int_stack_size = gencode_int_stack_size(value->code_array, value->code_size);
+}
+
+/**
+ * Encodes code_array for compact dispatch, see bytecode_array_encode.
+ * Called before running with compact dispatch, for generated and
+ * loaded programs alike.
+ */
+gencode_result gencode_binary_compact(gencode_binary * value)
+{
+    if (value->compact_code != NULL)
+    {
+        return GENCODE_SUCCESS;
+    }
+    if (!bytecode_array_encode(value->code_array, value->code_size,
+                               &value->compact_code, &value->compact_size,
+                               &value->compact_addr))
+    {
+        fprintf(stderr, "program cannot be encoded as compact code\n");
+        return GENCODE_FAILURE;
+    }
+
+    return GENCODE_SUCCESS;
+}
+
+/**
+ * Largest number of entries pushed after PUSH_ENV, or after a return from
+ * a call, before the next PUSH_ENV or call. Pops are not subtracted so
+ * both read and write mode code of a structure are counted. VM checks
+ * stack size once at PUSH_ENV and at nondeterministic return, individual
+ * pushes do not check.
+ */
+unsigned int gencode_stack_reserve(bytecode * code_array, unsigned int code_size)
+{
+    unsigned int i;
+    unsigned int pushed = 0;
+    unsigned int reserve = 0;
+
+    for (i = 0; i < code_size; i++)
+    {
+        switch (code_array[i].type)
+        {
+            case BYTECODE_PUT_REF:
+            case BYTECODE_PUT_VAR:
+            case BYTECODE_PUT_ANON:
+            case BYTECODE_PUT_ATOM:
+            case BYTECODE_PUT_INT:
+            case BYTECODE_SON:
+            case BYTECODE_INT_BOX:
+            case BYTECODE_PUT_REF_U_ATOM:
+            case BYTECODE_PUT_REF_U_STRUCT_ADDR:
+                pushed += 1;
+            break;
+            case BYTECODE_PUT_REF_REF:
+            case BYTECODE_PUT_REF_INT:
+                pushed += 2;
+            break;
+            case BYTECODE_MARK:
+            case BYTECODE_LAST_MARK:
+                pushed += 6;
+            break;
+            case BYTECODE_PUSH_ENV:
+            case BYTECODE_POP_ENV:
+            case BYTECODE_CALL:
+            case BYTECODE_CALL_ADDR:
+            case BYTECODE_LAST_CALL:
+            case BYTECODE_LAST_CALL_ADDR:
+            case BYTECODE_HALT:
+                pushed = 0;
+            break;
+            default:
+            break;
+        }
+        if (pushed > reserve)
+        {
+            reserve = pushed;
+        }
+    }
+
+    return reserve;
+}
+
+/**
+ * Largest number of unboxed integers on vm int stack. Expressions are
+ * evaluated without calls or choice points in between, so the stack is
+ * empty between goals and depth can be followed instruction by instruction.
+ */
+unsigned int gencode_int_stack_size(bytecode * code_array, unsigned int code_size)
+{
+    unsigned int i;
+    unsigned int depth = 0;
+    unsigned int size = 0;
+
+    for (i = 0; i < code_size; i++)
+    {
+        switch (code_array[i].type)
+        {
+            case BYTECODE_INT_PUSH:
+            case BYTECODE_INT_PUSH_REF:
+            case BYTECODE_INT_UNBOX:
+                depth++;
+            break;
+            case BYTECODE_INT_ADD:
+            case BYTECODE_INT_SUB:
+            case BYTECODE_INT_MUL:
+            case BYTECODE_INT_DIV:
+            case BYTECODE_INT_BOX:
+                depth--;
+            break;
+            case BYTECODE_LT:
+            case BYTECODE_GT:
+                depth -= 2;
+            break;
+            default:
+            break;
+        }
+        if (depth > size)
+        {
+            size = depth;
+        }
+    }
+
+    return size;
+}
+
+gencode_result gencode_binary_save(gencode_binary * value, const char * file_name)
+{
+    unsigned int i;
+    unsigned int offset = 0;
+    gencode_binary_header header = { 0 };
+
+    FILE * file = fopen(file_name, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "cannot open file %s: %s\n", file_name, strerror(errno));
+        return GENCODE_FAILURE;
+    }
+
+    memcpy(header.magic, GENCODE_BINARY_MAGIC, sizeof(header.magic));
+    header.version = GENCODE_BINARY_VERSION;
+    header.bytecode_size = sizeof(bytecode);
+    header.bytecode_end = BYTECODE_END;
+    header.code_size = value->code_size;
+    header.strtab_size = value->strtab_size;
+    header.predicate_size = value->predicate_size;
+    header.stack_reserve = value->stack_reserve;
+    header.int_stack_size = value->int_stack_size;
+    for (i = 0; i < value->strtab_size; i++)
+    {
+        if (value->strtab_array[i] != NULL)
+        {
+            header.strtab_bytes += strlen(value->strtab_array[i]) + 1;
+        }
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(value->code_array, sizeof(bytecode), value->code_size, file);
+    fwrite(value->predicate_arr, sizeof(gencode_predicate), value->predicate_size, file);
+    for (i = 0; i < value->strtab_size; i++)
+    {
+        unsigned int string_offset = GENCODE_BINARY_NO_STRING;
+        if (value->strtab_array[i] != NULL)
+        {
+            string_offset = offset;
+            offset += strlen(value->strtab_array[i]) + 1;
+        }
+        fwrite(&string_offset, sizeof(string_offset), 1, file);
+    }
+    for (i = 0; i < value->strtab_size; i++)
+    {
+        if (value->strtab_array[i] != NULL)
+        {
+            fwrite(value->strtab_array[i], strlen(value->strtab_array[i]) + 1, 1, file);
+        }
+    }
+
+    int write_error = ferror(file);
+    if (fclose(file) != 0 || write_error)
+    {
+        fprintf(stderr, "cannot write file %s\n", file_name);
+        return GENCODE_FAILURE;
+    }
+
+    return GENCODE_SUCCESS;
+}
+
+/**
+ * Maps image written by gencode_binary_save. Code is executed directly
+ * from the mapping, only the string pointer array is allocated.
+ */
+gencode_binary * gencode_binary_load(const char * file_name)
+{
+    unsigned int i;
+    struct stat file_stat;
+    gencode_binary_header * header = NULL;
+    gencode_binary * value = NULL;
+    size_t code_bytes, predicate_bytes, strtab_begin;
+    unsigned int * offsets = NULL;
+    char * strings = NULL;
+    void * image = NULL;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot open file %s: %s\n", file_name, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(gencode_binary_header))
+    {
+        fprintf(stderr, "%s: not a plg binary\n", file_name);
+        close(fd);
+        return NULL;
+    }
+
+    image = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map file %s: %s\n", file_name, strerror(errno));
+        return NULL;
+    }
+
+    header = (gencode_binary_header *)image;
+    code_bytes = (size_t)header->code_size * sizeof(bytecode);
+    predicate_bytes = (size_t)header->predicate_size * sizeof(gencode_predicate);
+    strtab_begin = sizeof(gencode_binary_header) + code_bytes + predicate_bytes;
+
+    if (memcmp(header->magic, GENCODE_BINARY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GENCODE_BINARY_VERSION ||
+        header->bytecode_size != sizeof(bytecode) ||
+        header->bytecode_end != BYTECODE_END)
+    {
+        fprintf(stderr, "%s: incompatible plg binary\n", file_name);
+        munmap(image, file_stat.st_size);
+        return NULL;
+    }
+    if ((size_t)file_stat.st_size != strtab_begin +
+        (size_t)header->strtab_size * sizeof(unsigned int) + header->strtab_bytes)
+    {
+        fprintf(stderr, "%s: truncated plg binary\n", file_name);
+        munmap(image, file_stat.st_size);
+        return NULL;
+    }
+
+    value = gencode_binary_new();
+    value->image = image;
+    value->image_size = file_stat.st_size;
+    value->code_array = (bytecode *)((char *)image + sizeof(gencode_binary_header));
+    value->code_size = header->code_size;
+    value->predicate_arr = (gencode_predicate *)((char *)value->code_array + code_bytes);
+    value->predicate_size = header->predicate_size;
+    value->stack_reserve = header->stack_reserve;
+    value->int_stack_size = header->int_stack_size;
+    value->strtab_size = header->strtab_size;
+    value->strtab_array = (char **)malloc(sizeof(char *) * (header->strtab_size + 1));
+
+    offsets = (unsigned int *)((char *)image + strtab_begin);
+    strings = (char *)(offsets + header->strtab_size);
+    for (i = 0; i < header->strtab_size; i++)
+    {
+        value->strtab_array[i] = NULL;
+        if (offsets[i] != GENCODE_BINARY_NO_STRING)
+        {
+            if (offsets[i] >= header->strtab_bytes ||
+                memchr(strings + offsets[i], '\0', header->strtab_bytes - offsets[i]) == NULL)
+            {
+                fprintf(stderr, "%s: corrupted string table\n", file_name);
+                gencode_binary_delete(value);
+                return NULL;
+            }
+            value->strtab_array[i] = strings + offsets[i];
+        }
+    }
+
+    /* code must be linked, see bytecode_list_set_addr */
+    for (i = 0; i < value->code_size; i++)
+    {
+        bytecode_type type = value->code_array[i].type;
+        if (type >= BYTECODE_END ||
+            type == BYTECODE_PUT_STRUCT || type == BYTECODE_U_STRUCT ||
+            type == BYTECODE_CALL || type == BYTECODE_LAST_CALL ||
+            type == BYTECODE_CASE_STRUCT)
+        {
+            fprintf(stderr, "%s: incorrect bytecode at %u\n", file_name, i);
+            gencode_binary_delete(value);
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < value->predicate_size; i++)
+    {
+        gencode_predicate * predicate = value->predicate_arr + i;
+        if (predicate->name >= value->strtab_size ||
+            value->strtab_array[predicate->name] == NULL ||
+            predicate->begin > predicate->end ||
+            predicate->end > value->code_size ||
+            (i > 0 && predicate->begin < value->predicate_arr[i - 1].end))
+        {
+            fprintf(stderr, "%s: incorrect predicate table\n", file_name);
+            gencode_binary_delete(value);
+            return NULL;
+        }
+    }
+
+    return value;
 }
 
 bytecode * gencode_add_bytecode(gencode * value, bytecode * code)
@@ -92,6 +486,142 @@ bytecode * gencode_add_bytecode(gencode * value, bytecode * code)
     return ret;
 }
 
+void gencode_add_predicate(gencode * value, clause * first, pc_ptr begin)
+{
+    unsigned int size = value->predicate_size;
+
+    /* grow when size reaches a power of two */
+    if ((size & (size - 1)) == 0)
+    {
+        value->predicate_arr = (gencode_predicate *)realloc(value->predicate_arr,
+                                    sizeof(gencode_predicate) * (size == 0 ? 1 : 2 * size));
+    }
+
+    value->predicate_arr[size].begin = begin;
+    value->predicate_arr[size].end = value->current_addr;
+    value->predicate_arr[size].addr = 0;
+    value->predicate_arr[size].name = 0;
+    value->predicate_arr[size].arity = 0;
+    value->predicate_size++;
+
+    clause_list_add_end(value->predicates, first);
+}
+
+/* predicate whose entry is addr, structures use it as functor, NULL if none */
+const gencode_predicate * gencode_binary_predicate(const gencode_binary * value, pc_ptr addr)
+{
+    unsigned int low = 0;
+    unsigned int high = value->predicate_size;
+
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (value->predicate_arr[mid].addr < addr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if (low < value->predicate_size && value->predicate_arr[low].addr == addr)
+    {
+        return value->predicate_arr + low;
+    }
+    return NULL;
+}
+
+/**
+ * Generator of a segment for binary_value. Code is addressed after the
+ * binary and new atoms are numbered after its strings. base_atoms holds
+ * strings of the binary with their indexes, see strtab_from_array.
+ * Peephole passes renumber code from 0, so they are not run on segments.
+ */
+gencode * gencode_segment_gencode(const gencode_binary * binary_value, strtab * base_atoms)
+{
+    gencode * value = gencode_new();
+
+    value->current_addr = binary_value->code_size;
+    value->strtab_value->count = binary_value->strtab_size;
+    value->base_atoms = base_atoms;
+    value->peephole = 0;
+    value->fuse = 0;
+
+    return value;
+}
+
+gencode_segment * gencode_segment_new()
+{
+    gencode_segment * value = (gencode_segment *)malloc(sizeof(gencode_segment));
+
+    value->code_addr = 0;
+    value->code_array = NULL;
+    value->code_size = 0;
+    value->strtab_addr = 0;
+    value->strtab_array = NULL;
+    value->strtab_size = 0;
+    value->stack_reserve = 0;
+    value->int_stack_size = 0;
+
+    return value;
+}
+
+void gencode_segment_delete(gencode_segment * value)
+{
+    if (value->code_array != NULL)
+    {
+        bytecode_array_delete(value->code_array);
+    }
+    if (value->strtab_array != NULL)
+    {
+        strtab_array_delete(value->strtab_array, value->strtab_size);
+    }
+    free(value);
+}
+
+void gencode_segment_generate(gencode_segment * value, gencode * gen)
+{
+    strtab * tab = gen->strtab_value;
+    pc_ptr code_addr = gen->list->head != NULL ? gen->list->head->value.addr : gen->current_addr;
+    unsigned int i;
+
+    bytecode_list_set_addr(gen->list);
+    gen->generated_size = gen->current_addr - code_addr;
+
+    value->code_addr = code_addr;
+    bytecode_to_array(gen->list, code_addr, &value->code_array, &value->code_size);
+    value->stack_reserve = gencode_stack_reserve(value->code_array, value->code_size);
+    value->int_stack_size = gencode_int_stack_size(value->code_array, value->code_size);
+
+    /* only atoms added by the segment, binary keeps the others */
+    value->strtab_addr = gen->base_atoms != NULL ? gen->base_atoms->count : 0;
+    value->strtab_size = tab->count > value->strtab_addr ? tab->count - value->strtab_addr : 0;
+    value->strtab_array = (char **)calloc(value->strtab_size + 1, sizeof(char *));
+    for (i = 0; i < tab->size; i++)
+    {
+        if (tab->entries[i].string != NULL && tab->entries[i].order >= value->strtab_addr)
+        {
+            value->strtab_array[tab->entries[i].order - value->strtab_addr] = tab->entries[i].string;
+            tab->entries[i].string = NULL;
+        }
+    }
+}
+
+/* atoms of binary keep their indexes in segments generated for it */
+static unsigned int gencode_atom(gencode * gen, char * name)
+{
+    if (gen->base_atoms != NULL)
+    {
+        unsigned int idx = strtab_lookup_string(gen->base_atoms, name);
+        if (idx != 0)
+        {
+            return idx;
+        }
+    }
+    return strtab_add_string(gen->strtab_value, name);
+}
+
 void var_gencode(gencode * gen, var * value, gencode_result * result)
 {
     switch (value->type)
@@ -166,28 +696,193 @@ void var_get_bound_vars_gencode(gencode * gen, var * value, var_list * bound_var
         case VAR_TYPE_BOUND:
             var_list_add_end(bound_vars, value);
         break;
-        case VAR_TYPE_UNBOUND:
+        case VAR_TYPE_UNBOUND:
+        break;
+        case VAR_TYPE_UNKNOWN:
+            assert(0);
+        break;
+    }
+}
+
+/**
+ * CHECK is left out when occurs check is disabled or the variable is
+ * bound to a ground term, which cannot contain the unbound variable
+ * being bound.
+ */
+void var_list_check_gencode(gencode * gen, var_list * bound_vars, gencode_result * result)
+{
+    var_node * node = bound_vars->head;
+    while (node != NULL)
+    {
+        var * var_value = node->value;
+        if (var_value && gen->occurs_check && !var_is_ground_gencode(gen, var_value))
+        {
+            var_check_gencode(gen, var_value, result);
+        }
+        node = node->next;
+    }
+}
+
+static var * var_first_gencode(var * value)
+{
+    return value->type == VAR_TYPE_BOUND ? value->bound_to : value;
+}
+
+char var_is_ground_gencode(gencode * gen, var * value)
+{
+    var * first = var_first_gencode(value);
+    var_node * node = gen->ground_vars->head;
+
+    while (node != NULL)
+    {
+        if (node->value == first)
+        {
+            return 1;
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+void var_set_ground_gencode(gencode * gen, var * value)
+{
+    if (!var_is_ground_gencode(gen, value))
+    {
+        var_list_add_end(gen->ground_vars, var_first_gencode(value));
+    }
+}
+
+char term_is_ground_gencode(gencode * gen, term * value)
+{
+    switch (value->type)
+    {
+        case TERM_TYPE_ATOM:
+        case TERM_TYPE_INT:
+            return 1;
+        case TERM_TYPE_VAR:
+            return value->t_var.value->type == VAR_TYPE_BOUND &&
+                   var_is_ground_gencode(gen, value->t_var.value);
+        case TERM_TYPE_STRUCT:
+        {
+            term * node = value->t_struct.terms->head;
+            while (node != NULL)
+            {
+                if (!term_is_ground_gencode(gen, node))
+                {
+                    return 0;
+                }
+                node = node->next;
+            }
+            return 1;
+        }
+        case TERM_TYPE_UNKNOWN:
+        case TERM_TYPE_ANON:
+        break;
+    }
+    return 0;
+}
+
+void term_set_ground_gencode(gencode * gen, term * value)
+{
+    switch (value->type)
+    {
+        case TERM_TYPE_VAR:
+            var_set_ground_gencode(gen, value->t_var.value);
+        break;
+        case TERM_TYPE_STRUCT:
+        {
+            term * node = value->t_struct.terms->head;
+            while (node != NULL)
+            {
+                term_set_ground_gencode(gen, node);
+                node = node->next;
+            }
+        }
+        break;
+        case TERM_TYPE_UNKNOWN:
+        case TERM_TYPE_ANON:
+        case TERM_TYPE_ATOM:
+        case TERM_TYPE_INT:
+        break;
+    }
+}
+
+/* arithmetic succeeds only on integers */
+void expr_set_ground_gencode(gencode * gen, expr * value)
+{
+    switch (value->type)
+    {
+        case EXPR_INT:
+        break;
+        case EXPR_VAR:
+            var_set_ground_gencode(gen, value->var_t.value);
+        break;
+        case EXPR_NEG:
+            expr_set_ground_gencode(gen, value->neg.expr_value);
         break;
-        case VAR_TYPE_UNKNOWN:
-            assert(0);
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+        case EXPR_DIV:
+            expr_set_ground_gencode(gen, value->add.left_value);
+            expr_set_ground_gencode(gen, value->add.right_value);
+        break;
+        case EXPR_SUP:
+            expr_set_ground_gencode(gen, value->sup.expr_value);
+        break;
+        case EXPR_SHL:
+            expr_set_ground_gencode(gen, value->shl.expr_value);
+        break;
+        case EXPR_SHR:
+            expr_set_ground_gencode(gen, value->shr.expr_value);
         break;
     }
 }
 
-void var_list_check_gencode(gencode * gen, var_list * bound_vars, gencode_result * result)
+/* variables which are ground once the goal succeeds */
+void goal_ground_gencode(gencode * gen, goal * value)
 {
-    var_node * node = bound_vars->head;
-    while (node != NULL)
+    switch (value->type)
     {
-        var * var_value = node->value;
-        if (var_value)
+        case GOAL_TYPE_UNIFICATION:
         {
-            var_check_gencode(gen, var_value, result);
+            goal_unification * unification = &value->unification;
+            if (unification->variable->type == VAR_TYPE_BOUND &&
+                var_is_ground_gencode(gen, unification->variable))
+            {
+                term_set_ground_gencode(gen, unification->term_value);
+            }
+            else if (term_is_ground_gencode(gen, unification->term_value))
+            {
+                var_set_ground_gencode(gen, unification->variable);
+            }
         }
-        node = node->next;
+        break;
+        case GOAL_TYPE_IS:
+            var_set_ground_gencode(gen, value->is.var_value);
+            expr_set_ground_gencode(gen, value->is.expr_value);
+        break;
+        case GOAL_TYPE_LT:
+            expr_set_ground_gencode(gen, value->lt.left_value);
+            expr_set_ground_gencode(gen, value->lt.right_value);
+        break;
+        case GOAL_TYPE_GT:
+            expr_set_ground_gencode(gen, value->gt.left_value);
+            expr_set_ground_gencode(gen, value->gt.right_value);
+        break;
+        case GOAL_TYPE_LITERAL:
+        case GOAL_TYPE_CUT:
+        case GOAL_TYPE_FAIL:
+        case GOAL_TYPE_BUILTIN:
+        case GOAL_TYPE_UNKNOW:
+        break;
     }
 }
 
+/**
+ * Expressions are evaluated on vm int stack, operands are unboxed when
+ * pushed and only the result of is is allocated on heap, see goal_is_gencode.
+ */
 void expr_gencode(gencode * gen, expr * expr_value, gencode_result * result)
 {
     switch (expr_value->type)
@@ -195,14 +890,29 @@ void expr_gencode(gencode * gen, expr * expr_value, gencode_result * result)
         case EXPR_INT:
         {
             bytecode bc = { 0 };
-            bc.type = BYTECODE_PUT_INT;
-            bc.put_int.value = expr_value->int_t.value;
+            bc.type = BYTECODE_INT_PUSH;
+            bc.int_push.value = expr_value->int_t.value;
             gencode_add_bytecode(gen, &bc);
         }
         break;
         case EXPR_VAR:
         {
-            var_gencode(gen, expr_value->var_t.value, result);
+            if (expr_value->var_t.value->type == VAR_TYPE_BOUND)
+            {
+                bytecode bc = { 0 };
+                bc.type = BYTECODE_INT_PUSH_REF;
+                bc.int_push_ref.index = expr_value->var_t.value->bound_to->index;
+                gencode_add_bytecode(gen, &bc);
+            }
+            else
+            {
+                /* first occurrence, vm stops as variable is not an integer */
+                var_gencode(gen, expr_value->var_t.value, result);
+
+                bytecode bc = { 0 };
+                bc.type = BYTECODE_INT_UNBOX;
+                gencode_add_bytecode(gen, &bc);
+            }
         }
         break;
         case EXPR_NEG:
@@ -256,6 +966,26 @@ void expr_gencode(gencode * gen, expr * expr_value, gencode_result * result)
         case EXPR_SUP:
             expr_gencode(gen, expr_value->sup.expr_value, result);
         break;
+        case EXPR_SHL:
+        {
+            expr_gencode(gen, expr_value->shl.expr_value, result);
+
+            bytecode bc = { 0 };
+            bc.type = BYTECODE_INT_SHL;
+            bc.int_shl.bits = expr_value->shl.bits;
+            gencode_add_bytecode(gen, &bc);
+        }
+        break;
+        case EXPR_SHR:
+        {
+            expr_gencode(gen, expr_value->shr.expr_value, result);
+
+            bytecode bc = { 0 };
+            bc.type = BYTECODE_INT_SHR;
+            bc.int_shr.bits = expr_value->shr.bits;
+            gencode_add_bytecode(gen, &bc);
+        }
+        break;
     }
 }
 
@@ -278,7 +1008,7 @@ void term_gencode(gencode * gen, term * value, gencode_result * result)
         {
             bytecode bc = { 0 };
             bc.type = BYTECODE_PUT_ATOM;
-            bc.put_atom.idx = strtab_add_string(gen->strtab_value, value->t_basic.name);
+            bc.put_atom.idx = gencode_atom(gen, value->t_basic.name);
             gencode_add_bytecode(gen, &bc);
             /* printf("PUT_ATOM %s\n", value->name); */
         }
@@ -331,7 +1061,7 @@ void term_unify_gencode(gencode * gen, term * value, gencode_result * result)
         {
             bytecode bc = { 0 };
             bc.type = BYTECODE_U_ATOM;
-            bc.u_atom.idx = strtab_add_string(gen->strtab_value, value->t_basic.name);
+            bc.u_atom.idx = gencode_atom(gen, value->t_basic.name);
             gencode_add_bytecode(gen, &bc);
             /* printf("UATOM %s\n", value->name); */
         }
@@ -456,8 +1186,34 @@ void term_list_get_bound_vars_gencode(gencode * gen, term_list * list, var_list
     }
 }
 
+/* deterministic builtin runs inline with arguments pushed as for a call */
+void goal_call_builtin_gencode(gencode * gen, const builtin_desc * desc, goal_literal * value, gencode_result * result)
+{
+    if (value->terms != NULL)
+    {
+        term_list_gencode(gen, value->terms, result);
+    }
+
+    bytecode bc = { 0 };
+    bc.type = BYTECODE_CALL_BUILTIN;
+    bc.builtin.id = desc->id;
+    bc.builtin.n = term_list_size(value->terms);
+    if (desc->list)
+    {
+        bc.builtin.nil = gencode_atom(gen, (char *)"[]");
+    }
+    gencode_add_bytecode(gen, &bc);
+}
+
 void goal_literal_gencode(gencode * gen, goal_literal * value, gencode_result * result)
 {
+    const builtin_desc * desc = builtin_clause_inline(value->predicate_ref);
+    if (desc != NULL)
+    {
+        goal_call_builtin_gencode(gen, desc, value, result);
+        return;
+    }
+
     bytecode bc = { 0 };
     bytecode * bc_ptr;
     bc.type = BYTECODE_MARK;
@@ -530,24 +1286,83 @@ void goal_unification_gencode(gencode * gen, goal_unification * value, gencode_r
     }
 }
 
+/* value of expression on stack, folded constant is put without int stack */
+void expr_box_gencode(gencode * gen, expr * value, gencode_result * result)
+{
+    if (value->type == EXPR_INT)
+    {
+        bytecode bc = { 0 };
+        bc.type = BYTECODE_PUT_INT;
+        bc.put_int.value = value->int_t.value;
+        gencode_add_bytecode(gen, &bc);
+        return;
+    }
+
+    expr_gencode(gen, value, result);
+
+    bytecode bc = { 0 };
+    bc.type = BYTECODE_INT_BOX;
+    gencode_add_bytecode(gen, &bc);
+}
+
+/* expression refers to variable, as in X is X + 1 */
+char expr_uses_var_gencode(expr * value, var * var_value)
+{
+    switch (value->type)
+    {
+        case EXPR_INT:
+            return 0;
+        case EXPR_VAR:
+            return value->var_t.value == var_value ||
+                   value->var_t.value->bound_to == var_value;
+        case EXPR_NEG:
+            return expr_uses_var_gencode(value->neg.expr_value, var_value);
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+        case EXPR_DIV:
+            return expr_uses_var_gencode(value->add.left_value, var_value) ||
+                   expr_uses_var_gencode(value->add.right_value, var_value);
+        case EXPR_SUP:
+            return expr_uses_var_gencode(value->sup.expr_value, var_value);
+        case EXPR_SHL:
+            return expr_uses_var_gencode(value->shl.expr_value, var_value);
+        case EXPR_SHR:
+            return expr_uses_var_gencode(value->shr.expr_value, var_value);
+    }
+    return 0;
+}
+
 void goal_is_gencode(gencode * gen, goal_is * value, gencode_result * result)
 {
     switch (value->var_value->type)
     {
         case VAR_TYPE_UNBOUND:
         {
-            var_gencode(gen, value->var_value, result);
-            expr_gencode(gen, value->expr_value, result);
+            if (expr_uses_var_gencode(value->expr_value, value->var_value))
+            {
+                var_gencode(gen, value->var_value, result);
+                expr_box_gencode(gen, value->expr_value, result);
+
+                bytecode bc = { 0 };
+                bc.type = BYTECODE_BIND;
+                gencode_add_bytecode(gen, &bc);
+                /* printf("BIND\n"); */
+                break;
+            }
+
+            /* fresh variable is set to the result, no unbound cell is needed */
+            expr_box_gencode(gen, value->expr_value, result);
 
             bytecode bc = { 0 };
-            bc.type = BYTECODE_BIND;
+            bc.type = BYTECODE_U_VAR;
+            bc.u_var.index = value->var_value->index;
             gencode_add_bytecode(gen, &bc);
-            /* printf("BIND\n"); */
             break;
         }
         case VAR_TYPE_BOUND:
         {
-            expr_gencode(gen, value->expr_value, result);
+            expr_box_gencode(gen, value->expr_value, result);
 
             bytecode bc = { 0 };
             bc.type = BYTECODE_U_REF;
@@ -586,6 +1401,10 @@ void goal_builtin_gencode(gencode * gen, goal * value, gencode_result * result)
     bytecode bc = { 0 };
     bc.type = BYTECODE_BUILTIN;
     bc.builtin.id = value->builtin.id;
+    if (builtin_get(value->builtin.id)->list)
+    {
+        bc.builtin.nil = gencode_atom(gen, (char *)"[]");
+    }
     gencode_add_bytecode(gen, &bc);
 }
 
@@ -671,10 +1490,14 @@ void goal_gencode(gencode * gen, clause * clause_value, unsigned int local_vars,
 
 void goal_list_gencode(gencode * gen, clause * clause_value, unsigned int local_vars, goal_list * list, gencode_result * result)
 {
+    var_list_delete_null(gen->ground_vars);
+    gen->ground_vars = var_list_new();
+
     goal * node = list->head;
     while (node != NULL)
     {
         goal_gencode(gen, clause_value, local_vars, node, result);
+        goal_ground_gencode(gen, node);
         node = node->next;
     }
 }
@@ -778,39 +1601,84 @@ void predicate_0_gencode(gencode * gen, clause * value, gencode_result * result)
     clause_gencode(gen, value, result);
 }
 
-void predicate_N_gencode(gencode * gen, clause_list * list, gencode_result * result)
+/**
+ * Clause heads contain only variables so first argument is tested by
+ * leading unifications like X = a or X = f(Y). Returns the term unified
+ * with the first argument or NULL if clause matches any first argument.
+ */
+term * clause_index_term(clause * value)
 {
-    bytecode bc_addr = { 0 };
-    bc_addr.type = BYTECODE_LABEL;
-    gencode_add_bytecode(gen, &bc_addr);
+    var * first = NULL;
+    goal * node = NULL;
 
-    bytecode bc_set_btp = { 0 };
-    bc_set_btp.type = BYTECODE_SET_BTP;
-    gencode_add_bytecode(gen, &bc_set_btp);
-    /* printf("SETBTP\n"); */
+    if (value->vars == NULL || value->vars->head == NULL ||
+        value->vars->head->value == NULL || value->goals == NULL)
+    {
+        return NULL;
+    }
 
-    // allocate one more so it is easy to calculate clause indexes from 1
-    bytecode ** try_arr = malloc(sizeof(bytecode *) * (list->size + 1));
+    first = value->vars->head->value;
+    node = value->goals->head;
+    while (node != NULL && node->type == GOAL_TYPE_UNIFICATION)
+    {
+        term * term_value = node->unification.term_value;
+        if (node->unification.variable->bound_to == first &&
+            (term_value->type == TERM_TYPE_ATOM ||
+             term_value->type == TERM_TYPE_INT ||
+             term_value->type == TERM_TYPE_STRUCT))
+        {
+            return term_value;
+        }
+        node = node->next;
+    }
 
-    unsigned int clause_nbr = 1;
-    clause_node * node = list->head;
-    assert(node);
-    node->value->addr = bc_addr.addr;
+    return NULL;
+}
 
-    node = node->next; /* omit one clause */
-    while (node != NULL)
+/**
+ * Code which tries clauses from group in order, group holds clause numbers
+ * and addr_arr addresses of their labels.
+ */
+void predicate_try_gencode(gencode * gen, clause ** clause_arr, pc_ptr * addr_arr, unsigned int * group, unsigned int size, gencode_result * result)
+{
+    unsigned int i;
+
+    if (size == 0)
     {
-        if (node->value != NULL)
+        bytecode bc_fail = { 0 };
+        bc_fail.type = BYTECODE_FAIL;
+        gencode_add_bytecode(gen, &bc_fail);
+        return;
+    }
+    if (size == 1)
+    {
+        if (clause_arr[group[0]]->with_cut)
         {
-            bytecode bc_try = { 0 };
-            bc_try.type = BYTECODE_TRY;
-            bc_try.try.offset = 0;
-            try_arr[clause_nbr] = gencode_add_bytecode(gen, &bc_try);
-            /* printf("TRY A%u\n", clause_nbr); */
-
-            clause_nbr++;
+            bytecode bc_set_cut = { 0 };
+            bc_set_cut.type = BYTECODE_SET_CUT;
+            gencode_add_bytecode(gen, &bc_set_cut);
         }
-        node = node->next;
+
+        bytecode bc_jump = { 0 };
+        bytecode * bc_jump_ptr;
+        bc_jump.type = BYTECODE_JUMP;
+        bc_jump_ptr = gencode_add_bytecode(gen, &bc_jump);
+        bc_jump_ptr->jump.offset = addr_arr[group[0]] - bc_jump_ptr->addr;
+        return;
+    }
+
+    bytecode bc_set_btp = { 0 };
+    bc_set_btp.type = BYTECODE_SET_BTP;
+    gencode_add_bytecode(gen, &bc_set_btp);
+    /* printf("SETBTP\n"); */
+
+    for (i = 0; i < size - 1; i++)
+    {
+        bytecode bc_try = { 0 };
+        bc_try.type = BYTECODE_TRY;
+        bc_try.try.offset = addr_arr[group[i]];
+        gencode_add_bytecode(gen, &bc_try);
+        /* printf("TRY A%u\n", group[i]); */
     }
 
     bytecode bc_del_btp = { 0 };
@@ -820,40 +1688,313 @@ void predicate_N_gencode(gencode * gen, clause_list * list, gencode_result * res
 
     bytecode bc_jump = { 0 };
     bytecode * bc_jump_ptr;
-    bytecode * bc_last_clause_ptr;
     bc_jump.type = BYTECODE_JUMP;
     bc_jump_ptr = gencode_add_bytecode(gen, &bc_jump);
-    // cheating so it is easy to generate jumps below
-    try_arr[clause_nbr] = bc_jump_ptr;
-    /* printf("JUMP A%u\n", clause_nbr); */
+    bc_jump_ptr->jump.offset = addr_arr[group[size - 1]] - bc_jump_ptr->addr;
+    /* printf("JUMP A%u\n", group[size - 1]); */
+}
+
+/**
+ * Switch on the first argument. Constants are looked up in a hash table
+ * placed after SWITCH_ON_CONST, structures in a list after SWITCH_ON_STRUCT.
+ * Each key gets clauses with this key and clauses without key, in program
+ * order. When the key is unique no choice point is created. Unbound first
+ * argument falls back to trying all clauses.
+ */
+void predicate_index_gencode(gencode * gen, clause ** clause_arr, pc_ptr * addr_arr, unsigned int clause_size, gencode_result * result)
+{
+    unsigned int i, j, k;
+    unsigned int const_count = 0;
+    unsigned int struct_size = 0;
+    unsigned int var_count = 0;
+    unsigned int key_count = 0;
+    unsigned int table_size = 1;
+
+    /* clauses are numbered from 1 */
+    term ** term_arr = malloc(sizeof(term *) * (clause_size + 1));
+    unsigned int * var_arr = malloc(sizeof(unsigned int) * clause_size);
+
+    for (i = 1; i <= clause_size; i++)
+    {
+        term_arr[i] = clause_index_term(clause_arr[i]);
+        if (term_arr[i] == NULL)
+        {
+            var_arr[var_count++] = i;
+        }
+        else if (term_arr[i]->type != TERM_TYPE_STRUCT)
+        {
+            const_count++;
+        }
+    }
+
+    if (var_count == clause_size)
+    {
+        free(term_arr);
+        free(var_arr);
+        return;
+    }
+
+    while (table_size < 2 * const_count)
+    {
+        table_size *= 2;
+    }
+
+    bytecode * const_table = calloc(table_size, sizeof(bytecode));
+    unsigned int * const_key = malloc(sizeof(unsigned int) * table_size);
+    bytecode * struct_table = calloc(clause_size, sizeof(bytecode));
+    unsigned int * struct_key = malloc(sizeof(unsigned int) * clause_size);
+    unsigned int * key_first = malloc(sizeof(unsigned int) * clause_size);
+    unsigned int * key_last = malloc(sizeof(unsigned int) * clause_size);
+    bytecode ** key_case = malloc(sizeof(bytecode *) * clause_size);
+    unsigned int * next_arr = malloc(sizeof(unsigned int) * (clause_size + 1));
+    unsigned int * group = malloc(sizeof(unsigned int) * clause_size);
+
+    for (i = 0; i < table_size; i++)
+    {
+        const_table[i].type = BYTECODE_CASE_CONST;
+        const_table[i].case_const.type = BYTECODE_CASE_EMPTY;
+    }
+
+    /* find distinct keys, clauses with the same key are chained in next_arr */
+    for (i = 1; i <= clause_size; i++)
+    {
+        term * value = term_arr[i];
+        if (value == NULL)
+        {
+            continue;
+        }
+
+        k = key_count;
+        if (value->type == TERM_TYPE_STRUCT)
+        {
+            unsigned int n = term_list_size(value->t_struct.terms);
+            for (j = 0; j < struct_size; j++)
+            {
+                if (struct_table[j].case_struct.predicate_ref == value->predicate_ref &&
+                    struct_table[j].case_struct.n == n)
+                {
+                    k = struct_key[j];
+                    break;
+                }
+            }
+            if (j == struct_size)
+            {
+                struct_table[j].type = BYTECODE_CASE_STRUCT;
+                struct_table[j].case_struct.n = n;
+                struct_table[j].case_struct.predicate_ref = value->predicate_ref;
+                struct_key[j] = k;
+                struct_size++;
+            }
+        }
+        else
+        {
+            bytecode_case_type type = BYTECODE_CASE_INT;
+            unsigned int key = (unsigned int)value->t_int.value;
+            if (value->type == TERM_TYPE_ATOM)
+            {
+                type = BYTECODE_CASE_ATOM;
+                key = gencode_atom(gen, value->t_basic.name);
+            }
+
+            j = bytecode_case_hash(key, table_size);
+            while (const_table[j].case_const.type != BYTECODE_CASE_EMPTY)
+            {
+                if (const_table[j].case_const.type == type &&
+                    const_table[j].case_const.idx == key)
+                {
+                    k = const_key[j];
+                    break;
+                }
+                j = (j + 1) & (table_size - 1);
+            }
+            if (const_table[j].case_const.type == BYTECODE_CASE_EMPTY)
+            {
+                const_table[j].case_const.type = type;
+                const_table[j].case_const.idx = key;
+                const_key[j] = k;
+            }
+        }
+
+        next_arr[i] = 0;
+        if (k == key_count)
+        {
+            key_first[k] = key_last[k] = i;
+            key_count++;
+        }
+        else
+        {
+            next_arr[key_last[k]] = i;
+            key_last[k] = i;
+        }
+    }
+
+    bytecode bc_switch = { 0 };
+    bytecode * bc_switch_ptr;
+    bc_switch.type = BYTECODE_SWITCH_ON_TERM;
+    bc_switch_ptr = gencode_add_bytecode(gen, &bc_switch);
+
+    if (struct_size > 0)
+    {
+        bytecode bc_label = { 0 };
+        bc_label.type = BYTECODE_LABEL;
+        bc_switch_ptr->switch_on_term.struct_offset = gencode_add_bytecode(gen, &bc_label)->addr;
+
+        bytecode bc_switch_struct = { 0 };
+        bc_switch_struct.type = BYTECODE_SWITCH_ON_STRUCT;
+        bc_switch_struct.switch_on_struct.size = struct_size;
+        gencode_add_bytecode(gen, &bc_switch_struct);
+
+        for (j = 0; j < struct_size; j++)
+        {
+            key_case[struct_key[j]] = gencode_add_bytecode(gen, &struct_table[j]);
+        }
+        predicate_try_gencode(gen, clause_arr, addr_arr, var_arr, var_count, result);
+    }
+
+    if (const_count > 0)
+    {
+        bytecode bc_label = { 0 };
+        bc_label.type = BYTECODE_LABEL;
+        bc_switch_ptr->switch_on_term.const_offset = gencode_add_bytecode(gen, &bc_label)->addr;
+
+        bytecode bc_switch_const = { 0 };
+        bc_switch_const.type = BYTECODE_SWITCH_ON_CONST;
+        bc_switch_const.switch_on_const.size = table_size;
+        gencode_add_bytecode(gen, &bc_switch_const);
+
+        for (j = 0; j < table_size; j++)
+        {
+            bytecode * bc_case_ptr = gencode_add_bytecode(gen, &const_table[j]);
+            if (const_table[j].case_const.type != BYTECODE_CASE_EMPTY)
+            {
+                key_case[const_key[j]] = bc_case_ptr;
+            }
+        }
+        predicate_try_gencode(gen, clause_arr, addr_arr, var_arr, var_count, result);
+    }
+
+    if (const_count == 0 || struct_size == 0)
+    {
+        /* no keys of this kind, only clauses without key match */
+        bytecode bc_label = { 0 };
+        bc_label.type = BYTECODE_LABEL;
+        pc_offset addr = gencode_add_bytecode(gen, &bc_label)->addr;
+        if (const_count == 0)
+        {
+            bc_switch_ptr->switch_on_term.const_offset = addr;
+        }
+        if (struct_size == 0)
+        {
+            bc_switch_ptr->switch_on_term.struct_offset = addr;
+        }
+        predicate_try_gencode(gen, clause_arr, addr_arr, var_arr, var_count, result);
+    }
+
+    for (k = 0; k < key_count; k++)
+    {
+        unsigned int size = 0;
+        unsigned int c = key_first[k];
+        unsigned int v = 0;
+
+        /* merge clauses with key k and clauses without key */
+        while (c != 0 || v < var_count)
+        {
+            if (c != 0 && (v == var_count || c < var_arr[v]))
+            {
+                group[size++] = c;
+                c = next_arr[c];
+            }
+            else
+            {
+                group[size++] = var_arr[v++];
+            }
+        }
+
+        bytecode bc_label = { 0 };
+        bc_label.type = BYTECODE_LABEL;
+        pc_offset addr = gencode_add_bytecode(gen, &bc_label)->addr;
+        if (key_case[k]->type == BYTECODE_CASE_STRUCT)
+        {
+            key_case[k]->case_struct.offset = addr;
+        }
+        else
+        {
+            key_case[k]->case_const.offset = addr;
+        }
+
+        predicate_try_gencode(gen, clause_arr, addr_arr, group, size, result);
+    }
+
+    bytecode bc_label_var = { 0 };
+    bc_label_var.type = BYTECODE_LABEL;
+    bc_switch_ptr->switch_on_term.var_offset = gencode_add_bytecode(gen, &bc_label_var)->addr;
+
+    free(term_arr);
+    free(var_arr);
+    free(const_table);
+    free(const_key);
+    free(struct_table);
+    free(struct_key);
+    free(key_first);
+    free(key_last);
+    free(key_case);
+    free(next_arr);
+    free(group);
+}
+
+/**
+ * Clauses come first and the predicate entry follows them, so choice point
+ * and indexing code can refer to clause addresses and atoms in the string
+ * table keep the order in which clauses use them. Clauses never fall through.
+ */
+void predicate_N_gencode(gencode * gen, clause_list * list, gencode_result * result)
+{
+    unsigned int clause_size = 0;
+
+    // allocate one more so it is easy to calculate clause indexes from 1
+    clause ** clause_arr = malloc(sizeof(clause *) * (list->size + 1));
+    pc_ptr * addr_arr = malloc(sizeof(pc_ptr) * (list->size + 1));
+    unsigned int * group = malloc(sizeof(unsigned int) * list->size);
 
-    clause_nbr = 1;
-    node = list->head;
+    clause_node * node = list->head;
+    assert(node);
     while (node != NULL)
     {
         if (node->value != NULL)
         {
+            clause_size++;
+            clause_arr[clause_size] = node->value;
+            group[clause_size - 1] = clause_size;
+
             bytecode bc_label = { 0 };
-            bytecode * bc_label_ptr;
             bc_label.type = BYTECODE_LABEL;
-            bc_last_clause_ptr = bc_label_ptr = gencode_add_bytecode(gen, &bc_label);
-            try_arr[clause_nbr]->try.offset = bc_label_ptr->addr;
-            //try_arr[clause_nbr]->try.offset = bc_label_ptr->addr; - try_arr[clause_nbr]->addr;
-
-            /* printf("A%u:\n", clause_nbr); */
-            clause_nbr++;
+            addr_arr[clause_size] = gencode_add_bytecode(gen, &bc_label)->addr;
+            /* printf("A%u:\n", clause_size); */
 
             clause_gencode(gen, node->value, result);
         }
         node = node->next;
     }
-    bc_jump_ptr->jump.offset = bc_last_clause_ptr->addr - bc_jump_ptr->addr;
 
-    free(try_arr);
+    bytecode bc_addr = { 0 };
+    bc_addr.type = BYTECODE_LABEL;
+    gencode_add_bytecode(gen, &bc_addr);
+    list->head->value->addr = bc_addr.addr;
+
+    if (gen->index)
+    {
+        predicate_index_gencode(gen, clause_arr, addr_arr, clause_size, result);
+    }
+    predicate_try_gencode(gen, clause_arr, addr_arr, group, clause_size, result);
+
+    free(clause_arr);
+    free(addr_arr);
+    free(group);
 }
 
 void predicate_gencode(gencode * gen, clause_list * list, gencode_result * result)
 {
+    pc_ptr begin = gen->current_addr;
     clause_node * node = list->head;
     if (node && node->value)
     {
@@ -870,6 +2011,10 @@ void predicate_gencode(gencode * gen, clause_list * list, gencode_result * resul
     {
         predicate_N_gencode(gen, list, result);
     }
+    if (node && node->value != NULL)
+    {
+        gencode_add_predicate(gen, node->value, begin);
+    }
 }
 
 void predicate_gather_gencode(gencode * gen, clause_node * first, gencode_result * result)
@@ -22,6 +22,7 @@
 #ifndef __GENCODE_H__
 #define __GENCODE_H__
 
+#include <stddef.h>
 #include "program.h"
 #include "query.h"
 #include "clause.h"
@@ -30,17 +31,40 @@
 #include "bytecode.h"
 #include "strtab.h"
 #include "expr.h"
+#include "builtin.h"
 
 typedef enum gencode_result {
     GENCODE_SUCCESS = 0,
     GENCODE_FAILURE = 1
 } gencode_result;
 
+/* code range of a predicate, used to report on predicates at run time */
+typedef struct gencode_predicate {
+    pc_ptr begin; /* first instruction */
+    pc_ptr end; /* one past last instruction */
+    pc_ptr addr; /* entry */
+    atom_idx_t name; /* index in strtab_array */
+    unsigned int arity;
+} gencode_predicate;
+
 typedef struct gencode {
     strtab * strtab_value;
 
     unsigned int current_addr;
     bytecode_list * list;
+
+    char index; /* first argument indexing, see predicate_index_gencode */
+    char occurs_check; /* emit CHECK before binding to a structure */
+    char peephole; /* remove labels, jump chains and unreachable code */
+    char fuse; /* replace instruction pairs with superinstructions, see peephole_fuse */
+    unsigned int generated_size; /* instructions before peephole passes */
+    var_list * ground_vars; /* bound to ground terms at current goal */
+
+    clause_list * predicates; /* first clause of each predicate */
+    gencode_predicate * predicate_arr; /* names set by gencode_binary_generate */
+    unsigned int predicate_size;
+
+    strtab * base_atoms; /* atoms of binary a segment is generated for, see gencode_segment */
 } gencode;
 
 typedef struct gencode_binary {
@@ -49,22 +73,99 @@ typedef struct gencode_binary {
 
     bytecode * code_array;
     unsigned int code_size;
+
+    gencode_predicate * predicate_arr; /* ordered by address */
+    unsigned int predicate_size;
+
+    unsigned int stack_reserve; /* entries pushed between frame checks, see gencode_stack_reserve */
+    unsigned int int_stack_size; /* unboxed arithmetic depth, see gencode_int_stack_size */
+
+    void ** threaded_code; /* handler labels, see vm_thread_code */
+
+    unsigned char * compact_code; /* see gencode_binary_compact */
+    unsigned int compact_size; /* bytes */
+    pc_ptr * compact_addr; /* byte offset of each instruction */
+
+    void * image; /* mapped file when loaded by gencode_binary_load */
+    size_t image_size;
 } gencode_binary;
 
+/**
+ * Code of a query generated for an already compiled binary. Instructions
+ * are addressed from code_addr, right after the code of the binary, and
+ * calls go to predicates of the binary. Atoms not found in the binary are
+ * numbered from strtab_addr. Binary is not changed, so one binary may be
+ * shared by segments of many queries.
+ */
+typedef struct gencode_segment {
+    pc_ptr code_addr;
+    bytecode * code_array;
+    unsigned int code_size;
+
+    atom_idx_t strtab_addr;
+    char ** strtab_array;
+    unsigned int strtab_size;
+
+    unsigned int stack_reserve;
+    unsigned int int_stack_size;
+} gencode_segment;
+
+/**
+ * Binary image written by gencode_binary_save. Header is followed by
+ * code_array, predicate_arr, strtab_size string offsets (GENCODE_BINARY_NO_STRING for
+ * missing strings) and strtab_bytes of null terminated strings.
+ * Bytecodes are stored as they are in memory so images are only valid
+ * for the same build of plg. Increase version when layout changes.
+ */
+#define GENCODE_BINARY_MAGIC "PLGB"
+#define GENCODE_BINARY_VERSION 6
+#define GENCODE_BINARY_NO_STRING 0xffffffff
+
+typedef struct gencode_binary_header {
+    char magic[4];
+    unsigned int version;
+    unsigned int bytecode_size;
+    unsigned int bytecode_end;
+    unsigned int code_size;
+    unsigned int strtab_size;
+    unsigned int strtab_bytes;
+    unsigned int predicate_size;
+    unsigned int stack_reserve;
+    unsigned int int_stack_size;
+} gencode_binary_header;
+
 gencode * gencode_new();
 void gencode_delete(gencode * value);
 
 gencode_binary * gencode_binary_new();
 void gencode_binary_delete(gencode_binary * value);
 void gencode_binary_generate(gencode_binary * value, gencode * gen);
+unsigned int gencode_stack_reserve(bytecode * code_array, unsigned int code_size);
+unsigned int gencode_int_stack_size(bytecode * code_array, unsigned int code_size);
+gencode_result gencode_binary_compact(gencode_binary * value);
+gencode_result gencode_binary_save(gencode_binary * value, const char * file_name);
+gencode_binary * gencode_binary_load(const char * file_name);
+const gencode_predicate * gencode_binary_predicate(const gencode_binary * value, pc_ptr addr);
+
+gencode * gencode_segment_gencode(const gencode_binary * binary_value, strtab * base_atoms);
+gencode_segment * gencode_segment_new();
+void gencode_segment_delete(gencode_segment * value);
+void gencode_segment_generate(gencode_segment * value, gencode * gen);
 
 bytecode * gencode_add_bytecode(gencode * value, bytecode * code);
+void gencode_add_predicate(gencode * value, clause * first, pc_ptr begin);
 
 void var_gencode(gencode * gen, var * value, gencode_result * result);
 void var_unify_gencode(gencode * gen, var * value, gencode_result * result);
 void var_check_gencode(gencode * gen, var * value, gencode_result * result);
 void var_get_bound_vars_gencode(gencode * gen, var * value, var_list * bound_vars, gencode_result * result);
 void var_list_check_gencode(gencode * gen, var_list * bound_vars, gencode_result * result);
+char var_is_ground_gencode(gencode * gen, var * value);
+void var_set_ground_gencode(gencode * gen, var * value);
+char term_is_ground_gencode(gencode * gen, term * value);
+void term_set_ground_gencode(gencode * gen, term * value);
+void expr_set_ground_gencode(gencode * gen, expr * value);
+void goal_ground_gencode(gencode * gen, goal * value);
 void expr_gencode(gencode * gen, expr * expr_value, gencode_result * result);
 void term_gencode(gencode * gen, term * value, gencode_result * result);
 void term_unify_gencode(gencode * gen, term * value, gencode_result * result);
@@ -75,9 +176,12 @@ void term_list_get_bound_vars_gencode(gencode * gen, term_list * list, var_list
 void goal_literal_gencode(gencode * gen, goal_literal * value, gencode_result * result);
 void goal_last_literal_gencode(gencode * gen, clause * clause_value, goal_literal * value, gencode_result * result);
 void goal_unification_gencode(gencode * gen, goal_unification * value, gencode_result * result);
+void expr_box_gencode(gencode * gen, expr * value, gencode_result * result);
+char expr_uses_var_gencode(expr * value, var * var_value);
 void goal_is_gencode(gencode * gen, goal_is * value, gencode_result * result);
 void goal_cut_gencode(gencode * gen, unsigned int local_vars, goal_cut * value, gencode_result * result);
 void goal_fail_gencode(gencode * gen, goal * goal, gencode_result * result);
+void goal_call_builtin_gencode(gencode * gen, const builtin_desc * desc, goal_literal * value, gencode_result * result);
 void goal_builtin_gencode(gencode * gen, goal * value, gencode_result * result);
 void goal_lt_gencode(gencode * gen, goal * value, gencode_result * result);
 void goal_gt_gencode(gencode * gen, goal * value, gencode_result * result);
@@ -87,6 +191,9 @@ goal_search clause_has_goal(clause * first, goal_list * list, goal ** last);
 void clause_gencode(gencode * gen, clause * value, gencode_result * result);
 char predicate_last_call_opt(clause * first, clause_list * list);
 void predicate_0_gencode(gencode * gen, clause * value, gencode_result * result);
+term * clause_index_term(clause * value);
+void predicate_try_gencode(gencode * gen, clause ** clause_arr, pc_ptr * addr_arr, unsigned int * group, unsigned int size, gencode_result * result);
+void predicate_index_gencode(gencode * gen, clause ** clause_arr, pc_ptr * addr_arr, unsigned int clause_size, gencode_result * result);
 void predicate_N_gencode(gencode * gen, clause_list * list, gencode_result * result);
 void predicate_gencode(gencode * gen, clause_list * list, gencode_result * result);
 void predicate_gather_gencode(gencode * gen, clause_node * first, gencode_result * result);
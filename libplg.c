@@ -0,0 +1,550 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "libplg.h"
+#include "scanner.h"
+#include "semcheck.h"
+#include "builtin.h"
+#include "gencode.h"
+#include "vm.h"
+
+struct plg_program {
+    gencode_binary * binary_value;
+    char ** names; /* query variables by index - 1 */
+    unsigned int name_size;
+    strtab * atoms; /* strings of binary with their indexes */
+    symtab * predicates; /* clauses standing for predicates of binary */
+    clause_list * stubs;
+};
+
+struct plg_query {
+    plg_program * program_value;
+    gencode_segment * segment_value; /* code of goal, NULL for query of program */
+    char ** names; /* owned only with segment */
+    unsigned int name_size;
+    vm * machine;
+    char started;
+    plg_solution solution;
+    plg_value * values; /* answer terms, args point into the same array */
+    unsigned int value_size;
+};
+
+/* names of query variables, they are numbered from 1 in the query frame */
+static void plg_query_names(query * query_value, char *** names, unsigned int * name_size)
+{
+    unsigned int i;
+    symtab * stab = query_value->stab;
+
+    *name_size = symtab_size_type(stab, SYMTAB_VAR);
+    *names = (char **)calloc(*name_size + 1, sizeof(char *));
+    for (i = 0; stab != NULL && i < stab->size; i++)
+    {
+        if (stab->entries[i].type == SYMTAB_VAR)
+        {
+            var * var_value = stab->entries[i].var_value;
+            if (var_value->index >= 1 && var_value->index <= *name_size)
+            {
+                (*names)[var_value->index - 1] = strdup(var_value->name);
+            }
+        }
+    }
+}
+
+static void plg_names_delete(char ** names, unsigned int name_size)
+{
+    unsigned int i;
+
+    for (i = 0; names != NULL && i < name_size; i++)
+    {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/**
+ * Goals are checked against clauses without bodies, one for each predicate
+ * of the binary with its name, arity and entry address. Code calling them
+ * is linked to the binary, so they are built once for programs loaded from
+ * source and from binaries.
+ */
+static plg_program * plg_program_new(gencode_binary * binary_value)
+{
+    plg_program * value = (plg_program *)malloc(sizeof(plg_program));
+    unsigned int i;
+
+    value->binary_value = binary_value;
+    value->names = NULL;
+    value->name_size = 0;
+    value->atoms = strtab_from_array(binary_value->strtab_array, binary_value->strtab_size);
+    value->predicates = symtab_new(64, NULL);
+    value->stubs = clause_list_new();
+
+    for (i = 0; i < binary_value->predicate_size; i++)
+    {
+        const gencode_predicate * predicate = &binary_value->predicate_arr[i];
+        var_list * vars = var_list_new();
+        clause * stub = NULL;
+        unsigned int j;
+
+        for (j = 0; j < predicate->arity; j++)
+        {
+            var_list_add_end(vars, var_new(strdup("X")));
+        }
+        stub = clause_new(strdup(binary_value->strtab_array[predicate->name]), vars, NULL);
+        stub->addr = predicate->addr;
+        stub->predicate_ref = stub;
+        symtab_add_predicate(value->predicates, stub);
+        clause_list_add_end(value->stubs, stub);
+    }
+
+    return value;
+}
+
+/* parses, checks and compiles program and query as plg does by default */
+static plg_program * plg_load(FILE * file)
+{
+    plg_program * value = NULL;
+    program * program_value = NULL;
+    semcheck_result sem_res = SEMCHECK_SUCCESS;
+    gencode_result gen_res = GENCODE_SUCCESS;
+    gencode * gen = NULL;
+
+    if (parse_program(file, &program_value) != 0 || program_value == NULL)
+    {
+        if (program_value != NULL)
+        {
+            program_delete(program_value);
+        }
+        return NULL;
+    }
+
+    builtin_add_once(program_value->clausies, program_value->query_value);
+    builtin_add_all(program_value->clausies);
+    program_semcheck(program_value, &sem_res);
+    if (sem_res == SEMCHECK_SUCCESS)
+    {
+        gen = gencode_new();
+        program_gencode(gen, program_value, &gen_res);
+        if (gen_res == GENCODE_SUCCESS)
+        {
+            gencode_binary * binary_value = gencode_binary_new();
+            gencode_binary_generate(binary_value, gen);
+            vm_thread_code(binary_value);
+            value = plg_program_new(binary_value);
+            plg_query_names(program_value->query_value, &value->names, &value->name_size);
+        }
+        gencode_delete(gen);
+    }
+    program_delete(program_value);
+
+    return value;
+}
+
+plg_program * plg_load_string(const char * source)
+{
+    plg_program * value = NULL;
+    FILE * file = fmemopen((void *)source, strlen(source), "r");
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    value = plg_load(file);
+    fclose(file);
+
+    return value;
+}
+
+/* source or binary written by plg -c, names of query variables are not kept in binaries */
+plg_program * plg_load_file(const char * file_name)
+{
+    plg_program * value = NULL;
+    char magic[4] = { 0 };
+    FILE * file = fopen(file_name, "r");
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+        memcmp(magic, GENCODE_BINARY_MAGIC, sizeof(magic)) == 0)
+    {
+        gencode_binary * binary_value = gencode_binary_load(file_name);
+        if (binary_value != NULL)
+        {
+            vm_thread_code(binary_value);
+            value = plg_program_new(binary_value);
+        }
+    }
+    else
+    {
+        rewind(file);
+        value = plg_load(file);
+    }
+    fclose(file);
+
+    return value;
+}
+
+void plg_program_delete(plg_program * value)
+{
+    plg_names_delete(value->names, value->name_size);
+    symtab_delete(value->predicates);
+    clause_list_delete(value->stubs);
+    strtab_delete(value->atoms);
+    gencode_binary_delete(value->binary_value);
+    free(value);
+}
+
+/**
+ * Compiles goal into a segment of code placed after the binary. once/1 is
+ * rewritten into clauses of the goal unless the program defines it, their
+ * names may repeat names of program clauses as goal clauses are looked up
+ * first.
+ */
+static gencode_segment * plg_goal_segment(plg_program * program_value, const char * goal,
+                                          char *** names, unsigned int * name_size)
+{
+    gencode_segment * segment_value = NULL;
+    program * goal_program = NULL;
+    semcheck_result sem_res = SEMCHECK_SUCCESS;
+    gencode_result gen_res = GENCODE_SUCCESS;
+    gencode * gen = NULL;
+    size_t length = strlen(goal);
+    char * source = (char *)malloc(length + 5);
+    FILE * file = NULL;
+
+    memcpy(source, "<= ", 3);
+    memcpy(source + 3, goal, length);
+    memcpy(source + 3 + length, "\n", 2);
+
+    file = fmemopen(source, length + 4, "r");
+    if (file == NULL)
+    {
+        free(source);
+        return NULL;
+    }
+    if (parse_program(file, &goal_program) != 0 || goal_program == NULL ||
+        goal_program->clausies->size > 0)
+    {
+        if (goal_program != NULL)
+        {
+            program_delete(goal_program);
+        }
+        fclose(file);
+        free(source);
+        return NULL;
+    }
+    fclose(file);
+    free(source);
+
+    if (symtab_lookup_arity(program_value->predicates, "once", 1, SYMTAB_LOOKUP_LOCAL) == NULL)
+    {
+        builtin_add_once(goal_program->clausies, goal_program->query_value);
+    }
+    goal_program->stab->parent = program_value->predicates;
+    program_semcheck(goal_program, &sem_res);
+    if (sem_res == SEMCHECK_SUCCESS)
+    {
+        gen = gencode_segment_gencode(program_value->binary_value, program_value->atoms);
+        program_gencode(gen, goal_program, &gen_res);
+        if (gen_res == GENCODE_SUCCESS)
+        {
+            segment_value = gencode_segment_new();
+            gencode_segment_generate(segment_value, gen);
+            plg_query_names(goal_program->query_value, names, name_size);
+        }
+        gencode_delete(gen);
+    }
+    program_delete(goal_program);
+
+    return segment_value;
+}
+
+plg_query * plg_query_open(plg_program * program_value, const char * goal)
+{
+    plg_query * value = NULL;
+    gencode_segment * segment_value = NULL;
+    char ** names = program_value->names;
+    unsigned int name_size = program_value->name_size;
+
+    if (goal != NULL)
+    {
+        segment_value = plg_goal_segment(program_value, goal, &names, &name_size);
+        if (segment_value == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    value = (plg_query *)malloc(sizeof(plg_query));
+    value->program_value = program_value;
+    value->segment_value = segment_value;
+    value->names = names;
+    value->name_size = name_size;
+    value->machine = vm_new(4096, 4096, 4096);
+    value->machine->pause_on_answer = 1;
+    value->started = 0;
+    value->solution.size = 0;
+    value->solution.names = NULL;
+    value->solution.values = NULL;
+    value->values = NULL;
+    value->value_size = 0;
+
+    return value;
+}
+
+void plg_query_close(plg_query * value)
+{
+    if (value->segment_value != NULL)
+    {
+        plg_names_delete(value->names, value->name_size);
+        gencode_segment_delete(value->segment_value);
+    }
+    free(value->solution.names);
+    free(value->values);
+    vm_delete(value->machine);
+    free(value);
+}
+
+typedef struct plg_item {
+    heap_ptr addr;
+    plg_value * value;
+} plg_item;
+
+static void plg_push(plg_item ** items, unsigned int * top, unsigned int * size,
+                     heap_ptr addr, plg_value * value)
+{
+    if (*top == *size)
+    {
+        *size = *size == 0 ? 64 : *size * 2;
+        *items = (plg_item *)realloc(*items, sizeof(plg_item) * *size);
+    }
+    (*items)[*top].addr = addr;
+    (*items)[*top].value = value;
+    (*top)++;
+}
+
+static heap_ptr plg_deref(gc * collector, heap_ptr addr)
+{
+    gc_heap cell = GC_CELL(collector, addr);
+    while (GC_CELL_TAG(cell) == GC_TAG_REF && GC_CELL_VALUE(cell) != addr)
+    {
+        addr = (heap_ptr)GC_CELL_VALUE(cell);
+        cell = GC_CELL(collector, addr);
+    }
+    return addr;
+}
+
+/* atoms added by goal are numbered after strings of binary */
+static const char * plg_atom_name(plg_query * value, atom_idx_t idx)
+{
+    gencode_binary * binary_value = value->program_value->binary_value;
+    gencode_segment * segment_value = value->segment_value;
+
+    if (idx < binary_value->strtab_size && binary_value->strtab_array[idx] != NULL)
+    {
+        return binary_value->strtab_array[idx];
+    }
+    if (segment_value != NULL && idx >= segment_value->strtab_addr &&
+        idx - segment_value->strtab_addr < segment_value->strtab_size &&
+        segment_value->strtab_array[idx - segment_value->strtab_addr] != NULL)
+    {
+        return segment_value->strtab_array[idx - segment_value->strtab_addr];
+    }
+    return "$unknown";
+}
+
+static const char * plg_functor_name(plg_query * value, pc_ptr addr)
+{
+    const gencode_predicate * predicate = NULL;
+
+    if (addr == BUILTIN_LIST_ADDR)
+    {
+        return "[|]";
+    }
+    predicate = gencode_binary_predicate(value->program_value->binary_value, addr);
+    if (predicate != NULL)
+    {
+        return plg_atom_name(value, predicate->name);
+    }
+    return "$unknown";
+}
+
+/*
+ * Copies answer terms into one array. Terms are walked twice with an
+ * explicit stack, first to count cells and then to fill values, so deep
+ * lists do not use C stack.
+ */
+static void plg_query_values(plg_query * value, gc_stack * args, unsigned int size)
+{
+    gc * collector = value->machine->collector;
+    plg_item * items = NULL;
+    unsigned int item_top = 0;
+    unsigned int item_size = 0;
+    unsigned int count = size;
+    unsigned int next = size;
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+    {
+        plg_push(&items, &item_top, &item_size, args[i].addr, NULL);
+    }
+    while (item_top > 0)
+    {
+        heap_ptr addr = plg_deref(collector, items[--item_top].addr);
+        gc_heap cell = GC_CELL(collector, addr);
+        if (GC_CELL_TAG(cell) == GC_TAG_STRUCT)
+        {
+            heap_size_t j;
+            count += GC_CELL_STRUCT_SIZE(cell);
+            for (j = 1; j <= GC_CELL_STRUCT_SIZE(cell); j++)
+            {
+                plg_push(&items, &item_top, &item_size, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + j)), NULL);
+            }
+        }
+    }
+
+    if (count > value->value_size)
+    {
+        value->value_size = count;
+        value->values = (plg_value *)realloc(value->values, sizeof(plg_value) * count);
+    }
+
+    for (i = size; i > 0; i--)
+    {
+        plg_push(&items, &item_top, &item_size, args[i - 1].addr, &value->values[i - 1]);
+    }
+    while (item_top > 0)
+    {
+        plg_item item = items[--item_top];
+        heap_ptr addr = plg_deref(collector, item.addr);
+        gc_heap cell = GC_CELL(collector, addr);
+        plg_value * node = item.value;
+
+        node->name = NULL;
+        node->int_value = 0;
+        node->var_id = 0;
+        node->arity = 0;
+        node->args = NULL;
+        switch (GC_CELL_TAG(cell))
+        {
+            case GC_TAG_ATOM:
+                node->type = PLG_VALUE_ATOM;
+                node->name = plg_atom_name(value, (atom_idx_t)GC_CELL_VALUE(cell));
+            break;
+            case GC_TAG_INT:
+                node->type = PLG_VALUE_INT;
+                node->int_value = GC_CELL_INT(cell);
+            break;
+            case GC_TAG_STRUCT:
+            {
+                heap_size_t j;
+                node->type = PLG_VALUE_STRUCT;
+                node->name = plg_functor_name(value, GC_CELL_STRUCT_ADDR(cell));
+                node->arity = GC_CELL_STRUCT_SIZE(cell);
+                node->args = &value->values[next];
+                next += node->arity;
+                for (j = node->arity; j > 0; j--)
+                {
+                    plg_push(&items, &item_top, &item_size,
+                             (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + j)), &node->args[j - 1]);
+                }
+            }
+            break;
+            case GC_TAG_EMPTY:
+            case GC_TAG_REF:
+                node->type = PLG_VALUE_VAR;
+                node->var_id = addr;
+            break;
+        }
+    }
+    free(items);
+
+    value->solution.size = size;
+    value->solution.values = value->values;
+}
+
+static void plg_query_solution_names(plg_query * value, unsigned int size)
+{
+    unsigned int i;
+
+    if (value->solution.names != NULL)
+    {
+        return;
+    }
+    value->solution.names = (const char **)calloc(size + 1, sizeof(const char *));
+    for (i = 0; i < size; i++)
+    {
+        if (i < value->name_size && value->names[i] != NULL)
+        {
+            value->solution.names[i] = value->names[i];
+        }
+        else
+        {
+            value->solution.names[i] = "_";
+        }
+    }
+}
+
+plg_result plg_next_solution(plg_query * value, const plg_solution ** solution)
+{
+    vm * machine = value->machine;
+    char found = 0;
+
+    if (!value->started)
+    {
+        value->started = 1;
+        vm_execute_start_segment(machine, value->program_value->binary_value, value->segment_value);
+        vm_execute_run(machine);
+        found = machine->state == VM_ANSWER;
+    }
+    else if (machine->state == VM_ANSWER)
+    {
+        found = vm_execute_next(machine);
+    }
+
+    if (found)
+    {
+        unsigned int size = 0;
+        gc_stack * args = vm_answer(machine, &size);
+
+        plg_query_solution_names(value, size);
+        plg_query_values(value, args, size);
+        if (solution != NULL)
+        {
+            *solution = &value->solution;
+        }
+        return PLG_SOLUTION;
+    }
+    if (solution != NULL)
+    {
+        *solution = NULL;
+    }
+    if (machine->state == VM_STOP)
+    {
+        return PLG_NO;
+    }
+    return PLG_ERROR;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef __LIBPLG_H__
+#define __LIBPLG_H__
+
+/**
+ * Embedding interface. A program with its query is parsed and compiled
+ * once into plg_program. Each plg_query runs a goal on its own machine
+ * and plg_next_solution resumes it from the choice points left by the
+ * previous answer. Answers are returned as plg_value trees and not printed,
+ * only write/1 and nl/0 write to stdout. Program is not changed by queries,
+ * so queries of one program may run in different threads.
+ */
+typedef struct plg_program plg_program;
+typedef struct plg_query plg_query;
+
+typedef enum plg_value_type {
+    PLG_VALUE_VAR = 0, /* unbound, var_id tells variables apart */
+    PLG_VALUE_ATOM = 1,
+    PLG_VALUE_INT = 2,
+    PLG_VALUE_STRUCT = 3 /* list cells are '[|]'(Head, Tail) */
+} plg_value_type;
+
+typedef struct plg_value {
+    plg_value_type type;
+    const char * name; /* atom or functor */
+    int int_value;
+    unsigned int var_id;
+    unsigned int arity;
+    struct plg_value * args;
+} plg_value;
+
+/**
+ * Names and values are owned by the query. Values are reallocated by the
+ * next plg_next_solution call and freed by plg_query_close, so they must
+ * be copied by callers keeping them across calls.
+ */
+typedef struct plg_solution {
+    unsigned int size;
+    const char ** names; /* query variables in order of values */
+    plg_value * values;
+} plg_solution;
+
+typedef enum plg_result {
+    PLG_ERROR = -1,
+    PLG_NO = 0,
+    PLG_SOLUTION = 1
+} plg_result;
+
+plg_program * plg_load_string(const char * source);
+plg_program * plg_load_file(const char * file_name);
+void plg_program_delete(plg_program * program);
+
+/**
+ * Opens a query of goal, e.g. "append(X, Y, [1, 2])", written as after <=
+ * in programs. Goal is compiled into code of the query calling predicates
+ * of program, which is not changed. With NULL goal the query of program
+ * is run. Returns NULL when goal cannot be parsed or calls predicates not
+ * defined by program.
+ */
+plg_query * plg_query_open(plg_program * program, const char * goal);
+plg_result plg_next_solution(plg_query * query, const plg_solution ** solution);
+void plg_query_close(plg_query * query);
+
+#endif /* __LIBPLG_H__ */
@@ -0,0 +1,92 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "ngram.h"
+#include <stdlib.h>
+
+ngram * ngram_new()
+{
+    ngram * value = (ngram *)malloc(sizeof(ngram));
+
+    value->bigrams = (unsigned long *)calloc(BYTECODE_END * BYTECODE_END, sizeof(unsigned long));
+    value->trigrams = (unsigned long *)calloc(BYTECODE_END * BYTECODE_END * BYTECODE_END, sizeof(unsigned long));
+    value->prev[0] = BYTECODE_UNKNOWN;
+    value->prev[1] = BYTECODE_UNKNOWN;
+    value->next_pc = 0;
+
+    return value;
+}
+
+void ngram_delete(ngram * value)
+{
+    free(value->bigrams);
+    free(value->trigrams);
+    free(value);
+}
+
+/* instruction at pc is executed, jumps start new sequence */
+void ngram_add(ngram * value, pc_ptr pc, bytecode_type type)
+{
+    if (pc != value->next_pc)
+    {
+        value->prev[0] = BYTECODE_UNKNOWN;
+        value->prev[1] = BYTECODE_UNKNOWN;
+    }
+    if (value->prev[1] != BYTECODE_UNKNOWN)
+    {
+        value->bigrams[value->prev[1] * BYTECODE_END + type]++;
+        if (value->prev[0] != BYTECODE_UNKNOWN)
+        {
+            value->trigrams[(value->prev[0] * BYTECODE_END + value->prev[1]) * BYTECODE_END + type]++;
+        }
+    }
+    value->prev[0] = value->prev[1];
+    value->prev[1] = type;
+    value->next_pc = pc + 1;
+}
+
+/* one line per sequence: count and instruction names */
+void ngram_print(ngram * value, FILE * file)
+{
+    unsigned int a, b, c;
+
+    for (a = 0; a < BYTECODE_END; a++)
+    {
+        for (b = 0; b < BYTECODE_END; b++)
+        {
+            unsigned long count = value->bigrams[a * BYTECODE_END + b];
+            if (count > 0)
+            {
+                fprintf(file, "%lu %s %s\n", count,
+                        bytecode_type_str(a), bytecode_type_str(b));
+            }
+            for (c = 0; c < BYTECODE_END; c++)
+            {
+                count = value->trigrams[(a * BYTECODE_END + b) * BYTECODE_END + c];
+                if (count > 0)
+                {
+                    fprintf(file, "%lu %s %s %s\n", count,
+                            bytecode_type_str(a), bytecode_type_str(b), bytecode_type_str(c));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef __NGRAM_H__
+#define __NGRAM_H__
+
+#include <stdio.h>
+#include "vm_types.h"
+#include "bytecode.h"
+
+/**
+ * Counts of executed bytecode pairs and triples. Only instructions
+ * following each other in code_array are counted, so every sequence
+ * is a candidate for a superinstruction, see peephole_fuse.
+ */
+typedef struct ngram {
+    unsigned long * bigrams; /* BYTECODE_END * BYTECODE_END */
+    unsigned long * trigrams; /* BYTECODE_END * BYTECODE_END * BYTECODE_END */
+    bytecode_type prev[2]; /* BYTECODE_UNKNOWN when not in sequence */
+    pc_ptr next_pc;
+} ngram;
+
+ngram * ngram_new();
+void ngram_delete(ngram * value);
+
+void ngram_add(ngram * value, pc_ptr pc, bytecode_type type);
+void ngram_print(ngram * value, FILE * file);
+
+#endif /* __NGRAM_H__ */
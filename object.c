@@ -20,145 +20,6 @@
  * THE SOFTWARE.
  */
 #include "object.h"
-#include <stdlib.h>
-#include <stdio.h>
-#include <assert.h>
-
-object * object_new_atom(atom_idx_t idx)
-{
-    object * value = (object *)malloc(sizeof(object));
-
-    value->type = OBJECT_ATOM;
-    value->atom_value.idx = idx;
-
-    return value;
-}
-
-object * object_new_int(int int_val)
-{
-    object * value = (object *)malloc(sizeof(object));
-
-    value->type = OBJECT_INT;
-    value->int_value.value = int_val;
-
-    return value;
-}
-
-object * object_new_anon()
-{
-    object * value = (object *)malloc(sizeof(object));
-
-    value->type = OBJECT_REF;
-    value->ref_value.ref = 0;
-
-    return value;
-}
-
-object * object_new_var()
-{
-    object * value = (object *)malloc(sizeof(object));
-
-    value->type = OBJECT_REF;
-    value->ref_value.ref = 0;
-
-    return value;
-}
-
-object * object_new_ref(heap_ptr ptr_value)
-{
-    object * value = (object *)malloc(sizeof(object));
-
-    value->type = OBJECT_REF;
-    value->ref_value.ref = ptr_value;
-
-    return value;
-}
-
-object * object_new_struct(heap_size_t size, pc_ptr addr)
-{
-    heap_ptr * refs = NULL;
-    object * value = (object *)malloc(sizeof(object));
-
-    if (size > 0)
-    {
-        refs = (heap_ptr *)malloc(sizeof(heap_ptr) * size);
-    }
-
-    value->type = OBJECT_STRUCT;
-    value->struct_value.size = size;
-    value->struct_value.addr = addr;
-    value->struct_value.refs = refs;
-
-    return value;
-}
-
-void object_delete(object * value)
-{
-    switch (value->type)
-    {
-        case OBJECT_UNKNOWN:
-            assert(0);
-        break;
-        case OBJECT_ATOM:
-        case OBJECT_REF:
-        case OBJECT_INT:
-        break;
-        case OBJECT_STRUCT:
-        {
-            if (value->struct_value.refs != NULL)
-            {
-                free(value->struct_value.refs);
-            }
-        }
-        break;
-    }
-    free(value);
-}
-
-void object_print(object * value)
-{
-    object_print_str(value, NULL, 0);
-}
-
-void object_print_str(object * value, char ** strtab_array, unsigned int strtab_size)
-{
-    if (value == NULL)
-    {
-        return;
-    }
-    switch (value->type)
-    {
-        case OBJECT_UNKNOWN:
-            assert(0);
-        break;
-        case OBJECT_ATOM:
-            if (strtab_array != NULL && (value->atom_value.idx < strtab_size))
-            {
-                printf("%s %u:%s\n", object_type_str(value->type), value->atom_value.idx, strtab_array[value->atom_value.idx]);
-            }
-            else
-            {
-                printf("%s %u\n", object_type_str(value->type), value->atom_value.idx);
-            }
-        break;
-        case OBJECT_INT:
-            printf("%s %d\n", object_type_str(value->type), value->int_value.value);
-        break;
-        case OBJECT_REF:
-            printf("%s %u\n", object_type_str(value->type), value->ref_value.ref);
-        break;
-        case OBJECT_STRUCT:
-        {
-            unsigned int i;
-            printf("%s %u ", object_type_str(value->type), value->struct_value.size);
-            for (i = 0; i < value->struct_value.size; i++) {
-                printf("%u ", value->struct_value.refs[i]);
-            }
-            printf("\n");
-        }
-        break;
-    }
-}
 
 const char * object_type_str(object_type type)
 {
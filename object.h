@@ -33,46 +33,6 @@ typedef enum object_type
     OBJECT_STRUCT = 5,
 } object_type;
 
-typedef struct obj_atom {
-    atom_idx_t idx;
-} obj_atom;
-
-typedef struct obj_int {
-    int value;
-} obj_int;
-
-typedef struct obj_ref {
-    heap_ptr ref;
-} obj_ref;
-
-typedef struct obj_struct {
-    heap_size_t size;
-    pc_ptr addr;
-    heap_ptr * refs;
-} obj_struct;
-
-typedef struct object
-{
-    object_type type;
-    union {
-        obj_atom atom_value;
-        obj_int int_value;
-        obj_ref ref_value;
-        obj_struct struct_value;
-    };
-} object;
-
-object * object_new_atom(atom_idx_t idx);
-object * object_new_int(int int_value);
-object * object_new_anon();
-object * object_new_var();
-object * object_new_ref(heap_ptr ptr_value);
-object * object_new_struct(heap_size_t size, pc_ptr addr);
-
-void object_delete(object * value);
-
-void object_print(object * value);
-void object_print_str(object * value, char ** strtab_array, unsigned int strtab_size);
 const char * object_type_str(object_type type);
 
 #endif /* __OBJECT_H__ */
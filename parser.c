@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -34,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -41,14 +45,11 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
-
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.5.1"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
@@ -76,27 +77,25 @@
 #include "program.h"
 #include "term.h"
 
-int parse_result;
-
-int yyerror(program ** plg, char * str, ...)
+int yyerror(yyscan_t scanner, int * parse_result, program ** plg, char * str, ...)
 {
   va_list args;
-  parse_result = 1;
+  *parse_result = 1;
 
   va_start(args, str);
-  fprintf(stderr, "%d: ", line_no); vfprintf(stderr, str, args); fprintf(stderr, "\n");
+  fprintf(stderr, "%u: ", yyget_extra(scanner)); vfprintf(stderr, str, args); fprintf(stderr, "\n");
   va_end(args);
 
 	return 1;
 }
 
-int yylex(token * tokp)
+int yylex(token * tokp, yyscan_t scanner)
 {
-  return lex_scan(tokp);
+  return lex_scan(tokp, scanner);
 }
 
 
-#line 100 "parser.c"
+#line 99 "parser.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -119,58 +118,53 @@ int yylex(token * tokp)
 #  endif
 # endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 0
-#endif
-
-/* Use api.header.include to #include this header
-   instead of duplicating it here.  */
-#ifndef YY_YY_PARSER_H_INCLUDED
-# define YY_YY_PARSER_H_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int yydebug;
-#endif
-/* "%code requires" blocks.  */
-#line 53 "parser.y"
-
-#include "program.h"
-
-#line 147 "parser.c"
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    TOK_ARR = 258,
-    TOK_ATOM = 259,
-    TOK_ANON = 260,
-    TOK_VAR = 261,
-    TOK_IMPL = 262,
-    TOK_QUERY = 263,
-    TOK_CUT = 264,
-    TOK_FAIL = 265,
-    TOK_IS = 266,
-    TOK_INT = 267,
-    TOK_NOT = 268
-  };
-#endif
-
-/* Value type.  */
-
-
-
-int yyparse (program ** plg);
+#include "parser.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_TOK_ARR = 3,                    /* TOK_ARR  */
+  YYSYMBOL_TOK_ATOM = 4,                   /* TOK_ATOM  */
+  YYSYMBOL_TOK_ANON = 5,                   /* TOK_ANON  */
+  YYSYMBOL_TOK_VAR = 6,                    /* TOK_VAR  */
+  YYSYMBOL_TOK_IMPL = 7,                   /* TOK_IMPL  */
+  YYSYMBOL_TOK_QUERY = 8,                  /* TOK_QUERY  */
+  YYSYMBOL_TOK_CUT = 9,                    /* TOK_CUT  */
+  YYSYMBOL_TOK_FAIL = 10,                  /* TOK_FAIL  */
+  YYSYMBOL_TOK_IS = 11,                    /* TOK_IS  */
+  YYSYMBOL_TOK_INT = 12,                   /* TOK_INT  */
+  YYSYMBOL_13_ = 13,                       /* '+'  */
+  YYSYMBOL_14_ = 14,                       /* '-'  */
+  YYSYMBOL_15_ = 15,                       /* '*'  */
+  YYSYMBOL_16_ = 16,                       /* '/'  */
+  YYSYMBOL_TOK_NOT = 17,                   /* TOK_NOT  */
+  YYSYMBOL_18_ = 18,                       /* '('  */
+  YYSYMBOL_19_ = 19,                       /* ')'  */
+  YYSYMBOL_20_ = 20,                       /* ','  */
+  YYSYMBOL_21_ = 21,                       /* '['  */
+  YYSYMBOL_22_ = 22,                       /* ']'  */
+  YYSYMBOL_23_ = 23,                       /* '|'  */
+  YYSYMBOL_24_ = 24,                       /* '='  */
+  YYSYMBOL_25_ = 25,                       /* '<'  */
+  YYSYMBOL_26_ = 26,                       /* '>'  */
+  YYSYMBOL_YYACCEPT = 27,                  /* $accept  */
+  YYSYMBOL_var = 28,                       /* var  */
+  YYSYMBOL_vars = 29,                      /* vars  */
+  YYSYMBOL_expr = 30,                      /* expr  */
+  YYSYMBOL_term = 31,                      /* term  */
+  YYSYMBOL_terms = 32,                     /* terms  */
+  YYSYMBOL_goal = 33,                      /* goal  */
+  YYSYMBOL_goals = 34,                     /* goals  */
+  YYSYMBOL_clause = 35,                    /* clause  */
+  YYSYMBOL_clauses = 36,                   /* clauses  */
+  YYSYMBOL_query = 37,                     /* query  */
+  YYSYMBOL_program = 38                    /* program  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
-#endif /* !YY_YY_PARSER_H_INCLUDED  */
 
 
 
@@ -211,6 +205,18 @@ typedef int_least16_t yytype_int16;
 typedef short yytype_int16;
 #endif
 
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
 #if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
 typedef __UINT_LEAST8_TYPE__ yytype_uint8;
 #elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
@@ -270,6 +276,7 @@ typedef int yytype_uint16;
 
 #define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
 
+
 /* Stored state numbers (used for stacks). */
 typedef yytype_int8 yy_state_t;
 
@@ -288,6 +295,7 @@ typedef int yy_state_fast_t;
 # endif
 #endif
 
+
 #ifndef YY_ATTRIBUTE_PURE
 # if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
 #  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
@@ -306,17 +314,23 @@ typedef int yy_state_fast_t;
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && ! defined __ICC && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                            \
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
     _Pragma ("GCC diagnostic push")                                     \
     _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
 # define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
@@ -345,7 +359,7 @@ typedef int yy_state_fast_t;
 
 #define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#if !defined yyoverflow
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -410,8 +424,7 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* !defined yyoverflow */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
@@ -487,14 +500,16 @@ union yyalloc
 /* YYNSTATES -- Number of states.  */
 #define YYNSTATES  79
 
-#define YYUNDEFTOK  2
+/* YYMAXUTOK -- Last valid token kind.  */
 #define YYMAXUTOK   268
 
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex, with out-of-bounds checking.  */
-#define YYTRANSLATE(YYX)                                                \
-  (0 <= (YYX) && (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex.  */
@@ -530,41 +545,43 @@ static const yytype_int8 yytranslate[] =
 };
 
 #if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int16 yyrline[] =
 {
-       0,   108,   108,   113,   123,   128,   135,   140,   145,   150,
-     155,   160,   165,   170,   177,   182,   187,   192,   197,   202,
-     207,   212,   218,   225,   230,   237,   243,   248,   253,   258,
-     263,   268,   273,   278,   285,   290,   297,   302,   307,   314,
-     319,   326,   333,   339
+       0,   118,   118,   123,   133,   138,   145,   150,   155,   160,
+     165,   170,   175,   180,   187,   192,   197,   202,   207,   212,
+     217,   222,   228,   235,   240,   247,   253,   258,   263,   268,
+     273,   278,   283,   288,   295,   300,   307,   312,   317,   324,
+     329,   336,   343,   349
 };
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 0
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "TOK_ARR", "TOK_ATOM", "TOK_ANON",
-  "TOK_VAR", "TOK_IMPL", "TOK_QUERY", "TOK_CUT", "TOK_FAIL", "TOK_IS",
-  "TOK_INT", "'+'", "'-'", "'*'", "'/'", "TOK_NOT", "'('", "')'", "','",
-  "'['", "']'", "'|'", "'='", "'<'", "'>'", "$accept", "var", "vars",
-  "expr", "term", "terms", "goal", "goals", "clause", "clauses", "query",
-  "program", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "TOK_ARR", "TOK_ATOM",
+  "TOK_ANON", "TOK_VAR", "TOK_IMPL", "TOK_QUERY", "TOK_CUT", "TOK_FAIL",
+  "TOK_IS", "TOK_INT", "'+'", "'-'", "'*'", "'/'", "TOK_NOT", "'('", "')'",
+  "','", "'['", "']'", "'|'", "'='", "'<'", "'>'", "$accept", "var",
+  "vars", "expr", "term", "terms", "goal", "goals", "clause", "clauses",
+  "query", "program", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_int16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,    43,    45,    42,    47,   268,    40,    41,
-      44,    91,    93,   124,    61,    60,    62
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
 #define YYPACT_NINF (-43)
 
@@ -576,8 +593,8 @@ static const yytype_int16 yytoknum[] =
 #define yytable_value_is_error(Yyn) \
   0
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
 static const yytype_int8 yypact[] =
 {
       30,    88,    18,   -43,    30,   -43,     6,   -43,    -6,   -43,
@@ -590,9 +607,9 @@ static const yytype_int8 yypact[] =
      -43,    61,   -43,    78,   -43,    -3,   -43,     0,   -43
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
 static const yytype_int8 yydefact[] =
 {
        0,     0,     0,    39,     0,    43,     0,     3,    25,     2,
@@ -605,23 +622,23 @@ static const yytype_int8 yydefact[] =
       18,     0,    21,     0,    24,    38,    19,     0,    22
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
      -43,    -1,   -43,    43,   -27,   -42,    57,   -18,    58,   -43,
       91,   -43
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
+/* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-      -1,    25,    40,    16,    47,    48,    17,    18,     3,     4,
+       0,    25,    40,    16,    47,    48,    17,    18,     3,     4,
        5,     6
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int8 yytable[] =
 {
       15,    37,    51,    64,     7,     7,    23,    41,    42,     9,
@@ -656,8 +673,8 @@ static const yytype_int8 yycheck[] =
       15,    16,    -1,    -1,    -1,    -1,    25,    26
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
 static const yytype_int8 yystos[] =
 {
        0,     3,     4,    35,    36,    37,    38,     1,     4,     6,
@@ -670,7 +687,7 @@ static const yytype_int8 yystos[] =
       19,    32,    22,    23,    31,    34,    19,    31,    22
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr1[] =
 {
        0,    27,    28,    28,    29,    29,    30,    30,    30,    30,
@@ -680,7 +697,7 @@ static const yytype_int8 yyr1[] =
       36,    37,    38,    38
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
        0,     2,     1,     1,     1,     3,     1,     1,     2,     3,
@@ -691,14 +708,15 @@ static const yytype_int8 yyr2[] =
 };
 
 
+enum { YYENOMEM = -2 };
+
 #define yyerrok         (yyerrstatus = 0)
 #define yyclearin       (yychar = YYEMPTY)
-#define YYEMPTY         (-2)
-#define YYEOF           0
 
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
@@ -715,15 +733,14 @@ static const yytype_int8 yyr2[] =
       }                                                           \
     else                                                          \
       {                                                           \
-        yyerror (plg, YY_("syntax error: cannot back up")); \
+        yyerror (scanner, parse_result, plg, YY_("syntax error: cannot back up")); \
         YYERROR;                                                  \
       }                                                           \
   while (0)
 
-/* Error token number */
-#define YYTERROR        1
-#define YYERRCODE       256
-
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
 
 /* Enable debugging if requested.  */
@@ -740,19 +757,16 @@ do {                                            \
     YYFPRINTF Args;                             \
 } while (0)
 
-/* This macro is provided for backward compatibility. */
-#ifndef YY_LOCATION_PRINT
-# define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-#endif
 
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)                    \
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
 do {                                                                      \
   if (yydebug)                                                            \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Type, Value, plg); \
+                  Kind, Value, scanner, parse_result, plg); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
@@ -763,19 +777,18 @@ do {                                                                      \
 `-----------------------------------*/
 
 static void
-yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, program ** plg)
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, yyscan_t scanner, int * parse_result, program ** plg)
 {
   FILE *yyoutput = yyo;
-  YYUSE (yyoutput);
-  YYUSE (plg);
+  YY_USE (yyoutput);
+  YY_USE (scanner);
+  YY_USE (parse_result);
+  YY_USE (plg);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyo, yytoknum[yytype], *yyvaluep);
-# endif
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
@@ -785,12 +798,13 @@ yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, pr
 `---------------------------*/
 
 static void
-yy_symbol_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep, program ** plg)
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, yyscan_t scanner, int * parse_result, program ** plg)
 {
   YYFPRINTF (yyo, "%s %s (",
-             yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyo, yytype, yyvaluep, plg);
+  yy_symbol_value_print (yyo, yykind, yyvaluep, scanner, parse_result, plg);
   YYFPRINTF (yyo, ")");
 }
 
@@ -823,7 +837,8 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule, program ** plg)
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, yyscan_t scanner, int * parse_result, program ** plg)
 {
   int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
@@ -835,9 +850,8 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule, program ** plg)
     {
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
-                       yystos[+yyssp[yyi + 1 - yynrhs]],
-                       &yyvsp[(yyi + 1) - (yynrhs)]
-                                              , plg);
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], scanner, parse_result, plg);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -845,15 +859,15 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule, program ** plg)
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule, plg); \
+    yy_reduce_print (yyssp, yyvsp, Rule, scanner, parse_result, plg); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
@@ -876,342 +890,117 @@ int yydebug;
 #endif
 
 
-#if YYERROR_VERBOSE
 
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
-#  else
-/* Return the length of YYSTR.  */
-static YYPTRDIFF_T
-yystrlen (const char *yystr)
-{
-  YYPTRDIFF_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#  endif
-# endif
-
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-static char *
-yystpcpy (char *yydest, const char *yysrc)
-{
-  char *yyd = yydest;
-  const char *yys = yysrc;
-
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
 
-  return yyd - 1;
-}
-#  endif
-# endif
-
-# ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYPTRDIFF_T
-yytnamerr (char *yyres, const char *yystr)
-{
-  if (*yystr == '"')
-    {
-      YYPTRDIFF_T yyn = 0;
-      char const *yyp = yystr;
-
-      for (;;)
-        switch (*++yyp)
-          {
-          case '\'':
-          case ',':
-            goto do_not_strip_quotes;
-
-          case '\\':
-            if (*++yyp != '\\')
-              goto do_not_strip_quotes;
-            else
-              goto append;
-
-          append:
-          default:
-            if (yyres)
-              yyres[yyn] = *yyp;
-            yyn++;
-            break;
-
-          case '"':
-            if (yyres)
-              yyres[yyn] = '\0';
-            return yyn;
-          }
-    do_not_strip_quotes: ;
-    }
 
-  if (yyres)
-    return yystpcpy (yyres, yystr) - yyres;
-  else
-    return yystrlen (yystr);
-}
-# endif
-
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
-
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
-static int
-yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
-                yy_state_t *yyssp, int yytoken)
-{
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat: reported tokens (one for the "unexpected",
-     one per "expected"). */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Actual size of YYARG. */
-  int yycount = 0;
-  /* Cumulated lengths of YYARG.  */
-  YYPTRDIFF_T yysize = 0;
-
-  /* There are many possibilities here to consider:
-     - If this state is a consistent state with a default action, then
-       the only way this function was invoked is if the default action
-       is an error action.  In that case, don't check for expected
-       tokens because there are none.
-     - The only way there can be no lookahead present (in yychar) is if
-       this state is a consistent state with a default action.  Thus,
-       detecting the absence of a lookahead is sufficient to determine
-       that there is no unexpected or expected token to report.  In that
-       case, just report a simple "syntax error".
-     - Don't assume there isn't a lookahead just because this state is a
-       consistent state with a default action.  There might have been a
-       previous inconsistent state, consistent state with a non-default
-       action, or user semantic action that manipulated yychar.
-     - Of course, the expected token list depends on states to have
-       correct lookahead information, and it depends on the parser not
-       to perform extra reductions after fetching a lookahead from the
-       scanner and before detecting a syntax error.  Thus, state merging
-       (from LALR or IELR) and default reductions corrupt the expected
-       token list.  However, the list is correct for canonical LR with
-       one exception: it will still contain any token that will not be
-       accepted due to an error action in a later state.
-  */
-  if (yytoken != YYEMPTY)
-    {
-      int yyn = yypact[+*yyssp];
-      YYPTRDIFF_T yysize0 = yytnamerr (YY_NULLPTR, yytname[yytoken]);
-      yysize = yysize0;
-      yyarg[yycount++] = yytname[yytoken];
-      if (!yypact_value_is_default (yyn))
-        {
-          /* Start YYX at -YYN if negative to avoid negative indexes in
-             YYCHECK.  In other words, skip the first -YYN actions for
-             this state because they are default actions.  */
-          int yyxbegin = yyn < 0 ? -yyn : 0;
-          /* Stay within bounds of both yycheck and yytname.  */
-          int yychecklim = YYLAST - yyn + 1;
-          int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-          int yyx;
-
-          for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-            if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR
-                && !yytable_value_is_error (yytable[yyx + yyn]))
-              {
-                if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-                  {
-                    yycount = 1;
-                    yysize = yysize0;
-                    break;
-                  }
-                yyarg[yycount++] = yytname[yyx];
-                {
-                  YYPTRDIFF_T yysize1
-                    = yysize + yytnamerr (YY_NULLPTR, yytname[yyx]);
-                  if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-                    yysize = yysize1;
-                  else
-                    return 2;
-                }
-              }
-        }
-    }
-
-  switch (yycount)
-    {
-# define YYCASE_(N, S)                      \
-      case N:                               \
-        yyformat = S;                       \
-      break
-    default: /* Avoid compiler warnings. */
-      YYCASE_(0, YY_("syntax error"));
-      YYCASE_(1, YY_("syntax error, unexpected %s"));
-      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
-      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
-      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
-      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-# undef YYCASE_
-    }
-
-  {
-    /* Don't count the "%s"s in the final size, but reserve room for
-       the terminator.  */
-    YYPTRDIFF_T yysize1 = yysize + (yystrlen (yyformat) - 2 * yycount) + 1;
-    if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-      yysize = yysize1;
-    else
-      return 2;
-  }
-
-  if (*yymsg_alloc < yysize)
-    {
-      *yymsg_alloc = 2 * yysize;
-      if (! (yysize <= *yymsg_alloc
-             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
-        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-      return 1;
-    }
-
-  /* Avoid sprintf, as that infringes on the user's name space.
-     Don't have undefined behavior even if the translation
-     produced a string with the wrong number of "%s"s.  */
-  {
-    char *yyp = *yymsg;
-    int yyi = 0;
-    while ((*yyp = *yyformat) != '\0')
-      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
-        {
-          yyp += yytnamerr (yyp, yyarg[yyi++]);
-          yyformat += 2;
-        }
-      else
-        {
-          ++yyp;
-          ++yyformat;
-        }
-  }
-  return 0;
-}
-#endif /* YYERROR_VERBOSE */
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
 static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep, program ** plg)
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, yyscan_t scanner, int * parse_result, program ** plg)
 {
-  YYUSE (yyvaluep);
-  YYUSE (plg);
+  YY_USE (yyvaluep);
+  YY_USE (scanner);
+  YY_USE (parse_result);
+  YY_USE (plg);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  switch (yytype)
+  switch (yykind)
     {
-    case 4: /* TOK_ATOM  */
-#line 89 "parser.y"
+    case YYSYMBOL_TOK_ATOM: /* TOK_ATOM  */
+#line 99 "parser.y"
             { if (((*yyvaluep).val.string_val)) free(((*yyvaluep).val.string_val)); }
-#line 1131 "parser.c"
+#line 920 "parser.c"
         break;
 
-    case 5: /* TOK_ANON  */
-#line 88 "parser.y"
+    case YYSYMBOL_TOK_ANON: /* TOK_ANON  */
+#line 98 "parser.y"
             { if (((*yyvaluep).val.string_val)) free(((*yyvaluep).val.string_val)); }
-#line 1137 "parser.c"
+#line 926 "parser.c"
         break;
 
-    case 6: /* TOK_VAR  */
-#line 90 "parser.y"
+    case YYSYMBOL_TOK_VAR: /* TOK_VAR  */
+#line 100 "parser.y"
             { if (((*yyvaluep).val.string_val)) free(((*yyvaluep).val.string_val)); }
-#line 1143 "parser.c"
+#line 932 "parser.c"
         break;
 
-    case 10: /* TOK_FAIL  */
-#line 91 "parser.y"
+    case YYSYMBOL_TOK_FAIL: /* TOK_FAIL  */
+#line 101 "parser.y"
             { if (((*yyvaluep).val.string_val)) free(((*yyvaluep).val.string_val)); }
-#line 1149 "parser.c"
+#line 938 "parser.c"
         break;
 
-    case 28: /* var  */
-#line 92 "parser.y"
+    case YYSYMBOL_var: /* var  */
+#line 102 "parser.y"
             { if (((*yyvaluep).val.var_val)) var_delete(((*yyvaluep).val.var_val)); }
-#line 1155 "parser.c"
+#line 944 "parser.c"
         break;
 
-    case 29: /* vars  */
-#line 93 "parser.y"
+    case YYSYMBOL_vars: /* vars  */
+#line 103 "parser.y"
             { if (((*yyvaluep).val.vars_val)) var_list_delete(((*yyvaluep).val.vars_val)); }
-#line 1161 "parser.c"
+#line 950 "parser.c"
         break;
 
-    case 30: /* expr  */
-#line 94 "parser.y"
+    case YYSYMBOL_expr: /* expr  */
+#line 104 "parser.y"
             { if (((*yyvaluep).val.expr_val)) expr_delete(((*yyvaluep).val.expr_val)); }
-#line 1167 "parser.c"
+#line 956 "parser.c"
         break;
 
-    case 31: /* term  */
-#line 95 "parser.y"
+    case YYSYMBOL_term: /* term  */
+#line 105 "parser.y"
             { if (((*yyvaluep).val.term_val)) term_delete(((*yyvaluep).val.term_val)); }
-#line 1173 "parser.c"
+#line 962 "parser.c"
         break;
 
-    case 32: /* terms  */
-#line 96 "parser.y"
+    case YYSYMBOL_terms: /* terms  */
+#line 106 "parser.y"
             { if (((*yyvaluep).val.terms_val)) term_list_delete(((*yyvaluep).val.terms_val)); }
-#line 1179 "parser.c"
+#line 968 "parser.c"
         break;
 
-    case 33: /* goal  */
-#line 97 "parser.y"
+    case YYSYMBOL_goal: /* goal  */
+#line 107 "parser.y"
             { if (((*yyvaluep).val.goal_val)) goal_delete(((*yyvaluep).val.goal_val)); }
-#line 1185 "parser.c"
+#line 974 "parser.c"
         break;
 
-    case 34: /* goals  */
-#line 98 "parser.y"
+    case YYSYMBOL_goals: /* goals  */
+#line 108 "parser.y"
             { if (((*yyvaluep).val.goals_val)) goal_list_delete(((*yyvaluep).val.goals_val)); }
-#line 1191 "parser.c"
+#line 980 "parser.c"
         break;
 
-    case 35: /* clause  */
-#line 99 "parser.y"
+    case YYSYMBOL_clause: /* clause  */
+#line 109 "parser.y"
             { if (((*yyvaluep).val.clause_val)) clause_delete(((*yyvaluep).val.clause_val)); }
-#line 1197 "parser.c"
+#line 986 "parser.c"
         break;
 
-    case 36: /* clauses  */
-#line 100 "parser.y"
+    case YYSYMBOL_clauses: /* clauses  */
+#line 110 "parser.y"
             { if (((*yyvaluep).val.clauses_val)) clause_list_delete(((*yyvaluep).val.clauses_val)); }
-#line 1203 "parser.c"
+#line 992 "parser.c"
         break;
 
-    case 37: /* query  */
-#line 101 "parser.y"
+    case YYSYMBOL_query: /* query  */
+#line 111 "parser.y"
             { if (((*yyvaluep).val.query_val)) query_delete(((*yyvaluep).val.query_val)); }
-#line 1209 "parser.c"
+#line 998 "parser.c"
         break;
 
-    case 38: /* program  */
-#line 102 "parser.y"
+    case YYSYMBOL_program: /* program  */
+#line 112 "parser.y"
             { }
-#line 1215 "parser.c"
+#line 1004 "parser.c"
         break;
 
       default:
@@ -1223,14 +1012,16 @@ yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep, program ** plg)
 
 
 
+
+
 /*----------.
 | yyparse.  |
 `----------*/
 
 int
-yyparse (program ** plg)
+yyparse (yyscan_t scanner, int * parse_result, program ** plg)
 {
-/* The lookahead symbol.  */
+/* Lookahead token kind.  */
 int yychar;
 
 
@@ -1241,45 +1032,38 @@ YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
 YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
 
     /* Number of syntax errors so far.  */
-    int yynerrs;
+    int yynerrs = 0;
 
-    yy_state_fast_t yystate;
+    yy_state_fast_t yystate = 0;
     /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus;
+    int yyerrstatus = 0;
 
-    /* The stacks and their tools:
-       'yyss': related to states.
-       'yyvs': related to semantic values.
-
-       Refer to the stacks through separate pointers, to allow yyoverflow
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
        to reallocate them elsewhere.  */
 
-    /* The state stack.  */
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
     yy_state_t yyssa[YYINITDEPTH];
-    yy_state_t *yyss;
-    yy_state_t *yyssp;
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-    /* The semantic value stack.  */
+    /* The semantic value stack: array, bottom, top.  */
     YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs;
-    YYSTYPE *yyvsp;
-
-    YYPTRDIFF_T yystacksize;
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+
 
 #define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
@@ -1287,16 +1071,10 @@ YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yystacksize = YYINITDEPTH;
-
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
   yychar = YYEMPTY; /* Cause a token to be read.  */
+
   goto yysetstate;
 
 
@@ -1318,10 +1096,11 @@ yysetstate:
   YY_IGNORE_USELESS_CAST_BEGIN
   *yyssp = YY_CAST (yy_state_t, yystate);
   YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
 #if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    goto yyexhaustedlab;
+    YYNOMEM;
 #else
     {
       /* Get the current used size of the three stacks, in elements.  */
@@ -1349,7 +1128,7 @@ yysetstate:
 # else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
@@ -1360,10 +1139,10 @@ yysetstate:
           YY_CAST (union yyalloc *,
                    YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
-# undef YYSTACK_RELOCATE
+#  undef YYSTACK_RELOCATE
         if (yyss1 != yyssa)
           YYSTACK_FREE (yyss1);
       }
@@ -1382,6 +1161,7 @@ yysetstate:
     }
 #endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
+
   if (yystate == YYFINAL)
     YYACCEPT;
 
@@ -1402,18 +1182,29 @@ yybackup:
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = yylex (&yylval);
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, scanner);
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1482,388 +1273,388 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-  case 2:
-#line 109 "parser.y"
+  case 2: /* var: TOK_VAR  */
+#line 119 "parser.y"
      {
          (yyval.val.var_val) = var_new((yyvsp[0].val.string_val));
          (yyval.val.var_val)->line_no = (yyvsp[0].line_no);
      }
-#line 1492 "parser.c"
+#line 1283 "parser.c"
     break;
 
-  case 3:
-#line 114 "parser.y"
+  case 3: /* var: error  */
+#line 124 "parser.y"
      {
          (yyval.val.var_val) = NULL;
-         yyerror(NULL, "incorrect variable");
-         //yyerror(NULL, "incorrect variable, found '%s' instead", token_to_str(&yylval));
+         yyerror(scanner, parse_result, plg, "incorrect variable");
+         //yyerror(scanner, parse_result, plg, "incorrect variable, found '%s' instead", token_to_str(&yylval));
          //token_delete(&yylval);
          yyclearin;
      }
-#line 1504 "parser.c"
+#line 1295 "parser.c"
     break;
 
-  case 4:
-#line 124 "parser.y"
+  case 4: /* vars: var  */
+#line 134 "parser.y"
      {
           (yyval.val.vars_val) = var_list_new();
           var_list_add_end((yyval.val.vars_val), (yyvsp[0].val.var_val));
      }
-#line 1513 "parser.c"
+#line 1304 "parser.c"
     break;
 
-  case 5:
-#line 129 "parser.y"
+  case 5: /* vars: vars ',' var  */
+#line 139 "parser.y"
      {
           var_list_add_end((yyvsp[-2].val.vars_val), (yyvsp[0].val.var_val));
           (yyval.val.vars_val) = (yyvsp[-2].val.vars_val);
      }
-#line 1522 "parser.c"
+#line 1313 "parser.c"
     break;
 
-  case 6:
-#line 136 "parser.y"
+  case 6: /* expr: var  */
+#line 146 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_var((yyvsp[0].val.var_val));
           (yyval.val.expr_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1531 "parser.c"
+#line 1322 "parser.c"
     break;
 
-  case 7:
-#line 141 "parser.y"
+  case 7: /* expr: TOK_INT  */
+#line 151 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_int((yyvsp[0].val.int_val));
           (yyval.val.expr_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1540 "parser.c"
+#line 1331 "parser.c"
     break;
 
-  case 8:
-#line 146 "parser.y"
+  case 8: /* expr: '-' expr  */
+#line 156 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_neg((yyvsp[0].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1549 "parser.c"
+#line 1340 "parser.c"
     break;
 
-  case 9:
-#line 151 "parser.y"
+  case 9: /* expr: expr '+' expr  */
+#line 161 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_add((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1558 "parser.c"
+#line 1349 "parser.c"
     break;
 
-  case 10:
-#line 156 "parser.y"
+  case 10: /* expr: expr '-' expr  */
+#line 166 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_sub((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1567 "parser.c"
+#line 1358 "parser.c"
     break;
 
-  case 11:
-#line 161 "parser.y"
+  case 11: /* expr: expr '*' expr  */
+#line 171 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_mul((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1576 "parser.c"
+#line 1367 "parser.c"
     break;
 
-  case 12:
-#line 166 "parser.y"
+  case 12: /* expr: expr '/' expr  */
+#line 176 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_div((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1585 "parser.c"
+#line 1376 "parser.c"
     break;
 
-  case 13:
-#line 171 "parser.y"
+  case 13: /* expr: '(' expr ')'  */
+#line 181 "parser.y"
       {
           (yyval.val.expr_val) = expr_new_sup((yyvsp[-1].val.expr_val));
           (yyval.val.expr_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1594 "parser.c"
+#line 1385 "parser.c"
     break;
 
-  case 14:
-#line 178 "parser.y"
+  case 14: /* term: var  */
+#line 188 "parser.y"
       {
           (yyval.val.term_val) = term_new_var(TERM_TYPE_VAR, (yyvsp[0].val.var_val));
           (yyval.val.term_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1603 "parser.c"
+#line 1394 "parser.c"
     break;
 
-  case 15:
-#line 183 "parser.y"
+  case 15: /* term: TOK_INT  */
+#line 193 "parser.y"
       {
           (yyval.val.term_val) = term_new_int(TERM_TYPE_INT, (yyvsp[0].val.int_val));
           (yyval.val.term_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1612 "parser.c"
+#line 1403 "parser.c"
     break;
 
-  case 16:
-#line 188 "parser.y"
+  case 16: /* term: TOK_ATOM  */
+#line 198 "parser.y"
       {
           (yyval.val.term_val) = term_new_basic(TERM_TYPE_ATOM, (yyvsp[0].val.string_val));
           (yyval.val.term_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1621 "parser.c"
+#line 1412 "parser.c"
     break;
 
-  case 17:
-#line 193 "parser.y"
+  case 17: /* term: TOK_ANON  */
+#line 203 "parser.y"
       {
           (yyval.val.term_val) = term_new_basic(TERM_TYPE_ANON, (yyvsp[0].val.string_val));
           (yyval.val.term_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1630 "parser.c"
+#line 1421 "parser.c"
     break;
 
-  case 18:
-#line 198 "parser.y"
+  case 18: /* term: TOK_ATOM '(' ')'  */
+#line 208 "parser.y"
       {
       	  (yyval.val.term_val) = term_new_struct(TERM_TYPE_ATOM, (yyvsp[-2].val.string_val), NULL);
           (yyval.val.term_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1639 "parser.c"
+#line 1430 "parser.c"
     break;
 
-  case 19:
-#line 203 "parser.y"
+  case 19: /* term: TOK_ATOM '(' terms ')'  */
+#line 213 "parser.y"
       {
       	  (yyval.val.term_val) = term_new_struct(TERM_TYPE_STRUCT, (yyvsp[-3].val.string_val), (yyvsp[-1].val.terms_val));
           (yyval.val.term_val)->line_no = (yyvsp[-3].line_no);
       }
-#line 1648 "parser.c"
+#line 1439 "parser.c"
     break;
 
-  case 20:
-#line 208 "parser.y"
+  case 20: /* term: '[' ']'  */
+#line 218 "parser.y"
       {
           (yyval.val.term_val) = term_new_basic(TERM_TYPE_ATOM, strdup("[]"));
           (yyval.val.term_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1657 "parser.c"
+#line 1448 "parser.c"
     break;
 
-  case 21:
-#line 213 "parser.y"
+  case 21: /* term: '[' terms ']'  */
+#line 223 "parser.y"
       {
           term * tail = term_new_basic(TERM_TYPE_ATOM, strdup("[]"));
           (yyval.val.term_val) = term_new_list_constructor((yyvsp[-1].val.terms_val), tail);
           (yyval.val.term_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1667 "parser.c"
+#line 1458 "parser.c"
     break;
 
-  case 22:
-#line 219 "parser.y"
+  case 22: /* term: '[' terms '|' term ']'  */
+#line 229 "parser.y"
       {
           (yyval.val.term_val) = term_new_list_constructor((yyvsp[-3].val.terms_val), (yyvsp[-1].val.term_val));
           (yyval.val.term_val)->line_no = (yyvsp[-4].line_no);
       }
-#line 1676 "parser.c"
+#line 1467 "parser.c"
     break;
 
-  case 23:
-#line 226 "parser.y"
+  case 23: /* terms: term  */
+#line 236 "parser.y"
       {
           (yyval.val.terms_val) = term_list_new();
           term_list_add_end((yyval.val.terms_val), (yyvsp[0].val.term_val));
       }
-#line 1685 "parser.c"
+#line 1476 "parser.c"
     break;
 
-  case 24:
-#line 231 "parser.y"
+  case 24: /* terms: terms ',' term  */
+#line 241 "parser.y"
       {
           term_list_add_end((yyvsp[-2].val.terms_val), (yyvsp[0].val.term_val));
           (yyval.val.terms_val) = (yyvsp[-2].val.terms_val);
       }
-#line 1694 "parser.c"
+#line 1485 "parser.c"
     break;
 
-  case 25:
-#line 238 "parser.y"
+  case 25: /* goal: TOK_ATOM  */
+#line 248 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_literal((yyvsp[0].val.string_val), NULL);
           (yyval.val.goal_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1703 "parser.c"
+#line 1494 "parser.c"
     break;
 
-  case 26:
-#line 244 "parser.y"
+  case 26: /* goal: TOK_ATOM '(' ')'  */
+#line 254 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_literal((yyvsp[-2].val.string_val), NULL);
           (yyval.val.goal_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1712 "parser.c"
+#line 1503 "parser.c"
     break;
 
-  case 27:
-#line 249 "parser.y"
+  case 27: /* goal: TOK_ATOM '(' terms ')'  */
+#line 259 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_literal((yyvsp[-3].val.string_val), (yyvsp[-1].val.terms_val));
           (yyval.val.goal_val)->line_no = (yyvsp[-3].line_no);
       }
-#line 1721 "parser.c"
+#line 1512 "parser.c"
     break;
 
-  case 28:
-#line 254 "parser.y"
+  case 28: /* goal: var '=' term  */
+#line 264 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_unification((yyvsp[-2].val.var_val), (yyvsp[0].val.term_val));
           (yyval.val.goal_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1730 "parser.c"
+#line 1521 "parser.c"
     break;
 
-  case 29:
-#line 259 "parser.y"
+  case 29: /* goal: expr '<' expr  */
+#line 269 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_lt((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.goal_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1739 "parser.c"
+#line 1530 "parser.c"
     break;
 
-  case 30:
-#line 264 "parser.y"
+  case 30: /* goal: expr '>' expr  */
+#line 274 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_gt((yyvsp[-2].val.expr_val), (yyvsp[0].val.expr_val));
           (yyval.val.goal_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1748 "parser.c"
+#line 1539 "parser.c"
     break;
 
-  case 31:
-#line 269 "parser.y"
+  case 31: /* goal: var TOK_IS expr  */
+#line 279 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_is((yyvsp[-2].val.var_val), (yyvsp[0].val.expr_val));
           (yyval.val.goal_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1757 "parser.c"
+#line 1548 "parser.c"
     break;
 
-  case 32:
-#line 274 "parser.y"
+  case 32: /* goal: TOK_CUT  */
+#line 284 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_cut();
           (yyval.val.goal_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1766 "parser.c"
+#line 1557 "parser.c"
     break;
 
-  case 33:
-#line 279 "parser.y"
+  case 33: /* goal: TOK_FAIL  */
+#line 289 "parser.y"
       {
           (yyval.val.goal_val) = goal_new_fail((yyvsp[0].val.string_val));
           (yyval.val.goal_val)->line_no = (yyvsp[0].line_no);
       }
-#line 1775 "parser.c"
+#line 1566 "parser.c"
     break;
 
-  case 34:
-#line 286 "parser.y"
+  case 34: /* goals: goal  */
+#line 296 "parser.y"
       {
           (yyval.val.goals_val) = goal_list_new();
           goal_list_add_end((yyval.val.goals_val), (yyvsp[0].val.goal_val));
       }
-#line 1784 "parser.c"
+#line 1575 "parser.c"
     break;
 
-  case 35:
-#line 291 "parser.y"
+  case 35: /* goals: goals ',' goal  */
+#line 301 "parser.y"
       {
           goal_list_add_end((yyvsp[-2].val.goals_val), (yyvsp[0].val.goal_val));
           (yyval.val.goals_val) = (yyvsp[-2].val.goals_val);
       }
-#line 1793 "parser.c"
+#line 1584 "parser.c"
     break;
 
-  case 36:
-#line 298 "parser.y"
+  case 36: /* clause: TOK_ATOM TOK_ARR goals  */
+#line 308 "parser.y"
       {
           (yyval.val.clause_val) = clause_new((yyvsp[-2].val.string_val), NULL, (yyvsp[0].val.goals_val));
           (yyval.val.clause_val)->line_no = (yyvsp[-2].line_no);
       }
-#line 1802 "parser.c"
+#line 1593 "parser.c"
     break;
 
-  case 37:
-#line 303 "parser.y"
+  case 37: /* clause: TOK_ATOM '(' ')' TOK_ARR goals  */
+#line 313 "parser.y"
       {
           (yyval.val.clause_val) = clause_new((yyvsp[-4].val.string_val), NULL, (yyvsp[0].val.goals_val));
           (yyval.val.clause_val)->line_no = (yyvsp[-4].line_no);
       }
-#line 1811 "parser.c"
+#line 1602 "parser.c"
     break;
 
-  case 38:
-#line 308 "parser.y"
+  case 38: /* clause: TOK_ATOM '(' vars ')' TOK_ARR goals  */
+#line 318 "parser.y"
       {
           (yyval.val.clause_val) = clause_new((yyvsp[-5].val.string_val), (yyvsp[-3].val.vars_val), (yyvsp[0].val.goals_val));
           (yyval.val.clause_val)->line_no = (yyvsp[-5].line_no);
       }
-#line 1820 "parser.c"
+#line 1611 "parser.c"
     break;
 
-  case 39:
-#line 315 "parser.y"
+  case 39: /* clauses: clause  */
+#line 325 "parser.y"
       {
           (yyval.val.clauses_val) = clause_list_new();
           clause_list_add_end((yyval.val.clauses_val), (yyvsp[0].val.clause_val));
       }
-#line 1829 "parser.c"
+#line 1620 "parser.c"
     break;
 
-  case 40:
-#line 320 "parser.y"
+  case 40: /* clauses: clauses clause  */
+#line 330 "parser.y"
       {
           clause_list_add_end((yyvsp[-1].val.clauses_val), (yyvsp[0].val.clause_val));
           (yyval.val.clauses_val) = (yyvsp[-1].val.clauses_val);
       }
-#line 1838 "parser.c"
+#line 1629 "parser.c"
     break;
 
-  case 41:
-#line 327 "parser.y"
+  case 41: /* query: TOK_ARR goals  */
+#line 337 "parser.y"
       {
          (yyval.val.query_val) = query_new((yyvsp[0].val.goals_val));
          (yyval.val.query_val)->line_no = (yyvsp[-1].line_no);
       }
-#line 1847 "parser.c"
+#line 1638 "parser.c"
     break;
 
-  case 42:
-#line 334 "parser.y"
+  case 42: /* program: clauses query  */
+#line 344 "parser.y"
       {
          (yyval.val.program_val) = *plg = program_new((yyvsp[-1].val.clauses_val), (yyvsp[0].val.query_val));
       }
-#line 1855 "parser.c"
+#line 1646 "parser.c"
     break;
 
-  case 43:
-#line 340 "parser.y"
+  case 43: /* program: query  */
+#line 350 "parser.y"
       {
         (yyval.val.program_val) = *plg = program_new(clause_list_new(), (yyvsp[0].val.query_val));
       }
-#line 1863 "parser.c"
+#line 1654 "parser.c"
     break;
 
 
-#line 1867 "parser.c"
+#line 1658 "parser.c"
 
       default: break;
     }
@@ -1878,11 +1669,10 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
 
@@ -1906,50 +1696,14 @@ yyreduce:
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE (yychar);
-
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
-      yyerror (plg, YY_("syntax error"));
-#else
-# define YYSYNTAX_ERROR yysyntax_error (&yymsg_alloc, &yymsg, \
-                                        yyssp, yytoken)
-      {
-        char const *yymsgp = YY_("syntax error");
-        int yysyntax_error_status;
-        yysyntax_error_status = YYSYNTAX_ERROR;
-        if (yysyntax_error_status == 0)
-          yymsgp = yymsg;
-        else if (yysyntax_error_status == 1)
-          {
-            if (yymsg != yymsgbuf)
-              YYSTACK_FREE (yymsg);
-            yymsg = YY_CAST (char *, YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
-            if (!yymsg)
-              {
-                yymsg = yymsgbuf;
-                yymsg_alloc = sizeof yymsgbuf;
-                yysyntax_error_status = 2;
-              }
-            else
-              {
-                yysyntax_error_status = YYSYNTAX_ERROR;
-                yymsgp = yymsg;
-              }
-          }
-        yyerror (plg, yymsgp);
-        if (yysyntax_error_status == 2)
-          goto yyexhaustedlab;
-      }
-# undef YYSYNTAX_ERROR
-#endif
+      yyerror (scanner, parse_result, plg, YY_("syntax error"));
     }
 
-
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
@@ -1964,7 +1718,7 @@ yyerrlab:
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval, plg);
+                      yytoken, &yylval, scanner, parse_result, plg);
           yychar = YYEMPTY;
         }
     }
@@ -1982,6 +1736,7 @@ yyerrorlab:
      label yyerrorlab therefore never appears in user code.  */
   if (0)
     YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -1998,13 +1753,14 @@ yyerrorlab:
 yyerrlab1:
   yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
       if (!yypact_value_is_default (yyn))
         {
-          yyn += YYTERROR;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
             {
               yyn = yytable[yyn];
               if (0 < yyn)
@@ -2018,7 +1774,7 @@ yyerrlab1:
 
 
       yydestruct ("Error: popping",
-                  yystos[yystate], yyvsp, plg);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, scanner, parse_result, plg);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -2030,7 +1786,7 @@ yyerrlab1:
 
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -2041,7 +1797,7 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
 /*-----------------------------------.
@@ -2049,31 +1805,29 @@ yyacceptlab:
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (plg, YY_("memory exhausted"));
+  yyerror (scanner, parse_result, plg, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
 
-/*-----------------------------------------------------.
-| yyreturn -- parsing is finished, return the result.  |
-`-----------------------------------------------------*/
-yyreturn:
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
   if (yychar != YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval, plg);
+                  yytoken, &yylval, scanner, parse_result, plg);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -2082,18 +1836,41 @@ yyreturn:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  yystos[+*yyssp], yyvsp, plg);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, scanner, parse_result, plg);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE (yymsg);
-#endif
+
   return yyresult;
 }
-#line 345 "parser.y"
 
+#line 355 "parser.y"
+
+
+/**
+ * Parses program from file. Each call has its own scanner and keeps no
+ * state in globals so programs may be parsed by many threads at once.
+ * Returns 0 on success.
+ */
+int parse_program(FILE * file, program ** program_value)
+{
+    yyscan_t scanner;
+    int parse_result = 0;
+
+    *program_value = NULL;
+    if (yylex_init_extra(1, &scanner) != 0)
+    {
+        return 1;
+    }
+    yyset_in(file, scanner);
+    if (yyparse(scanner, &parse_result, program_value) != 0)
+    {
+        parse_result = 1;
+    }
+    yylex_destroy(scanner);
+
+    return parse_result;
+}
@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,8 +31,9 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 #ifndef YY_YY_PARSER_H_INCLUDED
 # define YY_YY_PARSER_H_INCLUDED
@@ -44,35 +45,54 @@
 extern int yydebug;
 #endif
 /* "%code requires" blocks.  */
-#line 53 "parser.y"
+#line 51 "parser.y"
 
+#include <stdio.h>
 #include "program.h"
 
-#line 52 "parser.h"
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void * yyscan_t;
+#endif
+
+#line 59 "parser.h"
 
-/* Token type.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    TOK_ARR = 258,
-    TOK_ATOM = 259,
-    TOK_ANON = 260,
-    TOK_VAR = 261,
-    TOK_IMPL = 262,
-    TOK_QUERY = 263,
-    TOK_CUT = 264,
-    TOK_FAIL = 265,
-    TOK_IS = 266,
-    TOK_INT = 267,
-    TOK_NOT = 268
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    TOK_ARR = 258,                 /* TOK_ARR  */
+    TOK_ATOM = 259,                /* TOK_ATOM  */
+    TOK_ANON = 260,                /* TOK_ANON  */
+    TOK_VAR = 261,                 /* TOK_VAR  */
+    TOK_IMPL = 262,                /* TOK_IMPL  */
+    TOK_QUERY = 263,               /* TOK_QUERY  */
+    TOK_CUT = 264,                 /* TOK_CUT  */
+    TOK_FAIL = 265,                /* TOK_FAIL  */
+    TOK_IS = 266,                  /* TOK_IS  */
+    TOK_INT = 267,                 /* TOK_INT  */
+    TOK_NOT = 268                  /* TOK_NOT  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
 
 
 
-int yyparse (program ** plg);
+
+int yyparse (yyscan_t scanner, int * parse_result, program ** plg);
+
+/* "%code provides" blocks.  */
+#line 62 "parser.y"
+
+int parse_program(FILE * file, program ** program_value);
+
+#line 97 "parser.h"
 
 #endif /* !YY_YY_PARSER_H_INCLUDED  */
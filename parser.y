@@ -28,34 +28,44 @@
 #include "program.h"
 #include "term.h"
 
-int parse_result;
-
-int yyerror(program ** plg, char * str, ...)
+int yyerror(yyscan_t scanner, int * parse_result, program ** plg, char * str, ...)
 {
   va_list args;
-  parse_result = 1;
+  *parse_result = 1;
 
   va_start(args, str);
-  fprintf(stderr, "%d: ", line_no); vfprintf(stderr, str, args); fprintf(stderr, "\n");
+  fprintf(stderr, "%u: ", yyget_extra(scanner)); vfprintf(stderr, str, args); fprintf(stderr, "\n");
   va_end(args);
 
 	return 1;
 }
 
-int yylex(token * tokp)
+int yylex(token * tokp, yyscan_t scanner)
 {
-  return lex_scan(tokp);
+  return lex_scan(tokp, scanner);
 }
 
 %}
 
 %code requires
 {
+#include <stdio.h>
 #include "program.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void * yyscan_t;
+#endif
+}
+
+%code provides
+{
+int parse_program(FILE * file, program ** program_value);
 }
 
 %define api.pure
-%parse-param { program ** plg }
+%lex-param { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { int * parse_result } { program ** plg }
 
 %token <val.string_val> TOK_ARR
 %token <val.string_val> TOK_ATOM
@@ -113,8 +123,8 @@ var: TOK_VAR
      | error
      {
          $$ = NULL;
-         yyerror(NULL, "incorrect variable");
-         //yyerror(NULL, "incorrect variable, found '%s' instead", token_to_str(&yylval));
+         yyerror(scanner, parse_result, plg, "incorrect variable");
+         //yyerror(scanner, parse_result, plg, "incorrect variable, found '%s' instead", token_to_str(&yylval));
          //token_delete(&yylval);
          yyclearin;
      }
@@ -343,3 +353,28 @@ program: query
 ;
 
 %%
+
+/**
+ * Parses program from file. Each call has its own scanner and keeps no
+ * state in globals so programs may be parsed by many threads at once.
+ * Returns 0 on success.
+ */
+int parse_program(FILE * file, program ** program_value)
+{
+    yyscan_t scanner;
+    int parse_result = 0;
+
+    *program_value = NULL;
+    if (yylex_init_extra(1, &scanner) != 0)
+    {
+        return 1;
+    }
+    yyset_in(file, scanner);
+    if (yyparse(scanner, &parse_result, program_value) != 0)
+    {
+        parse_result = 1;
+    }
+    yylex_destroy(scanner);
+
+    return parse_result;
+}
@@ -0,0 +1,425 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "peephole.h"
+#include <stdlib.h>
+
+/**
+ * Absolute code addresses in instruction. Addresses of structures are
+ * predicate entries so they are relinked like jump targets. JUMP is
+ * relative to the next instruction and is not returned.
+ */
+static unsigned int peephole_addr_fields(bytecode * value, pc_offset * fields[3])
+{
+    unsigned int n = bytecode_targets(value, fields);
+
+    switch (value->type)
+    {
+        case BYTECODE_PUT_STRUCT_ADDR:
+            fields[n++] = (pc_offset *)&value->put_struct.addr;
+        break;
+        case BYTECODE_U_STRUCT_ADDR:
+            fields[n++] = (pc_offset *)&value->u_struct.addr;
+        break;
+        case BYTECODE_PUT_REF_U_STRUCT_ADDR:
+            fields[n++] = (pc_offset *)&value->put_ref_u_struct.addr;
+        break;
+        case BYTECODE_CASE_STRUCT_ADDR:
+            fields[n++] = (pc_offset *)&value->case_struct.addr;
+        break;
+        default:
+        break;
+    }
+
+    return n;
+}
+
+/**
+ * Addresses execution may continue at other than from the instruction
+ * before. Instructions at these addresses must stay in place.
+ */
+static char * peephole_targets(gencode * gen)
+{
+    unsigned int i, n;
+    pc_offset * fields[3];
+    bytecode_node * node = NULL;
+    char * target = (char *)calloc(gen->current_addr + 1, sizeof(char));
+
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        bytecode * value = &node->value;
+
+        n = peephole_addr_fields(value, fields);
+        for (i = 0; i < n; i++)
+        {
+            target[*fields[i]] = 1;
+        }
+        switch (value->type)
+        {
+            case BYTECODE_JUMP:
+                target[value->addr + 1 + value->jump.offset] = 1;
+            break;
+            case BYTECODE_TRY:
+                /* retry continues after TRY */
+                target[value->addr + 1] = 1;
+            break;
+            case BYTECODE_SWITCH_ON_CONST:
+                /* constant not in the table */
+                target[value->addr + 1 + value->switch_on_const.size] = 1;
+            break;
+            case BYTECODE_SWITCH_ON_STRUCT:
+                target[value->addr + 1 + value->switch_on_struct.size] = 1;
+            break;
+            default:
+            break;
+        }
+    }
+    for (i = 0; i < gen->predicate_size; i++)
+    {
+        target[gen->predicate_arr[i].begin] = 1;
+        target[gen->predicate_arr[i].addr] = 1;
+    }
+
+    return target;
+}
+
+/**
+ * Instructions keep their old address until relinked. Removed
+ * instruction is replaced by the one which followed it.
+ */
+void peephole_relink(gencode * gen)
+{
+    unsigned int i, n;
+    pc_offset * fields[3];
+    unsigned int old_size = gen->current_addr;
+    pc_ptr * map = (pc_ptr *)malloc(sizeof(pc_ptr) * (old_size + 1));
+    bytecode_node * node = NULL;
+    pc_ptr addr = 0;
+
+    for (i = 0; i <= old_size; i++)
+    {
+        map[i] = old_size + 1;
+    }
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        map[node->value.addr] = addr++;
+    }
+    map[old_size] = addr;
+    for (i = old_size; i > 0; i--)
+    {
+        if (map[i - 1] > old_size)
+        {
+            map[i - 1] = map[i];
+        }
+    }
+
+    addr = 0;
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        bytecode * value = &node->value;
+
+        n = peephole_addr_fields(value, fields);
+        for (i = 0; i < n; i++)
+        {
+            *fields[i] = map[*fields[i]];
+        }
+        if (value->type == BYTECODE_JUMP)
+        {
+            value->jump.offset = (pc_offset)map[value->addr + 1 + value->jump.offset] - (pc_offset)(addr + 1);
+        }
+        value->addr = addr++;
+    }
+    for (i = 0; i < gen->predicate_size; i++)
+    {
+        gen->predicate_arr[i].begin = map[gen->predicate_arr[i].begin];
+        gen->predicate_arr[i].end = map[gen->predicate_arr[i].end];
+        gen->predicate_arr[i].addr = map[gen->predicate_arr[i].addr];
+    }
+    gen->current_addr = addr;
+    gen->list->size = addr;
+
+    free(map);
+}
+
+/* removes instructions flagged by address and relinks the rest */
+static unsigned int peephole_remove(gencode * gen, const char * remove)
+{
+    unsigned int count = 0;
+    bytecode_node ** link = &gen->list->head;
+
+    while (*link != NULL)
+    {
+        bytecode_node * node = *link;
+        if (remove[node->value.addr])
+        {
+            *link = node->next;
+            bytecode_node_delete(node);
+            count++;
+        }
+        else
+        {
+            link = &node->next;
+        }
+    }
+    gen->list->tail = link;
+
+    if (count > 0)
+    {
+        peephole_relink(gen);
+    }
+
+    return count;
+}
+
+/**
+ * LABEL is a no-op for the machine. Targets of jumps to a label become
+ * the instruction after it.
+ */
+unsigned int peephole_strip_labels(gencode * gen)
+{
+    bytecode_node * node = NULL;
+    char * remove = (char *)calloc(gen->current_addr + 1, sizeof(char));
+    unsigned int count = 0;
+
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        remove[node->value.addr] = node->value.type == BYTECODE_LABEL;
+    }
+    count = peephole_remove(gen, remove);
+    free(remove);
+
+    return count;
+}
+
+/* follows JUMP instructions from addr, code is indexed by address */
+static pc_ptr peephole_final_target(bytecode ** code, unsigned int size, pc_ptr addr)
+{
+    unsigned int steps = 0;
+
+    while (addr < size && code[addr]->type == BYTECODE_JUMP && steps++ < size)
+    {
+        addr = code[addr]->addr + 1 + code[addr]->jump.offset;
+    }
+
+    return addr;
+}
+
+/**
+ * Jumps to a JUMP go straight to its target. Instructions which transfer
+ * control are retargeted, addresses of structures and calls are not.
+ * JUMP to the next instruction is removed.
+ */
+unsigned int peephole_jump_chains(gencode * gen)
+{
+    unsigned int i, count = 0;
+    unsigned int size = gen->current_addr;
+    bytecode ** code = (bytecode **)malloc(sizeof(bytecode *) * (size + 1));
+    char * remove = (char *)calloc(size + 1, sizeof(char));
+    bytecode_node * node = NULL;
+
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        code[node->value.addr] = &node->value;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        bytecode * value = code[i];
+        switch (value->type)
+        {
+            case BYTECODE_JUMP:
+            {
+                pc_ptr target = peephole_final_target(code, size, value->addr + 1 + value->jump.offset);
+                value->jump.offset = (pc_offset)target - (pc_offset)(value->addr + 1);
+                remove[i] = value->jump.offset == 0;
+            }
+            break;
+            case BYTECODE_U_STRUCT_ADDR:
+                value->u_struct.offset = peephole_final_target(code, size, value->u_struct.offset);
+            break;
+            case BYTECODE_UP:
+                value->up.offset = peephole_final_target(code, size, value->up.offset);
+            break;
+            case BYTECODE_MARK:
+                value->mark.offset = peephole_final_target(code, size, value->mark.offset);
+            break;
+            case BYTECODE_TRY:
+                value->try.offset = peephole_final_target(code, size, value->try.offset);
+            break;
+            case BYTECODE_SWITCH_ON_TERM:
+                value->switch_on_term.var_offset = peephole_final_target(code, size, value->switch_on_term.var_offset);
+                value->switch_on_term.const_offset = peephole_final_target(code, size, value->switch_on_term.const_offset);
+                value->switch_on_term.struct_offset = peephole_final_target(code, size, value->switch_on_term.struct_offset);
+            break;
+            case BYTECODE_CASE_CONST:
+                if (value->case_const.type != BYTECODE_CASE_EMPTY)
+                {
+                    value->case_const.offset = peephole_final_target(code, size, value->case_const.offset);
+                }
+            break;
+            case BYTECODE_CASE_STRUCT_ADDR:
+                value->case_struct.offset = peephole_final_target(code, size, value->case_struct.offset);
+            break;
+            default:
+            break;
+        }
+    }
+    count = peephole_remove(gen, remove);
+
+    free(code);
+    free(remove);
+
+    return count;
+}
+
+/* execution does not continue with the next instruction */
+static char peephole_is_transfer(bytecode_type type)
+{
+    switch (type)
+    {
+        case BYTECODE_JUMP:
+        case BYTECODE_FAIL:
+        case BYTECODE_POP_ENV:
+        case BYTECODE_LAST_CALL_ADDR:
+        case BYTECODE_SWITCH_ON_TERM:
+        case BYTECODE_HALT:
+        case BYTECODE_NO:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Removes instructions following a transfer of control which are not
+ * a target of any jump, such as jumps left unused by peephole_jump_chains.
+ */
+unsigned int peephole_unreachable(gencode * gen)
+{
+    unsigned int count = 0;
+    char reachable = 1;
+    char * target = peephole_targets(gen);
+    char * remove = (char *)calloc(gen->current_addr + 1, sizeof(char));
+    bytecode_node * node = NULL;
+
+    for (node = gen->list->head; node != NULL; node = node->next)
+    {
+        if (target[node->value.addr])
+        {
+            reachable = 1;
+        }
+        remove[node->value.addr] = !reachable;
+        if (peephole_is_transfer(node->value.type))
+        {
+            reachable = 0;
+        }
+    }
+    count = peephole_remove(gen, remove);
+
+    free(target);
+    free(remove);
+
+    return count;
+}
+
+static char peephole_fuse_pair(bytecode * first, bytecode * second)
+{
+    bytecode value = { 0 };
+    value.addr = first->addr;
+
+    if (first->type == BYTECODE_PUT_REF && second->type == BYTECODE_PUT_REF)
+    {
+        value.type = BYTECODE_PUT_REF_REF;
+        value.put_ref_ref.index = first->put_ref.index;
+        value.put_ref_ref.index2 = second->put_ref.index;
+    }
+    else if (first->type == BYTECODE_PUT_REF && second->type == BYTECODE_PUT_INT)
+    {
+        value.type = BYTECODE_PUT_REF_INT;
+        value.put_ref_int.index = first->put_ref.index;
+        value.put_ref_int.value = second->put_int.value;
+    }
+    else if (first->type == BYTECODE_PUT_REF && second->type == BYTECODE_U_ATOM)
+    {
+        value.type = BYTECODE_PUT_REF_U_ATOM;
+        value.put_ref_u_atom.index = first->put_ref.index;
+        value.put_ref_u_atom.idx = second->u_atom.idx;
+    }
+    else if (first->type == BYTECODE_PUT_REF && second->type == BYTECODE_U_STRUCT_ADDR)
+    {
+        value.type = BYTECODE_PUT_REF_U_STRUCT_ADDR;
+        value.put_ref_u_struct.index = first->put_ref.index;
+        value.put_ref_u_struct.offset = second->u_struct.offset;
+        value.put_ref_u_struct.n = second->u_struct.n;
+        value.put_ref_u_struct.addr = second->u_struct.addr;
+    }
+    else if (first->type == BYTECODE_SON && second->type == BYTECODE_U_VAR)
+    {
+        value.type = BYTECODE_SON_U_VAR;
+        value.son_u_var.number = first->son.number;
+        value.son_u_var.index = second->u_var.index;
+    }
+    else
+    {
+        return 0;
+    }
+
+    *first = value;
+    return 1;
+}
+
+/**
+ * Replaces frequent instruction pairs with superinstructions. Pairs were
+ * chosen by counting executed sequences with --ngrams over programs in
+ * bench/, see bench/ngrams.sh. Second instruction of a pair must not be
+ * a jump target. Returns number of fused pairs.
+ */
+unsigned int peephole_fuse(gencode * gen)
+{
+    unsigned int count = 0;
+    char * target = peephole_targets(gen);
+    bytecode_node * node = gen->list->head;
+
+    while (node != NULL && node->next != NULL)
+    {
+        bytecode_node * next = node->next;
+
+        if (!target[next->value.addr] && peephole_fuse_pair(&node->value, &next->value))
+        {
+            node->next = next->next;
+            if (gen->list->tail == &next->next)
+            {
+                gen->list->tail = &node->next;
+            }
+            bytecode_node_delete(next);
+            count++;
+        }
+        node = node->next;
+    }
+    free(target);
+
+    if (count > 0)
+    {
+        peephole_relink(gen);
+    }
+
+    return count;
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef __PEEPHOLE_H__
+#define __PEEPHOLE_H__
+
+#include "gencode.h"
+
+/**
+ * Passes over linked code, after bytecode_list_set_addr and before
+ * bytecode_to_array. Passes remove instructions from gen->list and
+ * peephole_relink gives remaining ones new addresses.
+ */
+void peephole_relink(gencode * gen);
+unsigned int peephole_strip_labels(gencode * gen);
+unsigned int peephole_jump_chains(gencode * gen);
+unsigned int peephole_unreachable(gencode * gen);
+unsigned int peephole_fuse(gencode * gen);
+
+#endif /* __PEEPHOLE_H__ */
@@ -20,8 +20,10 @@
  * THE SOFTWARE.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <getopt.h>
 
 #include "scanner.h"
 #include "parser.h"
@@ -33,66 +35,482 @@
 #include "strtab.h"
 #include "vm.h"
 
-extern int parse_result;
-extern int yyparse(program ** program_value);
+enum {
+	OPT_GC_THRESHOLD = 256,
+	OPT_GC_GROWTH,
+	OPT_GC_NURSERY,
+	OPT_HEAP,
+	OPT_STACK,
+	OPT_TRAIL,
+	OPT_MAX_HEAP,
+	OPT_MAX_STACK,
+	OPT_MAX_TRAIL,
+	OPT_NO_INDEX,
+	OPT_NO_FUSE,
+	OPT_NO_PEEPHOLE,
+	OPT_NGRAMS,
+	OPT_PROFILE_JSON,
+	OPT_MAX_SOLUTIONS,
+	OPT_ONCE
+};
+
+/* file starts with GENCODE_BINARY_MAGIC, see gencode_binary_save */
+static int is_binary(FILE * file)
+{
+	char magic[4] = { 0 };
+	size_t size = fread(magic, 1, sizeof(magic), file);
+
+	rewind(file);
+
+	return size == sizeof(magic) && memcmp(magic, GENCODE_BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+/* size with optional k or m suffix */
+static int parse_size(const char * str, unsigned int * size)
+{
+	char * end = NULL;
+	unsigned long value = strtoul(str, &end, 10);
+
+	if (end == str)
+	{
+		return 0;
+	}
+	if (*end == 'k' || *end == 'K')
+	{
+		value *= 1024;
+		end++;
+	}
+	else if (*end == 'm' || *end == 'M')
+	{
+		value *= 1024 * 1024;
+		end++;
+	}
+	if (*end != '\0' || value < 16 || value > 0x7fffffff)
+	{
+		return 0;
+	}
+	*size = (unsigned int)value;
+	return 1;
+}
+
+static void usage(const char * name)
+{
+	fprintf(stderr, "usage: %s [options] [file]\n", name);
+	fprintf(stderr, "  -c, --compile=out.plgb         write compiled program to out.plgb instead of running it\n");
+	fprintf(stderr, "  -d, --dispatch=table|threaded|compact\n");
+	fprintf(stderr, "                                 instruction dispatch (default threaded)\n");
+	fprintf(stderr, "  -f, --format=object|canonical  answers as object per line (default) or as terms,\n");
+	fprintf(stderr, "                                 one answer per line\n");
+	fprintf(stderr, "  -g, --gc=always|threshold|generational\n");
+	fprintf(stderr, "                                 garbage collection policy (default threshold)\n");
+	fprintf(stderr, "      --gc-threshold=F           heap occupancy which triggers collection (default 0.75)\n");
+	fprintf(stderr, "      --gc-growth=F              grow trigger to F times live cells after collection (default 2)\n");
+	fprintf(stderr, "      --gc-nursery=N             nursery size in cells of generational policy (default 8192)\n");
+	fprintf(stderr, "      --heap=N, --stack=N, --trail=N\n");
+	fprintf(stderr, "                                 initial sizes in cells/entries (default 4096)\n");
+	fprintf(stderr, "      --max-heap=N, --max-stack=N, --max-trail=N\n");
+	fprintf(stderr, "                                 maximum sizes (default 16M, 4M, 4M)\n");
+	fprintf(stderr, "      --max-solutions=N          stop after N answers without searching for more\n");
+	fprintf(stderr, "      --once                     stop after first answer, same as --max-solutions=1\n");
+	fprintf(stderr, "      --no-index                 do not index clauses on first argument\n");
+	fprintf(stderr, "      --no-peephole              keep labels, jump chains and unreachable code\n");
+	fprintf(stderr, "      --no-fuse                  do not replace frequent instruction pairs with superinstructions\n");
+	fprintf(stderr, "      --ngrams=FILE              write counts of executed instruction pairs and triples to FILE\n");
+	fprintf(stderr, "  -o, --occurs-check=on|off|error\n");
+	fprintf(stderr, "                                 binding variable into term containing it fails,\n");
+	fprintf(stderr, "                                 succeeds or stops with error (default on)\n");
+	fprintf(stderr, "  -p, --profile                  print per predicate port counts and times to stderr\n");
+	fprintf(stderr, "      --profile-json=FILE        write profile as JSON to FILE\n");
+	fprintf(stderr, "  -s, --stats                    print execution statistics to stderr\n");
+	fprintf(stderr, "  -h, --help                     print this message\n");
+}
 
 int main(int argc, char * argv[])
 {
-	if (argc > 1)
+	int opt;
+	int result = 0;
+	char print_stats = 0;
+	char index = 1;
+	char peephole = 1;
+	char fuse = 1;
+	vm_occurs_check occurs_check = VM_OCCURS_CHECK_ON;
+	const char * compile_file = NULL;
+	char print_profile = 0;
+	const char * profile_json_file = NULL;
+	const char * ngram_file = NULL;
+	vm_dispatch dispatch = VM_DISPATCH_THREADED;
+	writer_format format = WRITER_FORMAT_OBJECT;
+	gc_policy policy = GC_POLICY_THRESHOLD;
+	double gc_threshold = 0.75;
+	double gc_growth = 2.0;
+	unsigned int gc_nursery = GC_NURSERY_SIZE;
+	unsigned int heap_size = 4096;
+	unsigned int stack_size = 4096;
+	unsigned int trail_size = 4096;
+	unsigned int max_heap_size = VM_MAX_HEAP_SIZE;
+	unsigned int max_stack_size = VM_MAX_STACK_SIZE;
+	unsigned int max_trail_size = VM_MAX_TRAIL_SIZE;
+	unsigned long max_solutions = 0;
+
+	static struct option long_options[] = {
+		{ "compile", required_argument, NULL, 'c' },
+		{ "dispatch", required_argument, NULL, 'd' },
+		{ "format", required_argument, NULL, 'f' },
+		{ "gc", required_argument, NULL, 'g' },
+		{ "gc-threshold", required_argument, NULL, OPT_GC_THRESHOLD },
+		{ "gc-growth", required_argument, NULL, OPT_GC_GROWTH },
+		{ "gc-nursery", required_argument, NULL, OPT_GC_NURSERY },
+		{ "heap", required_argument, NULL, OPT_HEAP },
+		{ "stack", required_argument, NULL, OPT_STACK },
+		{ "trail", required_argument, NULL, OPT_TRAIL },
+		{ "max-heap", required_argument, NULL, OPT_MAX_HEAP },
+		{ "max-stack", required_argument, NULL, OPT_MAX_STACK },
+		{ "max-trail", required_argument, NULL, OPT_MAX_TRAIL },
+		{ "max-solutions", required_argument, NULL, OPT_MAX_SOLUTIONS },
+		{ "once", no_argument, NULL, OPT_ONCE },
+		{ "no-index", no_argument, NULL, OPT_NO_INDEX },
+		{ "no-fuse", no_argument, NULL, OPT_NO_FUSE },
+		{ "no-peephole", no_argument, NULL, OPT_NO_PEEPHOLE },
+		{ "ngrams", required_argument, NULL, OPT_NGRAMS },
+		{ "occurs-check", required_argument, NULL, 'o' },
+		{ "profile", no_argument, NULL, 'p' },
+		{ "profile-json", required_argument, NULL, OPT_PROFILE_JSON },
+		{ "stats", no_argument, NULL, 's' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	while ((opt = getopt_long(argc, argv, "c:d:f:g:o:psh", long_options, NULL)) != -1)
 	{
-		yyin = fopen(argv[1], "r");
-		if (yyin == NULL)
+		switch (opt)
 		{
-			fprintf(stderr, "Cannot open file %s: %s\n", argv[1], strerror(errno));
-			return 1;
+			case 'c':
+				compile_file = optarg;
+			break;
+			case 'd':
+				if (strcmp(optarg, "table") == 0)
+				{
+					dispatch = VM_DISPATCH_TABLE;
+				}
+				else if (strcmp(optarg, "threaded") == 0)
+				{
+					dispatch = VM_DISPATCH_THREADED;
+				}
+				else if (strcmp(optarg, "compact") == 0)
+				{
+					dispatch = VM_DISPATCH_COMPACT;
+				}
+				else
+				{
+					fprintf(stderr, "unknown dispatch mode %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+			break;
+			case 'g':
+				if (strcmp(optarg, "always") == 0)
+				{
+					policy = GC_POLICY_ALWAYS;
+				}
+				else if (strcmp(optarg, "threshold") == 0)
+				{
+					policy = GC_POLICY_THRESHOLD;
+				}
+				else if (strcmp(optarg, "generational") == 0)
+				{
+					policy = GC_POLICY_GENERATIONAL;
+				}
+				else
+				{
+					fprintf(stderr, "unknown gc policy %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+			break;
+			case OPT_GC_THRESHOLD:
+				gc_threshold = atof(optarg);
+				if (gc_threshold <= 0.0 || gc_threshold > 1.0)
+				{
+					fprintf(stderr, "gc threshold must be in (0, 1]\n");
+					return 1;
+				}
+			break;
+			case OPT_GC_GROWTH:
+				gc_growth = atof(optarg);
+			break;
+			case OPT_GC_NURSERY:
+				if (!parse_size(optarg, &gc_nursery))
+				{
+					fprintf(stderr, "incorrect size %s\n", optarg);
+					return 1;
+				}
+			break;
+			case OPT_MAX_SOLUTIONS:
+			{
+				char * end = NULL;
+				max_solutions = strtoul(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || max_solutions == 0)
+				{
+					fprintf(stderr, "incorrect number of solutions %s\n", optarg);
+					return 1;
+				}
+			}
+			break;
+			case OPT_ONCE:
+				max_solutions = 1;
+			break;
+			case OPT_HEAP:
+			case OPT_STACK:
+			case OPT_TRAIL:
+			case OPT_MAX_HEAP:
+			case OPT_MAX_STACK:
+			case OPT_MAX_TRAIL:
+			{
+				unsigned int * sizes[] = { &heap_size, &stack_size, &trail_size,
+				                           &max_heap_size, &max_stack_size, &max_trail_size };
+				if (!parse_size(optarg, sizes[opt - OPT_HEAP]))
+				{
+					fprintf(stderr, "incorrect size %s\n", optarg);
+					return 1;
+				}
+			}
+			break;
+			case OPT_NO_INDEX:
+				index = 0;
+			break;
+			case OPT_NO_FUSE:
+				fuse = 0;
+			break;
+			case OPT_NO_PEEPHOLE:
+				peephole = 0;
+			break;
+			case 'f':
+				if (strcmp(optarg, "object") == 0)
+				{
+					format = WRITER_FORMAT_OBJECT;
+				}
+				else if (strcmp(optarg, "canonical") == 0)
+				{
+					format = WRITER_FORMAT_CANONICAL;
+				}
+				else
+				{
+					fprintf(stderr, "unknown answer format %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+			break;
+			case 'o':
+				if (strcmp(optarg, "on") == 0)
+				{
+					occurs_check = VM_OCCURS_CHECK_ON;
+				}
+				else if (strcmp(optarg, "off") == 0)
+				{
+					occurs_check = VM_OCCURS_CHECK_OFF;
+				}
+				else if (strcmp(optarg, "error") == 0)
+				{
+					occurs_check = VM_OCCURS_CHECK_ERROR;
+				}
+				else
+				{
+					fprintf(stderr, "unknown occurs check mode %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+			break;
+			case 'p':
+				print_profile = 1;
+			break;
+			case OPT_PROFILE_JSON:
+				profile_json_file = optarg;
+			break;
+			case OPT_NGRAMS:
+				ngram_file = optarg;
+			break;
+			case 's':
+				print_stats = 1;
+			break;
+			case 'h':
+				usage(argv[0]);
+				return 0;
+			default:
+				usage(argv[0]);
+				return 1;
 		}
 	}
-	else
+
+	FILE * file = stdin;
+
+	if (optind < argc)
 	{
-		yyin = stdin;
+		file = fopen(argv[optind], "r");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Cannot open file %s: %s\n", argv[optind], strerror(errno));
+			return 1;
+		}
 	}
 
 	program * program_value = NULL;
+	gencode * gen = NULL;
+	gencode_binary * binary_value = NULL;
 
-	parse_result = 0;
-	yyparse(&program_value);
-
-	if (parse_result == 0 && program_value != NULL)
+	if (file != stdin && is_binary(file))
+	{
+		binary_value = gencode_binary_load(argv[optind]);
+		if (binary_value == NULL)
+		{
+			result = 1;
+		}
+	}
+	else
 	{
-		semcheck_result sem_res = SEMCHECK_SUCCESS;
-		builtin_add_all(program_value->clausies);
-		program_semcheck(program_value, &sem_res);
-		if (sem_res == SEMCHECK_SUCCESS)
+		if (parse_program(file, &program_value) == 0 && program_value != NULL)
 		{
-			gencode * gen = gencode_new();
-			gencode_result gen_res = GENCODE_SUCCESS;
-			program_gencode(gen, program_value, &gen_res);
-			if (gen_res == GENCODE_SUCCESS)
+			semcheck_result sem_res = SEMCHECK_SUCCESS;
+			builtin_add_once(program_value->clausies, program_value->query_value);
+			builtin_add_all(program_value->clausies);
+			program_semcheck(program_value, &sem_res);
+			if (sem_res == SEMCHECK_SUCCESS)
 			{
-				gencode_binary * binary_value = gencode_binary_new();
-				gencode_binary_generate(binary_value, gen);
+				gen = gencode_new();
+				gencode_result gen_res = GENCODE_SUCCESS;
+				gen->index = index;
+				gen->peephole = peephole;
+				gen->fuse = fuse;
+				gen->occurs_check = occurs_check != VM_OCCURS_CHECK_OFF;
+				program_gencode(gen, program_value, &gen_res);
+				if (gen_res == GENCODE_SUCCESS)
+				{
+					binary_value = gencode_binary_new();
+					gencode_binary_generate(binary_value, gen);
+				}
+			}
+		}
+	}
 
-				//strtab_array_print(binary_value->strtab_array, binary_value->strtab_size);
-				//bytecode_list_print(gen->list);
+	if (binary_value != NULL && compile_file != NULL)
+	{
+		if (gencode_binary_save(binary_value, compile_file) != GENCODE_SUCCESS)
+		{
+			result = 1;
+		}
+	}
+	else if (binary_value != NULL && dispatch == VM_DISPATCH_COMPACT &&
+	         ngram_file == NULL && gencode_binary_compact(binary_value) != GENCODE_SUCCESS)
+	{
+		result = 1;
+	}
+	else if (binary_value != NULL)
+	{
+		if (ngram_file != NULL)
+		{
+			/* pairs are counted by table dispatch loop */
+			dispatch = VM_DISPATCH_TABLE;
+		}
+		if (dispatch == VM_DISPATCH_THREADED)
+		{
+			vm_thread_code(binary_value);
+		}
 
-				vm * vm_value = vm_new(4096, 4096, 4096);
-				vm_execute(vm_value, binary_value);
-				vm_delete(vm_value);
+		//strtab_array_print(binary_value->strtab_array, binary_value->strtab_size);
+		//bytecode_list_print(gen->list);
 
-				gencode_binary_delete(binary_value);
+		vm * vm_value = vm_new(heap_size, stack_size, trail_size);
+		vm_set_max_size(vm_value, max_heap_size, max_stack_size, max_trail_size);
+		vm_value->dispatch = dispatch;
+		vm_value->occurs_check = occurs_check;
+		vm_value->out->format = format;
+		vm_value->max_solutions = max_solutions;
+		gc_set_policy(vm_value->collector, policy, gc_threshold, gc_growth);
+		gc_set_nursery(vm_value->collector, gc_nursery);
+		if (print_profile || profile_json_file != NULL)
+		{
+			vm_value->profiler = profile_new(binary_value,
+			                                  dispatch == VM_DISPATCH_COMPACT ? binary_value->compact_addr : NULL);
+		}
+		if (ngram_file != NULL)
+		{
+			vm_value->ngrams = ngram_new();
+		}
+		result = vm_execute(vm_value, binary_value);
+		if (print_stats)
+		{
+			vm_print_stats(vm_value);
+			if (gen != NULL && gen->generated_size > 0)
+			{
+				fprintf(stderr, "code size           : %u (generated %u, %.1f%% smaller)\n",
+						binary_value->code_size, gen->generated_size,
+						100.0 * (gen->generated_size - binary_value->code_size) / gen->generated_size);
+			}
+			else
+			{
+				fprintf(stderr, "code size           : %u\n", binary_value->code_size);
 			}
-			gencode_delete(gen);
+			if (dispatch == VM_DISPATCH_COMPACT)
+			{
+				fprintf(stderr, "compact code        : %u bytes (fixed %lu bytes)\n",
+						binary_value->compact_size,
+						(unsigned long)(binary_value->code_size * sizeof(bytecode)));
+			}
+		}
+		if (vm_value->profiler != NULL)
+		{
+			if (print_profile)
+			{
+				profile_print(vm_value->profiler, stderr);
+			}
+			if (profile_json_file != NULL)
+			{
+				FILE * json = fopen(profile_json_file, "w");
+				if (json != NULL)
+				{
+					profile_print_json(vm_value->profiler, json);
+					fclose(json);
+				}
+				else
+				{
+					fprintf(stderr, "cannot open file %s: %s\n", profile_json_file, strerror(errno));
+					result = 1;
+				}
+			}
+			profile_delete(vm_value->profiler);
+		}
+		if (vm_value->ngrams != NULL)
+		{
+			FILE * file = fopen(ngram_file, "w");
+			if (file != NULL)
+			{
+				ngram_print(vm_value->ngrams, file);
+				fclose(file);
+			}
+			else
+			{
+				fprintf(stderr, "cannot open file %s: %s\n", ngram_file, strerror(errno));
+				result = 1;
+			}
+			ngram_delete(vm_value->ngrams);
 		}
+		vm_delete(vm_value);
+	}
+
+	if (binary_value != NULL)
+	{
+		gencode_binary_delete(binary_value);
+	}
+	if (gen != NULL)
+	{
+		gencode_delete(gen);
 	}
 	if (program_value != NULL)
 	{
 		program_delete(program_value);
 	}
 
-	fclose(yyin);
-
-	yylex_destroy();
+	fclose(file);
 
-	return 0;
+	return result;
 }
 
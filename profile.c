@@ -0,0 +1,326 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double profile_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* time since the last event belongs to the predicate on top */
+static void profile_tick(profile * value, double now)
+{
+    if (value->frame_size > 0)
+    {
+        unsigned int top = value->frames[value->frame_size - 1].predicate;
+        value->predicates[top].excl_time += now - value->last_time;
+    }
+    value->last_time = now;
+}
+
+static void profile_push(profile * value, unsigned int predicate, stack_ptr fp, double now)
+{
+    profile_predicate * entry = value->predicates + predicate;
+
+    if (value->frame_size == value->frame_capacity)
+    {
+        value->frame_capacity *= 2;
+        value->frames = (profile_frame *)realloc(value->frames,
+                            sizeof(profile_frame) * value->frame_capacity);
+    }
+    value->frames[value->frame_size].predicate = predicate;
+    value->frames[value->frame_size].fp = fp;
+    value->frame_size++;
+
+    if (entry->depth++ == 0)
+    {
+        entry->enter_time = now;
+    }
+}
+
+static profile_predicate * profile_pop(profile * value, double now)
+{
+    value->frame_size--;
+    profile_predicate * entry = value->predicates + value->frames[value->frame_size].predicate;
+
+    if (--entry->depth == 0)
+    {
+        entry->incl_time += now - entry->enter_time;
+    }
+
+    return entry;
+}
+
+/**
+ * addr_map translates instruction indexes to code addresses seen by vm,
+ * it is compact_addr for compact dispatch and NULL otherwise.
+ */
+profile * profile_new(gencode_binary * binary_value, pc_ptr * addr_map)
+{
+    unsigned int i;
+    pc_ptr pc;
+    profile * value = (profile *)malloc(sizeof(profile));
+
+    value->predicate_size = binary_value->predicate_size;
+    value->predicates = (profile_predicate *)calloc(value->predicate_size + 1, sizeof(profile_predicate));
+    value->code_size = addr_map != NULL ? binary_value->compact_size : binary_value->code_size;
+    value->pc_predicate = (unsigned int *)calloc(value->code_size + 1, sizeof(unsigned int));
+
+    for (i = 0; i < binary_value->predicate_size; i++)
+    {
+        gencode_predicate * predicate = binary_value->predicate_arr + i;
+
+        value->predicates[i].name = binary_value->strtab_array[predicate->name];
+        value->predicates[i].arity = predicate->arity;
+        pc_ptr begin = predicate->begin;
+        pc_ptr end = predicate->end;
+
+        if (addr_map != NULL)
+        {
+            begin = addr_map[begin];
+            end = addr_map[end];
+        }
+        for (pc = begin; pc < end; pc++)
+        {
+            value->pc_predicate[pc] = i + 1;
+        }
+    }
+
+    value->frame_size = 0;
+    value->frame_capacity = 64;
+    value->frames = (profile_frame *)malloc(sizeof(profile_frame) * value->frame_capacity);
+    value->last_time = profile_now();
+
+    return value;
+}
+
+void profile_delete(profile * value)
+{
+    free(value->predicates);
+    free(value->pc_predicate);
+    free(value->frames);
+    free(value);
+}
+
+void profile_call(profile * value, pc_ptr addr, stack_ptr fp)
+{
+    double now = profile_now();
+
+    if (addr >= value->code_size || value->pc_predicate[addr] == 0)
+    {
+        return;
+    }
+
+    profile_tick(value, now);
+    profile_push(value, value->pc_predicate[addr] - 1, fp, now);
+    value->predicates[value->pc_predicate[addr] - 1].call_count++;
+}
+
+/**
+ * Return to frame fp. Predicates in frames above fp are done, also
+ * the ones which called them as the last goal.
+ */
+void profile_exit(profile * value, stack_ptr fp)
+{
+    double now = profile_now();
+
+    profile_tick(value, now);
+    while (value->frame_size > 0 &&
+           value->frames[value->frame_size - 1].fp > fp)
+    {
+        profile_pop(value, now)->exit_count++;
+    }
+}
+
+/**
+ * Backtrack to choice point in frame bp which continues at pc. Active
+ * predicates above bp fail. When the predicate owning the choice point
+ * has already exited it is entered again through redo, together with
+ * its exited callers. Caller of a frame is found from the return
+ * address and the saved frame pointer.
+ */
+void profile_backtrack(profile * value, gc_stack * stack, pc_ptr pc, stack_ptr bp)
+{
+    unsigned int redo_size = 0;
+    unsigned int predicate = 0;
+    stack_ptr top_fp = -1;
+    double now = profile_now();
+
+    profile_tick(value, now);
+    while (value->frame_size > 0 &&
+           value->frames[value->frame_size - 1].fp > bp)
+    {
+        profile_pop(value, now)->fail_count++;
+    }
+    if (value->frame_size > 0)
+    {
+        top_fp = value->frames[value->frame_size - 1].fp;
+    }
+
+    /* exited frames from bp down to the first active one, pushed afterwards */
+    predicate = pc < value->code_size ? value->pc_predicate[pc] : 0;
+    while (predicate != 0 && bp > top_fp)
+    {
+        if (value->frame_size + redo_size == value->frame_capacity)
+        {
+            value->frame_capacity *= 2;
+            value->frames = (profile_frame *)realloc(value->frames,
+                                sizeof(profile_frame) * value->frame_capacity);
+        }
+        value->frames[value->frame_size + redo_size].predicate = predicate - 1;
+        value->frames[value->frame_size + redo_size].fp = bp;
+        redo_size++;
+
+        pc = stack[bp].offset;
+        bp = stack[bp - 1].saddr;
+        predicate = pc < value->code_size ? value->pc_predicate[pc] : 0;
+    }
+
+    while (redo_size > 0)
+    {
+        profile_frame frame = value->frames[value->frame_size + redo_size - 1];
+        redo_size--;
+
+        profile_push(value, frame.predicate, frame.fp, now);
+        value->predicates[frame.predicate].redo_count++;
+    }
+}
+
+/* close predicates still active when machine stopped */
+void profile_finish(profile * value)
+{
+    double now = profile_now();
+
+    profile_tick(value, now);
+    while (value->frame_size > 0)
+    {
+        profile_pop(value, now);
+    }
+}
+
+static int profile_cmp(const void * a, const void * b)
+{
+    const profile_predicate * pa = *(const profile_predicate **)a;
+    const profile_predicate * pb = *(const profile_predicate **)b;
+
+    if (pa->excl_time != pb->excl_time)
+    {
+        return pa->excl_time < pb->excl_time ? 1 : -1;
+    }
+    return strcmp(pa->name, pb->name);
+}
+
+/* called predicates ordered by exclusive time */
+static profile_predicate ** profile_sorted(profile * value, unsigned int * size)
+{
+    unsigned int i;
+    profile_predicate ** sorted = (profile_predicate **)malloc(sizeof(profile_predicate *) * (value->predicate_size + 1));
+
+    *size = 0;
+    for (i = 0; i < value->predicate_size; i++)
+    {
+        if (value->predicates[i].call_count > 0 || value->predicates[i].redo_count > 0)
+        {
+            sorted[(*size)++] = value->predicates + i;
+        }
+    }
+    qsort(sorted, *size, sizeof(profile_predicate *), profile_cmp);
+
+    return sorted;
+}
+
+void profile_print(profile * value, FILE * file)
+{
+    unsigned int i, size;
+    double total = 0.0;
+    char name[64];
+    profile_predicate ** sorted = profile_sorted(value, &size);
+
+    for (i = 0; i < size; i++)
+    {
+        total += sorted[i]->excl_time;
+    }
+
+    fprintf(file, "%-24s %10s %10s %10s %10s %11s %11s %7s\n",
+            "predicate", "call", "exit", "redo", "fail", "incl ms", "excl ms", "excl %");
+    for (i = 0; i < size; i++)
+    {
+        profile_predicate * entry = sorted[i];
+        snprintf(name, sizeof(name), "%s/%u", entry->name, entry->arity);
+        fprintf(file, "%-24s %10lu %10lu %10lu %10lu %11.3f %11.3f %7.2f\n",
+                name, entry->call_count, entry->exit_count,
+                entry->redo_count, entry->fail_count,
+                entry->incl_time * 1e3, entry->excl_time * 1e3,
+                total > 0.0 ? 100.0 * entry->excl_time / total : 0.0);
+    }
+
+    free(sorted);
+}
+
+static void profile_print_json_str(const char * str, FILE * file)
+{
+    fputc('"', file);
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fputc('\\', file);
+            fputc(*str, file);
+        }
+        else if ((unsigned char)*str < 0x20)
+        {
+            fprintf(file, "\\u%04x", (unsigned char)*str);
+        }
+        else
+        {
+            fputc(*str, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void profile_print_json(profile * value, FILE * file)
+{
+    unsigned int i, size;
+    profile_predicate ** sorted = profile_sorted(value, &size);
+
+    fprintf(file, "{\n  \"predicates\": [");
+    for (i = 0; i < size; i++)
+    {
+        profile_predicate * entry = sorted[i];
+        fprintf(file, "%s\n    { \"name\": ", i > 0 ? "," : "");
+        profile_print_json_str(entry->name, file);
+        fprintf(file, ", \"arity\": %u, \"call\": %lu, \"exit\": %lu, \"redo\": %lu, \"fail\": %lu, "
+                      "\"incl_time\": %.9f, \"excl_time\": %.9f }",
+                entry->arity, entry->call_count, entry->exit_count,
+                entry->redo_count, entry->fail_count,
+                entry->incl_time, entry->excl_time);
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    free(sorted);
+}
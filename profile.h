@@ -0,0 +1,79 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdio.h>
+#include "vm_types.h"
+#include "gencode.h"
+#include "gc.h"
+
+/**
+ * Port profiler. A predicate is entered through call or redo and left
+ * through exit or fail. Active predicates are kept on a shadow stack
+ * together with the frame they run in, so returns and backtracking
+ * find the predicates they leave by comparing frame pointers.
+ */
+typedef struct profile_predicate {
+    const char * name;
+    unsigned int arity;
+    unsigned long call_count;
+    unsigned long exit_count;
+    unsigned long redo_count;
+    unsigned long fail_count;
+    double incl_time; /* seconds while active, recursion counted once */
+    double excl_time; /* seconds while on top of the shadow stack */
+    unsigned int depth; /* active activations */
+    double enter_time;
+} profile_predicate;
+
+typedef struct profile_frame {
+    unsigned int predicate;
+    stack_ptr fp;
+} profile_frame;
+
+typedef struct profile {
+    profile_predicate * predicates;
+    unsigned int predicate_size;
+
+    unsigned int * pc_predicate; /* predicate index + 1 for each instruction */
+    unsigned int code_size;
+
+    profile_frame * frames;
+    unsigned int frame_size;
+    unsigned int frame_capacity;
+
+    double last_time;
+} profile;
+
+profile * profile_new(gencode_binary * binary_value, pc_ptr * addr_map);
+void profile_delete(profile * value);
+
+void profile_call(profile * value, pc_ptr addr, stack_ptr fp);
+void profile_exit(profile * value, stack_ptr fp);
+void profile_backtrack(profile * value, gc_stack * stack, pc_ptr pc, stack_ptr bp);
+void profile_finish(profile * value);
+
+void profile_print(profile * value, FILE * file);
+void profile_print_json(profile * value, FILE * file);
+
+#endif /* __PROFILE_H__ */
@@ -54,18 +54,19 @@ typedef struct token {
 	unsigned int line_no;
 } token;
 
-extern unsigned int line_no;
+/* reentrant scanner, extra data is the current line number */
+extern int yylex_init_extra(unsigned int line_no, yyscan_t * scanner);
+extern void yyset_in(FILE * in_str, yyscan_t scanner);
+extern unsigned int yyget_extra(yyscan_t scanner);
+extern int yylex_destroy(yyscan_t scanner);
 
-extern FILE * yyin;
-
-extern int lex_scan(token * tokp);
-extern int yylex_destroy();
+extern int lex_scan(token * tokp, yyscan_t yyscanner);
 
 extern const char * token_to_str(token * tokp);
 extern void token_delete(token * tokp);
 
 #define YYSTYPE token
-#define YY_DECL int lex_scan(token * tokp)
+#define YY_DECL int lex_scan(token * tokp, yyscan_t yyscanner)
 
 #endif /* __SCANNER_H__ */
 
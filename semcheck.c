@@ -204,6 +204,12 @@ void expr_semcheck(symtab * stab, var_list * freevars, expr * expr_value, semche
             }
         }
         break;
+        case EXPR_SHL:
+            expr_semcheck(stab, freevars, expr_value->shl.expr_value, result);
+        break;
+        case EXPR_SHR:
+            expr_semcheck(stab, freevars, expr_value->shr.expr_value, result);
+        break;
     }
 }
 
@@ -285,6 +291,12 @@ void expr_get_vars_semcheck(symtab * stab, expr * expr_value)
             }
         }
         break;
+        case EXPR_SHL:
+            expr_get_vars_semcheck(stab, expr_value->shl.expr_value);
+        break;
+        case EXPR_SHR:
+            expr_get_vars_semcheck(stab, expr_value->shr.expr_value);
+        break;
     }
 }
 
@@ -518,6 +530,7 @@ void goal_is_semcheck(symtab * stab, goal * goal_value, goal_is * value, semchec
 
     var_semcheck(stab, freevars, value->var_value, result);
     expr_semcheck(stab, freevars, value->expr_value, result);
+    value->expr_value = expr_fold(value->expr_value);
 
     var_list_enumerate(freevars, stab->count + 1);
     var_list_add_to_symtab(stab, freevars, result);
@@ -531,6 +544,8 @@ void goal_lt_semcheck(symtab * stab, goal * goal_value, goal_lt * value, semchec
 
     expr_semcheck(stab, freevars, value->left_value, result);
     expr_semcheck(stab, freevars, value->right_value, result);
+    value->left_value = expr_fold(value->left_value);
+    value->right_value = expr_fold(value->right_value);
 
     var_list_enumerate(freevars, stab->count + 1);
     var_list_add_to_symtab(stab, freevars, result);
@@ -544,6 +559,8 @@ void goal_gt_semcheck(symtab * stab, goal * goal_value, goal_gt * value, semchec
 
     expr_semcheck(stab, freevars, value->left_value, result);
     expr_semcheck(stab, freevars, value->right_value, result);
+    value->left_value = expr_fold(value->left_value);
+    value->right_value = expr_fold(value->right_value);
 
     var_list_enumerate(freevars, stab->count + 1);
     var_list_add_to_symtab(stab, freevars, result);
@@ -678,9 +695,10 @@ void query_semcheck(symtab * stab, query * value, semcheck_result * result)
     goal_list_semcheck(value->stab, &value->with_cut, value->goals, result);
 }
 
+/* clauses of a program with parent symtab shadow predicates of the parent, see plg_query_open */
 void program_add_clause_semcheck(symtab * stab, clause * value, semcheck_result * result)
 {
-    symtab_entry * entry = symtab_lookup_arity(stab, value->name, clause_arity(value), SYMTAB_LOOKUP_GLOBAL);
+    symtab_entry * entry = symtab_lookup_arity(stab, value->name, clause_arity(value), SYMTAB_LOOKUP_LOCAL);
     if (entry == NULL)
     {
         symtab_add_predicate(stab, value);
@@ -206,6 +206,26 @@ void strtab_to_array(strtab * tab, char *** strings, unsigned int * size)
     }
 }
 
+/* strings keep their indexes, missing strings leave gaps */
+strtab * strtab_from_array(char ** strings, unsigned int size)
+{
+    unsigned int i = 0;
+    strtab * tab = strtab_new(32);
+
+    for (i = 0; i < size; i++)
+    {
+        if (strings[i] != NULL)
+        {
+            strtab_entry_add_string(tab->entries, tab->size, strings[i], i);
+            tab->count++;
+            strtab_resize(tab);
+        }
+    }
+    tab->count = size > 0 ? size : 1;
+
+    return tab;
+}
+
 void strtab_array_delete(char ** strings, unsigned int size)
 {
     unsigned int i = 0;
@@ -164,9 +164,10 @@ void test_seven()
     stack[1].type = STACK_TYPE_HEAP_PTR;
     stack[1].addr = struct1;
 
-    assert(collector->free[collector->heap_idx] == 8);
+    /* struct header is followed by its two argument cells */
+    assert(collector->free == 10);
     gc_run(collector, stack, 1, NULL, -1);
-    assert(collector->free[collector->heap_idx] == 5);
+    assert(collector->free == 7);
 
     assert(gc_get_ref_ref(collector, stack[0].addr) == stack[1].addr);
     assert(gc_get_struct_size(collector, stack[1].addr) == 2);
@@ -198,16 +199,15 @@ void test_eight()
     stack[1].type = STACK_TYPE_HEAP_PTR;
     stack[1].addr = struct1;
 
-    assert(collector->heap_idx == 0);
-    assert(collector->free[collector->heap_idx] == 8);
+    assert(collector->free == 10);
 
     gc_run(collector, stack, 1, NULL, -1);
-    assert(collector->heap_idx == 1);
-    assert(collector->free[collector->heap_idx] == 5);
+    assert(collector->free == 7);
 
+    /* cells keep their order */
+    assert(stack[1].addr < stack[0].addr);
     gc_run(collector, stack, 1, NULL, -1);
-    assert(collector->heap_idx == 0);
-    assert(collector->free[collector->heap_idx] == 5);
+    assert(collector->free == 7);
 
     assert(gc_get_ref_ref(collector, stack[0].addr) == stack[1].addr);
     assert(gc_get_struct_size(collector, stack[1].addr) == 2);
@@ -217,6 +217,217 @@ void test_eight()
     gc_delete(collector);
 }
 
+void test_nine()
+{
+    gc * collector = gc_new(64);
+    gc_stack stack[1] = { 0 };
+
+    gc_set_policy(collector, GC_POLICY_THRESHOLD, 0.5, 1.0);
+    assert(collector->trigger == 32);
+
+    heap_ptr atom1 = gc_alloc_atom(collector, 12);
+    while (gc_get_hp(collector) < 32)
+    {
+        assert(!gc_need_run(collector));
+        gc_alloc_anon(collector);
+    }
+    assert(gc_need_run(collector));
+
+    stack[0].type = STACK_TYPE_HEAP_PTR;
+    stack[0].addr = atom1;
+
+    gc_run(collector, stack, 0, NULL, -1);
+    assert(!gc_need_run(collector));
+    assert(collector->stats.run_count == 1);
+    assert(collector->stats.reclaimed == 30);
+    assert(gc_get_atom_idx(collector, stack[0].addr) == 12);
+
+    gc_set_policy(collector, GC_POLICY_ALWAYS, 0.5, 1.0);
+    assert(gc_need_run(collector));
+
+    gc_delete(collector);
+}
+
+void test_ten()
+{
+    gc * collector = gc_new(64);
+    gc_stack stack[20] = { 0 };
+    unsigned int i;
+
+    gc_set_policy(collector, GC_POLICY_THRESHOLD, 0.25, 2.0);
+    for (i = 0; i < 20; i++)
+    {
+        stack[i].type = STACK_TYPE_HEAP_PTR;
+        stack[i].addr = gc_alloc_atom(collector, i);
+    }
+    assert(gc_need_run(collector));
+
+    gc_run(collector, stack, 19, NULL, -1);
+    /* 20 live cells + 1 reserved, trigger grows to 42 */
+    assert(collector->trigger == 42);
+    assert(!gc_need_run(collector));
+
+    gc_delete(collector);
+}
+
+void test_eleven()
+{
+    gc * collector = gc_new(64);
+
+    heap_ptr int1 = gc_alloc_int(collector, -7);
+    heap_ptr int2 = gc_alloc_int(collector, 2147483647);
+    heap_ptr var1 = gc_alloc_var(collector);
+    heap_ptr struct1 = gc_alloc_struct(collector, 3, 0xfffffff0);
+    gc_set_struct_ref(collector, struct1, 0, int1);
+    gc_set_struct_ref(collector, struct1, 1, int2);
+    gc_set_struct_ref(collector, struct1, 2, var1);
+
+    /* cells are inline, struct arguments follow the header */
+    assert(struct1 == var1 + 1);
+    assert(gc_get_hp(collector) == struct1 + 4);
+
+    assert(gc_get_object_type(collector, int1) == OBJECT_INT);
+    assert(gc_get_object_type(collector, var1) == OBJECT_REF);
+    assert(gc_get_object_type(collector, struct1) == OBJECT_STRUCT);
+    assert(gc_get_int_value(collector, int1) == -7);
+    assert(gc_get_int_value(collector, int2) == 2147483647);
+    assert(gc_get_var_ref(collector, var1) == var1);
+    assert(gc_get_struct_size(collector, struct1) == 3);
+    assert(gc_get_struct_addr(collector, struct1) == 0xfffffff0);
+    assert(gc_get_struct_ref(collector, struct1, 2) == var1);
+
+    gc_set_int_value(collector, int1, -2147483647 - 1);
+    assert(gc_get_int_value(collector, int1) == -2147483647 - 1);
+
+    /* allocations counted by size in cells */
+    assert(collector->stats.alloc_count[0] == 3);
+    assert(collector->stats.alloc_count[3] == 1);
+    assert(collector->stats.alloc_cells == 7);
+
+    gc_reset_hp(collector, struct1);
+    assert(gc_get_hp(collector) == struct1);
+
+    gc_delete(collector);
+}
+
+void test_twelve()
+{
+    unsigned int i;
+    gc * collector = gc_new(8);
+    gc_set_max_size(collector, 32);
+
+    heap_ptr int1 = gc_alloc_int(collector, 11);
+    for (i = 0; i < 12; i++)
+    {
+        assert(gc_alloc_var(collector) != 0);
+    }
+
+    /* heap grew and kept its contents */
+    assert(collector->size == 16);
+    assert(gc_get_int_value(collector, int1) == 11);
+
+    assert(gc_alloc_struct(collector, 17, 0) != 0);
+    assert(collector->size == 32);
+
+    /* no room left below maximum */
+    assert(gc_alloc_struct(collector, 8, 0) == 0);
+    assert(collector->size == 32);
+
+    gc_delete(collector);
+}
+
+void test_thirteen()
+{
+    unsigned int i;
+    gc * collector = gc_new(64);
+    gc_stack stack[1] = { 0 };
+
+    gc_set_policy(collector, GC_POLICY_GENERATIONAL, 1.0, 1.0);
+    gc_set_nursery(collector, 8);
+
+    stack[0].type = STACK_TYPE_HEAP_PTR;
+    stack[0].addr = gc_alloc_var(collector);
+    gc_alloc_atom(collector, 1);
+
+    /* variable is promoted, atom reclaimed */
+    gc_run_minor(collector, stack, 0, NULL, -1);
+    assert(collector->old_top == 2);
+    assert(gc_get_hp(collector) == 2);
+    assert(collector->stats.promoted == 1);
+
+    /* old variable bound to new struct goes to remembered set */
+    heap_ptr atom1 = gc_alloc_atom(collector, 12);
+    heap_ptr struct1 = gc_alloc_struct(collector, 1, 0);
+    gc_set_struct_ref(collector, struct1, 0, atom1);
+    assert(collector->remembered_top == 0);
+    gc_set_ref_ref(collector, stack[0].addr, struct1);
+    assert(collector->remembered_top == 1);
+
+    for (i = 0; i < 5; i++)
+    {
+        assert(!gc_need_run(collector));
+        gc_alloc_anon(collector);
+    }
+    assert(gc_need_run(collector));
+
+    gc_collect(collector, stack, 0, NULL, -1);
+    assert(collector->stats.minor_count == 2);
+    assert(collector->stats.run_count == 0);
+    assert(collector->remembered_top == 0);
+    assert(gc_get_hp(collector) == 5);
+    assert(collector->old_top == 5);
+
+    struct1 = gc_get_ref_ref(collector, stack[0].addr);
+    assert(gc_get_struct_size(collector, struct1) == 1);
+    assert(gc_get_atom_idx(collector, gc_get_struct_ref(collector, struct1, 0)) == 12);
+
+    /* backtracking below old generation shrinks it */
+    gc_reset_hp(collector, 2);
+    assert(collector->old_top == 2);
+
+    gc_delete(collector);
+}
+
+void test_fourteen()
+{
+    gc * collector = gc_new(64);
+    gc_stack stack[3] = { 0 };
+    gc_stack trail[1] = { 0 };
+
+    gc_alloc_anon(collector);
+    heap_ptr var1 = gc_alloc_var(collector);
+    gc_alloc_anon(collector);
+
+    /* choice point saves heap top, var1 is bound after it */
+    stack[0].type = STACK_TYPE_HEAP_PTR;
+    stack[0].addr = var1;
+    stack[1].type = STACK_TYPE_HEAP_SIZE;
+    stack[1].addr = gc_get_hp(collector);
+
+    gc_alloc_anon(collector);
+    heap_ptr atom1 = gc_alloc_atom(collector, 12);
+    gc_set_ref_ref(collector, var1, atom1);
+    trail[0].type = STACK_TYPE_HEAP_PTR;
+    trail[0].addr = var1;
+    stack[2].type = STACK_TYPE_HEAP_PTR;
+    stack[2].addr = atom1;
+
+    gc_run(collector, stack, 2, trail, 0);
+    assert(gc_get_hp(collector) == 3);
+    assert(stack[0].addr == 1);
+    assert(trail[0].addr == 1);
+    assert(stack[2].addr == 2);
+
+    /* mark moved between cells created before and after choice point */
+    assert(stack[1].addr == 2);
+    gc_reset_hp(collector, stack[1].addr);
+    gc_reset_ref(collector, trail[0].addr);
+    assert(gc_get_hp(collector) == 2);
+    assert(gc_get_var_ref(collector, stack[0].addr) == stack[0].addr);
+
+    gc_delete(collector);
+}
+
 int main(int argc, char * argv[])
 {
     test_one();
@@ -227,6 +438,12 @@ int main(int argc, char * argv[])
     test_six();
     test_seven();
     test_eight();
+    test_nine();
+    test_ten();
+    test_eleven();
+    test_twelve();
+    test_thirteen();
+    test_fourteen();
 
     return 0;
 }
@@ -0,0 +1,181 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "libplg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static const char * source =
+    "parent(X, Y) <= X = a, Y = b\n"
+    "parent(X, Y) <= X = b, Y = c\n"
+    "grandparent(X, Y) <= parent(X, Z), parent(Z, Y)\n"
+    "<= parent(X, Y)\n";
+
+/* list of ints 1..size */
+static void assert_int_list(const plg_value * value, int first, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+    {
+        assert(value->type == PLG_VALUE_STRUCT);
+        assert(strcmp(value->name, "[|]") == 0 && value->arity == 2);
+        assert(value->args[0].type == PLG_VALUE_INT);
+        assert(value->args[0].int_value == first + i);
+        value = &value->args[1];
+    }
+    assert(value->type == PLG_VALUE_ATOM && strcmp(value->name, "[]") == 0);
+}
+
+/* goal with several solutions, query stays at PLG_NO when called again */
+void test_one()
+{
+    plg_program * program = plg_load_string(source);
+    plg_query * query = plg_query_open(program, "append(X, Y, [1, 2])");
+    const plg_solution * solution = NULL;
+    int i;
+
+    assert(query != NULL);
+    for (i = 0; i < 3; i++)
+    {
+        assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+        assert(solution->size == 2);
+        assert(strcmp(solution->names[0], "X") == 0);
+        assert(strcmp(solution->names[1], "Y") == 0);
+        assert_int_list(&solution->values[0], 1, i);
+        assert_int_list(&solution->values[1], 1 + i, 2 - i);
+    }
+    assert(plg_next_solution(query, &solution) == PLG_NO);
+    assert(solution == NULL);
+    assert(plg_next_solution(query, &solution) == PLG_NO);
+    assert(plg_next_solution(query, NULL) == PLG_NO);
+
+    plg_query_close(query);
+    plg_program_delete(program);
+}
+
+/* NULL goal runs query of program */
+void test_two()
+{
+    plg_program * program = plg_load_string(source);
+    plg_query * query = plg_query_open(program, NULL);
+    const plg_solution * solution = NULL;
+
+    assert(query != NULL);
+    assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+    assert(solution->size == 2);
+    assert(strcmp(solution->names[0], "X") == 0);
+    assert(strcmp(solution->values[0].name, "a") == 0);
+    assert(strcmp(solution->values[1].name, "b") == 0);
+    assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+    assert(strcmp(solution->values[0].name, "b") == 0);
+    assert(strcmp(solution->values[1].name, "c") == 0);
+    assert(plg_next_solution(query, &solution) == PLG_NO);
+
+    plg_query_close(query);
+    plg_program_delete(program);
+}
+
+/* goals calling undefined predicates or not parsed are not opened */
+void test_three()
+{
+    plg_program * program = plg_load_string(source);
+
+    assert(plg_query_open(program, "unknown(X)") == NULL);
+    assert(plg_query_open(program, "parent(X, Y, Z)") == NULL);
+    assert(plg_query_open(program, "parent(X") == NULL);
+
+    plg_program_delete(program);
+}
+
+/* once/1 keeps first solution of its goal, goals after it still backtrack */
+void test_four()
+{
+    plg_program * program = plg_load_string(source);
+    plg_query * query = plg_query_open(program, "once(parent(X, Y)), member(Z, [p, q])");
+    const plg_solution * solution = NULL;
+
+    assert(query != NULL);
+    assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+    assert(solution->size == 3);
+    assert(strcmp(solution->values[0].name, "a") == 0);
+    assert(strcmp(solution->values[2].name, "p") == 0);
+    assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+    assert(strcmp(solution->values[0].name, "a") == 0);
+    assert(strcmp(solution->values[2].name, "q") == 0);
+    assert(plg_next_solution(query, &solution) == PLG_NO);
+
+    plg_query_close(query);
+    plg_program_delete(program);
+}
+
+/* atoms not in program, struct of program predicate, program is not changed by queries */
+void test_five()
+{
+    plg_program * program = plg_load_string(source);
+    const plg_solution * solution = NULL;
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        plg_query * query = plg_query_open(program, "grandparent(X, Y), Z = parent(X, fresh)");
+
+        assert(query != NULL);
+        assert(plg_next_solution(query, &solution) == PLG_SOLUTION);
+        assert(strcmp(solution->values[0].name, "a") == 0);
+        assert(strcmp(solution->values[1].name, "c") == 0);
+        assert(solution->values[2].type == PLG_VALUE_STRUCT);
+        assert(strcmp(solution->values[2].name, "parent") == 0);
+        assert(solution->values[2].arity == 2);
+        assert(strcmp(solution->values[2].args[1].name, "fresh") == 0);
+        assert(plg_next_solution(query, &solution) == PLG_NO);
+        plg_query_close(query);
+    }
+
+    plg_program_delete(program);
+}
+
+/* runtime errors end query */
+void test_six()
+{
+    plg_program * program = plg_load_string(source);
+    plg_query * query = plg_query_open(program, "X = 1, Y = 0, Z is X / Y");
+
+    assert(query != NULL);
+    assert(plg_next_solution(query, NULL) == PLG_ERROR);
+
+    plg_query_close(query);
+    plg_program_delete(program);
+}
+
+int main(int argc, char * argv[])
+{
+    test_one();
+    test_two();
+    test_three();
+    test_four();
+    test_five();
+    test_six();
+
+    return 0;
+}
@@ -23,9 +23,33 @@
 #include "builtin.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
 
-vm_execute_str vm_execute_op[] = {
+/* follow references until unbound variable or value */
+static inline heap_ptr vm_deref(gc * collector, heap_ptr ref)
+{
+    gc_heap cell = GC_CELL(collector, ref);
+    while (GC_CELL_TAG(cell) == GC_TAG_REF && GC_CELL_VALUE(cell) != ref)
+    {
+        ref = (heap_ptr)GC_CELL_VALUE(cell);
+        cell = GC_CELL(collector, ref);
+    }
+    return ref;
+}
+
+/**
+ * Handlers are inlined into labels of threaded dispatch, out of line copies
+ * are called through vm_execute_op by the other dispatch loops.
+ */
+#if defined(__GNUC__)
+#define VM_HANDLER inline __attribute__((always_inline))
+#else
+#define VM_HANDLER
+#endif
+
+const vm_execute_str vm_execute_op[] = {
     { BYTECODE_UNKNOWN, vm_execute_unknown },
     { BYTECODE_POP, vm_execute_pop },
     { BYTECODE_PUT_REF, vm_execute_put_ref },
@@ -69,9 +93,27 @@ vm_execute_str vm_execute_op[] = {
     { BYTECODE_INT_SUB, vm_execute_int_sub },
     { BYTECODE_INT_MUL, vm_execute_int_mul },
     { BYTECODE_INT_DIV, vm_execute_int_div },
+    { BYTECODE_INT_PUSH, vm_execute_int_push },
+    { BYTECODE_INT_PUSH_REF, vm_execute_int_push_ref },
+    { BYTECODE_INT_UNBOX, vm_execute_int_unbox },
+    { BYTECODE_INT_BOX, vm_execute_int_box },
+    { BYTECODE_INT_SHL, vm_execute_int_shl },
+    { BYTECODE_INT_SHR, vm_execute_int_shr },
     { BYTECODE_BUILTIN, vm_execute_builtin },
+    { BYTECODE_CALL_BUILTIN, vm_execute_call_builtin },
     { BYTECODE_LT, vm_execute_lt },
-    { BYTECODE_GT, vm_execute_gt }
+    { BYTECODE_GT, vm_execute_gt },
+    { BYTECODE_SWITCH_ON_TERM, vm_execute_switch_on_term },
+    { BYTECODE_SWITCH_ON_CONST, vm_execute_switch_on_const },
+    { BYTECODE_SWITCH_ON_STRUCT, vm_execute_switch_on_struct },
+    { BYTECODE_CASE_CONST, vm_execute_case_const },
+    { BYTECODE_CASE_STRUCT, vm_execute_case_struct },
+    { BYTECODE_CASE_STRUCT_ADDR, vm_execute_case_struct_addr },
+    { BYTECODE_PUT_REF_REF, vm_execute_put_ref_ref },
+    { BYTECODE_PUT_REF_INT, vm_execute_put_ref_int },
+    { BYTECODE_PUT_REF_U_ATOM, vm_execute_put_ref_u_atom },
+    { BYTECODE_PUT_REF_U_STRUCT_ADDR, vm_execute_put_ref_u_struct_addr },
+    { BYTECODE_SON_U_VAR, vm_execute_son_u_var }
 };
 
 vm * vm_new(
@@ -92,11 +134,35 @@ vm * vm_new(
     machine->stack_size = stack_size;
     machine->trail_size = trail_size;
     machine->binary_value_ref = NULL;
+    machine->segment_ref = NULL;
+    machine->segment_addr = (pc_ptr)-1;
+    machine->stack_reserve = 0;
+    machine->int_stack = NULL;
+    machine->int_sp = 0;
     machine->state = VM_STOP;
+    machine->dispatch = VM_DISPATCH_THREADED;
+    machine->occurs_check = VM_OCCURS_CHECK_ON;
+    machine->max_solutions = 0;
+    machine->pause_on_answer = 0;
+    machine->answer_size = 0;
+    machine->stats.instr_count = 0;
+    machine->stats.call_count = 0;
+    machine->stats.max_stack = 0;
+    machine->stats.max_trail = 0;
+    machine->stats.exec_time = 0.0;
+    machine->stats.solutions = 0;
+    machine->profiler = NULL;
+    machine->ngrams = NULL;
+    machine->out = writer_new(stdout, WRITER_FORMAT_OBJECT);
 
     machine->collector = gc_new(heap_size);
     machine->stack = gc_stack_new(stack_size);
     machine->trail = gc_stack_new(trail_size);
+    machine->work_size = 64;
+    machine->work_top = 0;
+    machine->work = (heap_ptr *)malloc(sizeof(heap_ptr) * machine->work_size);
+
+    vm_set_max_size(machine, VM_MAX_HEAP_SIZE, VM_MAX_STACK_SIZE, VM_MAX_TRAIL_SIZE);
 
     vm_execute_test();
 
@@ -117,9 +183,29 @@ void vm_delete(vm * machine)
     {
         gc_stack_delete(machine->trail);
     }
+    if (machine->work != NULL)
+    {
+        free(machine->work);
+    }
+    if (machine->int_stack != NULL)
+    {
+        free(machine->int_stack);
+    }
+    if (machine->out != NULL)
+    {
+        writer_delete(machine->out);
+    }
     free(machine);
 }
 
+void vm_set_max_size(vm * machine, heap_size_t max_heap_size,
+                     stack_size_t max_stack_size, stack_size_t max_trail_size)
+{
+    gc_set_max_size(machine->collector, max_heap_size);
+    machine->max_stack_size = max_stack_size > machine->stack_size ? max_stack_size : machine->stack_size;
+    machine->max_trail_size = max_trail_size > machine->trail_size ? max_trail_size : machine->trail_size;
+}
+
 void vm_execute_test()
 {
     unsigned int i = 0;
@@ -138,31 +224,49 @@ void vm_execute_print(vm * machine)
     printf("frame pointer     fp: %d\n", machine->fp);
     printf("backtrack pointer bp: %d\n", machine->bp);
     printf("trail pointer     tp: %d\n", machine->tp);
-    printf("heap_size           : %u\n", machine->heap_size);
+    printf("heap_size           : %u\n", machine->collector->size);
     printf("stack size          : %d\n", machine->stack_size);
     printf("trail size          : %d\n", machine->trail_size);
     printf("state               : %s\n", vm_state_to_str(machine->state));
 }
 
-void vm_execute_unknown(vm * machine, bytecode * code)
+void vm_print_stats(vm * machine)
+{
+    fprintf(stderr, "dispatch            : %s\n", vm_dispatch_to_str(machine->dispatch));
+    fprintf(stderr, "occurs check        : %s\n", vm_occurs_check_to_str(machine->occurs_check));
+    fprintf(stderr, "instructions        : %lu\n", machine->stats.instr_count);
+    fprintf(stderr, "time                : %.6f s\n", machine->stats.exec_time);
+    fprintf(stderr, "heap size           : %u (max %u)\n", machine->collector->size, machine->collector->max_size);
+    fprintf(stderr, "stack size          : %d (max %d)\n", machine->stack_size, machine->max_stack_size);
+    fprintf(stderr, "trail size          : %d (max %d)\n", machine->trail_size, machine->max_trail_size);
+    fprintf(stderr, "peak stack          : %d\n", machine->stats.max_stack);
+    fprintf(stderr, "peak trail          : %d\n", machine->stats.max_trail);
+    fprintf(stderr, "inferences          : %lu\n", machine->stats.call_count);
+    fprintf(stderr, "solutions           : %lu\n", machine->stats.solutions);
+    if (machine->stats.exec_time > 0.0)
+    {
+        fprintf(stderr, "instructions/second : %.0f\n",
+                machine->stats.instr_count / machine->stats.exec_time);
+        fprintf(stderr, "LIPS                : %.0f\n",
+                machine->stats.call_count / machine->stats.exec_time);
+    }
+    gc_print_stats(machine->collector);
+}
+
+VM_HANDLER void vm_execute_unknown(vm * machine, bytecode * code)
 {
     assert(0);
 }
 
-void vm_execute_pop(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_pop(vm * machine, bytecode * code)
 {
     machine->sp--;
 }
 
-void vm_execute_put_ref(vm * machine, bytecode * code)
+static inline void vm_put_ref(vm * machine, unsigned int index)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
-    {
-        return;
-    }
-
-    assert(machine->stack[machine->fp + code->put_ref.index].type == STACK_TYPE_HEAP_PTR);
-    heap_ptr ref_d = vm_execute_deref(machine, machine->stack[machine->fp + code->put_ref.index].addr);
+    assert(machine->stack[machine->fp + index].type == STACK_TYPE_HEAP_PTR);
+    heap_ptr ref_d = vm_deref(machine->collector, machine->stack[machine->fp + index].addr);
 
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
@@ -172,13 +276,13 @@ void vm_execute_put_ref(vm * machine, bytecode * code)
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_put_var(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_put_ref(vm * machine, bytecode * code)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
-    {
-        return;
-    }
+    vm_put_ref(machine, code->put_ref.index);
+}
 
+static inline void vm_put_var(vm * machine, unsigned int index)
+{
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
     entry.addr = gc_alloc_var(machine->collector);
@@ -189,41 +293,59 @@ void vm_execute_put_var(vm * machine, bytecode * code)
     }
 
     machine->sp++;
-    machine->stack[machine->fp + code->put_var.index] = entry;
+    machine->stack[machine->fp + index] = entry;
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_u_ref(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_put_var(vm * machine, bytecode * code)
+{
+    vm_put_var(machine, code->put_var.index);
+}
+
+static inline void vm_u_ref(vm * machine, unsigned int index)
 {
     vm_execute_unify(machine,
                      machine->stack[machine->sp].addr,
-                     vm_execute_deref(machine, machine->stack[machine->fp + code->u_ref.index].addr));
+                     vm_deref(machine->collector, machine->stack[machine->fp + index].addr));
     machine->sp--;
 }
 
-void vm_execute_u_var(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_u_ref(vm * machine, bytecode * code)
+{
+    vm_u_ref(machine, code->u_ref.index);
+}
+
+static inline void vm_u_var(vm * machine, unsigned int index)
 {
-    machine->stack[machine->fp + code->u_var.index] = machine->stack[machine->sp];
+    machine->stack[machine->fp + index] = machine->stack[machine->sp];
     machine->sp--;
 }
 
-void vm_execute_check(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_u_var(vm * machine, bytecode * code)
 {
-    if (!vm_execute_check_low(machine,
-                              machine->stack[machine->sp].addr,
-                              vm_execute_deref(machine, machine->stack[machine->fp + code->check.index].addr)))
-    {
-        vm_execute_backtrack(machine);
-    }
+    vm_u_var(machine, code->u_var.index);
 }
 
-void vm_execute_put_anon(vm * machine, bytecode * code)
+static inline void vm_check(vm * machine, unsigned int index)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
+    if (!vm_execute_occurs_check(machine,
+                                 machine->stack[machine->sp].addr,
+                                 vm_deref(machine->collector, machine->stack[machine->fp + index].addr)))
     {
-        return;
+        if (machine->state == VM_RUNNING)
+        {
+            vm_execute_backtrack(machine);
+        }
     }
+}
 
+VM_HANDLER void vm_execute_check(vm * machine, bytecode * code)
+{
+    vm_check(machine, code->check.index);
+}
+
+VM_HANDLER void vm_execute_put_anon(vm * machine, bytecode * code)
+{
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
     entry.addr = gc_alloc_anon(machine->collector);
@@ -237,16 +359,11 @@ void vm_execute_put_anon(vm * machine, bytecode * code)
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_put_atom(vm * machine, bytecode * code)
+static inline void vm_put_atom(vm * machine, atom_idx_t idx)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
-    {
-        return;
-    }
-
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_atom(machine->collector, code->put_atom.idx);
+    entry.addr = gc_alloc_atom(machine->collector, idx);
     if (entry.addr == 0)
     {
         machine->state = VM_ERROR_OUT_OF_MEMORY;
@@ -257,16 +374,16 @@ void vm_execute_put_atom(vm * machine, bytecode * code)
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_put_int(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_put_atom(vm * machine, bytecode * code)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
-    {
-        return;
-    }
+    vm_put_atom(machine, code->put_atom.idx);
+}
 
+static inline void vm_put_int(vm * machine, int value)
+{
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, code->put_int.value);
+    entry.addr = gc_alloc_int(machine->collector, value);
     if (entry.addr == 0)
     {
         machine->state = VM_ERROR_OUT_OF_MEMORY;
@@ -277,20 +394,25 @@ void vm_execute_put_int(vm * machine, bytecode * code)
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_put_struct(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_put_int(vm * machine, bytecode * code)
+{
+    vm_put_int(machine, code->put_int.value);
+}
+
+VM_HANDLER void vm_execute_put_struct(vm * machine, bytecode * code)
 {
     bytecode_print(code);
     fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
 }
 
-void vm_execute_put_struct_addr(vm * machine, bytecode * code)
+static inline void vm_put_struct(vm * machine, unsigned int n, pc_ptr addr)
 {
     unsigned int i = 0;
-    machine->sp = machine->sp - code->put_struct.n + 1;
+    machine->sp = machine->sp - n + 1;
 
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_struct(machine->collector, code->put_struct.n, code->put_struct.addr);
+    entry.addr = gc_alloc_struct(machine->collector, n, addr);
 
     if (entry.addr == 0)
     {
@@ -298,14 +420,19 @@ void vm_execute_put_struct_addr(vm * machine, bytecode * code)
         return;
     }
 
-    for (i = 0; i < code->put_struct.n; i++)
+    for (i = 0; i < n; i++)
     {
         gc_set_struct_ref(machine->collector, entry.addr, i, machine->stack[machine->sp + i].addr);
     }
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_u_atom(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_put_struct_addr(vm * machine, bytecode * code)
+{
+    vm_put_struct(machine, code->put_struct.n, code->put_struct.addr);
+}
+
+static inline void vm_u_atom(vm * machine, atom_idx_t idx)
 {
     heap_ptr h_ref = machine->stack[machine->sp].addr;
     machine->sp--;
@@ -316,7 +443,7 @@ void vm_execute_u_atom(vm * machine, bytecode * code)
             assert(0);
         break;
         case OBJECT_ATOM:
-            if (gc_get_atom_idx(machine->collector, h_ref) != code->u_atom.idx)
+            if (gc_get_atom_idx(machine->collector, h_ref) != idx)
             {
                 vm_execute_backtrack(machine);
             }
@@ -327,7 +454,7 @@ void vm_execute_u_atom(vm * machine, bytecode * code)
         case OBJECT_REF:
         {
             /* NOTE: second version, Fig. 4.17 p. 121 */
-            heap_ptr a_value = gc_alloc_atom(machine->collector, code->u_atom.idx);
+            heap_ptr a_value = gc_alloc_atom(machine->collector, idx);
             if (a_value == 0)
             {
                 machine->state = VM_ERROR_OUT_OF_MEMORY;
@@ -344,7 +471,12 @@ void vm_execute_u_atom(vm * machine, bytecode * code)
     }
 }
 
-void vm_execute_u_int(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_u_atom(vm * machine, bytecode * code)
+{
+    vm_u_atom(machine, code->u_atom.idx);
+}
+
+static inline void vm_u_int(vm * machine, int value)
 {
     heap_ptr h_ref = machine->stack[machine->sp].addr;
     machine->sp--;
@@ -358,14 +490,14 @@ void vm_execute_u_int(vm * machine, bytecode * code)
             vm_execute_backtrack(machine);
         break;
         case OBJECT_INT:
-            if (gc_get_int_value(machine->collector, h_ref) != code->u_int.value)
+            if (gc_get_int_value(machine->collector, h_ref) != value)
             {
                 vm_execute_backtrack(machine);
             }
         break;
         case OBJECT_REF:
         {
-            heap_ptr a_value = gc_alloc_int(machine->collector, code->u_int.value);
+            heap_ptr a_value = gc_alloc_int(machine->collector, value);
             if (a_value == 0)
             {
                 machine->state = VM_ERROR_OUT_OF_MEMORY;
@@ -382,13 +514,18 @@ void vm_execute_u_int(vm * machine, bytecode * code)
     }
 }
 
-void vm_execute_u_struct(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_u_int(vm * machine, bytecode * code)
+{
+    vm_u_int(machine, code->u_int.value);
+}
+
+VM_HANDLER void vm_execute_u_struct(vm * machine, bytecode * code)
 {
     bytecode_print(code);
     fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
 }
 
-void vm_execute_u_struct_addr(vm * machine, bytecode * code)
+static inline void vm_u_struct(vm * machine, pc_offset offset, unsigned int n, pc_ptr addr)
 {
     /* NOTE: third version, Fig. 4.21 p.124 */
     switch(gc_get_object_type(machine->collector, machine->stack[machine->sp].addr))
@@ -405,13 +542,13 @@ void vm_execute_u_struct_addr(vm * machine, bytecode * code)
         break;
         case OBJECT_REF:
         {
-            machine->pc = code->u_struct.offset;
+            machine->pc = offset;
         }
         break;
         case OBJECT_STRUCT:
         {
-            if (!(gc_get_struct_addr(machine->collector, machine->stack[machine->sp].addr) == code->u_struct.addr &&
-                  gc_get_struct_size(machine->collector, machine->stack[machine->sp].addr) == code->u_struct.n))
+            if (!(gc_get_struct_addr(machine->collector, machine->stack[machine->sp].addr) == addr &&
+                  gc_get_struct_size(machine->collector, machine->stack[machine->sp].addr) == n))
             {
                 vm_execute_backtrack(machine);
             }
@@ -420,13 +557,23 @@ void vm_execute_u_struct_addr(vm * machine, bytecode * code)
     }
 }
 
-void vm_execute_up(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_u_struct_addr(vm * machine, bytecode * code)
+{
+    vm_u_struct(machine, code->u_struct.offset, code->u_struct.n, code->u_struct.addr);
+}
+
+static inline void vm_up(vm * machine, pc_ptr offset)
 {
     machine->sp--;
-    machine->pc = code->up.offset;
+    machine->pc = offset;
 }
 
-void vm_execute_bind(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_up(vm * machine, bytecode * code)
+{
+    vm_up(machine, code->up.offset);
+}
+
+VM_HANDLER void vm_execute_bind(vm * machine, bytecode * code)
 {
     /* NOTE: second version, Fig 4.13 p. 117 */
     gc_set_ref_ref(machine->collector, machine->stack[machine->sp - 1].addr, machine->stack[machine->sp].addr);
@@ -434,31 +581,26 @@ void vm_execute_bind(vm * machine, bytecode * code)
     machine->sp = machine->sp - 2;
 }
 
-void vm_execute_son(vm * machine, bytecode * code)
+static inline void vm_son(vm * machine, unsigned int number)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 1, machine->tp))
-    {
-        return;
-    }
-    
     machine->stack[machine->sp + 1].type = STACK_TYPE_HEAP_PTR;
-    machine->stack[machine->sp + 1].addr = vm_execute_deref(machine, gc_get_struct_ref(machine->collector, machine->stack[machine->sp].addr, code->son.number));
+    machine->stack[machine->sp + 1].addr = vm_deref(machine->collector, gc_get_struct_ref(machine->collector, machine->stack[machine->sp].addr, number));
     machine->sp++;
 }
 
-void vm_execute_mark(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_son(vm * machine, bytecode * code)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 6, machine->tp))
-    {
-        return;
-    }
+    vm_son(machine, code->son.number);
+}
 
+static inline void vm_mark(vm * machine, pc_ptr offset)
+{
     gc_stack b_entry = { 0 };
     gc_stack fp_entry = { 0 };
     gc_stack zero_entry = { 0 };
 
     b_entry.type = STACK_TYPE_PC_OFFSET;
-    b_entry.offset = code->mark.offset;
+    b_entry.offset = offset;
 
     fp_entry.type = STACK_TYPE_STACK_PTR;
     fp_entry.saddr= machine->fp;
@@ -473,13 +615,13 @@ void vm_execute_mark(vm * machine, bytecode * code)
     machine->sp = machine->sp + 6;
 }
 
-void vm_execute_last_mark(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_mark(vm * machine, bytecode * code)
 {
-    if (!vm_execute_check_size(machine, machine->sp + 6, machine->tp))
-    {
-        return;
-    }
+    vm_mark(machine, code->mark.offset);
+}
 
+VM_HANDLER void vm_execute_last_mark(vm * machine, bytecode * code)
+{
     if (machine->fp <= machine->bp)
     {
         gc_stack zero_entry = { 0 };
@@ -499,99 +641,164 @@ void vm_execute_last_mark(vm * machine, bytecode * code)
     }
 }
 
-void vm_execute_call(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_call(vm * machine, bytecode * code)
 {
     bytecode_print(code);
     fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
     assert(0);
 }
 
-void vm_execute_call_addr(vm * machine, bytecode * code)
+static inline void vm_call(vm * machine, unsigned int n, pc_ptr addr)
 {
-    machine->fp = machine->sp - code->call.n;
-    machine->pc = code->call.addr;
+    machine->fp = machine->sp - n;
+    machine->pc = addr;
+    machine->stats.call_count++;
 
-    gc_run(machine->collector,
-           machine->stack, machine->sp, machine->trail, machine->tp);
+    if (machine->profiler != NULL)
+    {
+        profile_call(machine->profiler, addr, machine->fp);
+    }
+
+    if (gc_need_run(machine->collector))
+    {
+        gc_collect(machine->collector,
+                   machine->stack, machine->sp, machine->trail, machine->tp);
+    }
+}
+
+VM_HANDLER void vm_execute_call_addr(vm * machine, bytecode * code)
+{
+    vm_call(machine, code->call.n, code->call.addr);
 }
 
-void vm_execute_last_call(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_last_call(vm * machine, bytecode * code)
 {
     bytecode_print(code);
     fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
     assert(0);
 }
 
-void vm_execute_last_call_addr(vm * machine, bytecode * code)
+static inline void vm_last_call(vm * machine, unsigned int size, unsigned int n, pc_ptr addr)
 {
+    machine->stats.call_count++;
+
     if (machine->fp <= machine->bp)
     {
         // call q/h
-        machine->fp = machine->sp - code->last_call.n;
-        machine->pc = code->last_call.addr;
+        machine->fp = machine->sp - n;
+        machine->pc = addr;
     }
     else
     {
         // slide size (down) h (variables)
-        if (code->last_call.size > 0)
+        if (size > 0)
         {
-            if (code->last_call.n == 0)
+            if (n == 0)
             {
-                machine->sp = machine->sp - code->last_call.size;
+                machine->sp = machine->sp - size;
             }
             else
             {
                 unsigned int i;
-                machine->sp = machine->sp - code->last_call.size - code->last_call.n;
+                machine->sp = machine->sp - size - n;
                 assert(machine->sp == machine->fp);
 
-                for (i = 0; i < code->last_call.n; i++)
+                for (i = 0; i < n; i++)
                 {
                     machine->sp++;
                     machine->stack[machine->sp] =
-                        machine->stack[machine->sp + code->last_call.size];
+                        machine->stack[machine->sp + size];
                 }
             }
         }
         // jump q/h
-        machine->pc = code->last_call.addr;
+        machine->pc = addr;
+    }
+
+    if (machine->profiler != NULL)
+    {
+        profile_call(machine->profiler, addr, machine->fp);
     }
 
-    gc_run(machine->collector,
-           machine->stack, machine->sp, machine->trail, machine->tp);
+    if (gc_need_run(machine->collector))
+    {
+        gc_collect(machine->collector,
+                   machine->stack, machine->sp, machine->trail, machine->tp);
+    }
+}
+
+VM_HANDLER void vm_execute_last_call_addr(vm * machine, bytecode * code)
+{
+    vm_last_call(machine, code->last_call.size, code->last_call.n, code->last_call.addr);
 }
 
-void vm_execute_push_env(vm * machine, bytecode * code)
+/**
+ * Only place where stack is checked when executing a clause. Frame and
+ * entries pushed until next call or return take at most stack_reserve.
+ */
+static inline void vm_push_env(vm * machine, unsigned int size)
 {
-    if (!vm_execute_check_size(machine, machine->fp + code->push_env.size, machine->tp))
+    stack_ptr top = machine->fp + size;
+
+    if (top + 1 > machine->stats.max_stack)
+    {
+        machine->stats.max_stack = top + 1;
+    }
+    if (top + machine->stack_reserve >= machine->stack_size &&
+        !vm_execute_check_size(machine, top + machine->stack_reserve, machine->tp))
     {
         return;
     }
 
     gc_stack zero_entry = { 0 };
-    for (stack_ptr sp = machine->sp + 1; sp <= machine->fp + (stack_ptr)code->push_env.size; sp++)
+    for (stack_ptr sp = machine->sp + 1; sp <= machine->fp + (stack_ptr)size; sp++)
     {
         machine->stack[sp] = zero_entry;
     }
 
-    machine->sp = machine->fp + code->push_env.size;
+    machine->sp = machine->fp + size;
+}
+
+VM_HANDLER void vm_execute_push_env(vm * machine, bytecode * code)
+{
+    vm_push_env(machine, code->push_env.size);
 }
 
-void vm_execute_pop_env(vm * machine, bytecode * code)
+static inline void vm_pop_env(vm * machine)
 {
     if (machine->bp < machine->fp)
     {
         machine->sp = machine->fp - 6;
     }
+    else if (machine->sp + machine->stack_reserve >= machine->stack_size &&
+             !vm_execute_check_size(machine, machine->sp + machine->stack_reserve, machine->tp))
+    {
+        /* frame kept for backtracking, caller pushes above it */
+        return;
+    }
 
     assert(machine->stack[machine->fp].type == STACK_TYPE_PC_OFFSET);
     machine->pc = machine->stack[machine->fp].offset;
+    if (machine->pc >= machine->segment_addr)
+    {
+        machine->state = VM_SEGMENT;
+    }
 
     assert(machine->stack[machine->fp - 1].type == STACK_TYPE_STACK_PTR);
     machine->fp = machine->stack[machine->fp - 1].saddr;
+
+    if (machine->profiler != NULL)
+    {
+        profile_exit(machine->profiler, machine->fp);
+    }
+}
+
+VM_HANDLER void vm_execute_pop_env(vm * machine, bytecode * code)
+{
+    vm_pop_env(machine);
 }
 
-void vm_execute_set_btp(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_set_btp(vm * machine, bytecode * code)
 {
     gc_stack hp_entry = { 0 };
     hp_entry.type = STACK_TYPE_HEAP_SIZE;
@@ -612,29 +819,34 @@ void vm_execute_set_btp(vm * machine, bytecode * code)
     machine->bp = machine->fp;
 }
 
-void vm_execute_del_btp(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_del_btp(vm * machine, bytecode * code)
 {
     assert(machine->stack[machine->fp - 4].type == STACK_TYPE_STACK_PTR);
     machine->bp = machine->stack[machine->fp - 4].saddr;
 }
 
-void vm_execute_try(vm * machine, bytecode * code)
+static inline void vm_try(vm * machine, pc_ptr offset)
 {
     gc_stack pc_entry = { 0 };
     pc_entry.type = STACK_TYPE_PC_OFFSET;
     pc_entry.offset = machine->pc;
 
     machine->stack[machine->fp - 5] = pc_entry;
-    machine->pc = code->try.offset;
+    machine->pc = offset;
 }
 
-void vm_execute_prune(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_try(vm * machine, bytecode * code)
+{
+    vm_try(machine, code->try.offset);
+}
+
+VM_HANDLER void vm_execute_prune(vm * machine, bytecode * code)
 {
     assert(machine->stack[machine->fp - 4].type == STACK_TYPE_STACK_PTR);
     machine->bp = machine->stack[machine->fp - 4].saddr;
 }
 
-void vm_execute_set_cut(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_set_cut(vm * machine, bytecode * code)
 {
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_STACK_PTR;
@@ -643,13 +855,18 @@ void vm_execute_set_cut(vm * machine, bytecode * code)
     machine->stack[machine->fp - 4] = entry;
 }
 
-void vm_execute_fail(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_fail(vm * machine, bytecode * code)
 {
     vm_execute_backtrack(machine);
 }
 
-void vm_execute_init(vm * machine, bytecode * code)
+static inline void vm_init(vm * machine, pc_ptr init_offset)
 {
+    if (!vm_execute_check_size(machine, 5, machine->tp))
+    {
+        return;
+    }
+
     machine->sp = machine->fp = machine->bp = 5;
 
     gc_stack zero_entry = { 0 };
@@ -670,7 +887,7 @@ void vm_execute_init(vm * machine, bytecode * code)
 
     gc_stack offset = { 0 };
     offset.type = STACK_TYPE_PC_OFFSET;
-    offset.offset = code->init.offset;
+    offset.offset = init_offset;
 
     machine->stack[5] = zero_entry;
     machine->stack[4] = zero_heap;
@@ -680,29 +897,31 @@ void vm_execute_init(vm * machine, bytecode * code)
     machine->stack[0] = offset;
 }
 
-void vm_execute_halt(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_init(vm * machine, bytecode * code)
 {
-    unsigned int strtab_size = 0;
-    char ** strtab_array = NULL;
+    vm_init(machine, code->init.offset);
+}
 
-    if (machine->binary_value_ref)
+static inline void vm_halt(vm * machine, unsigned int size)
+{
+    machine->stats.solutions++;
+    if (machine->pause_on_answer)
     {
-        strtab_size = machine->binary_value_ref->strtab_size;
-        strtab_array = machine->binary_value_ref->strtab_array;
+        /* answer is read by caller, vm_execute_next backtracks into next one */
+        machine->answer_size = size;
+        machine->state = VM_ANSWER;
+        return;
     }
 
     // print result
-    unsigned int i = 0; 
-    for (i = 0; i < code->halt.size; i++)
+    writer_answer(machine->out, machine->collector, machine->stack + machine->fp + 1, size);
+
+    /* choice points left are dropped without search once enough answers are found */
+    if (machine->max_solutions > 0 && machine->stats.solutions >= machine->max_solutions)
     {
-        heap_ptr addr = machine->stack[machine->fp + 1 + i].addr;
-        gc_print_ref_str(machine->collector,
-                         vm_execute_deref(machine, addr),
-                         strtab_array, strtab_size);
+        machine->state = VM_STOP;
+        return;
     }
-    printf("-----------------\n");
-
-    /* TODO: backtrack on user's wish */
     vm_execute_backtrack(machine);
 
     // run garbage collector
@@ -711,481 +930,481 @@ void vm_execute_halt(vm * machine, bytecode * code)
     //       machine->stack, machine->sp, machine->trail, machine->tp);
 }
 
-void vm_execute_no(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_halt(vm * machine, bytecode * code)
+{
+    vm_halt(machine, code->halt.size);
+}
+
+VM_HANDLER void vm_execute_no(vm * machine, bytecode * code)
 {
     //vm_execute_print(machine);
-    printf("no\n");
+    if (!machine->pause_on_answer)
+    {
+        writer_str(machine->out, "no\n");
+    }
     machine->state = VM_STOP;
 }
 
-void vm_execute_jump(vm * machine, bytecode * code)
+static inline void vm_jump(vm * machine, pc_offset offset)
+{
+    machine->pc = machine->pc + offset;
+}
+
+VM_HANDLER void vm_execute_jump(vm * machine, bytecode * code)
 {
-    machine->pc = machine->pc + code->jump.offset;
+    vm_jump(machine, code->jump.offset);
 }
 
-void vm_execute_label(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_label(vm * machine, bytecode * code)
 {
     /* do nothing machine->pc will be incremented on the next bytecode */
 }
 
-void vm_execute_int_neg(vm * machine, bytecode * code)
+/**
+ * Arithmetic works on unboxed integers of int stack. Operands are pushed by
+ * INT_PUSH, INT_PUSH_REF and INT_UNBOX, only INT_BOX allocates on heap.
+ */
+static inline char vm_int_value(vm * machine, heap_ptr ref, int * value)
 {
-    heap_ptr a_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    gc_heap cell = GC_CELL(machine->collector, vm_deref(machine->collector, ref));
+    if (GC_CELL_TAG(cell) != GC_TAG_INT)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        machine->state = VM_ERROR;
+        return 0;
     }
-    
-    gc_stack entry = { 0 };
-    entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, -gc_get_int_value(machine->collector, a_ref));
+    *value = GC_CELL_INT(cell);
+    return 1;
+}
 
-    machine->stack[machine->sp] = entry;
+VM_HANDLER void vm_execute_int_neg(vm * machine, bytecode * code)
+{
+    machine->int_stack[machine->int_sp] = -machine->int_stack[machine->int_sp];
+}
+
+VM_HANDLER void vm_execute_int_add(vm * machine, bytecode * code)
+{
+    machine->int_sp--;
+    machine->int_stack[machine->int_sp] += machine->int_stack[machine->int_sp + 1];
+}
+
+VM_HANDLER void vm_execute_int_sub(vm * machine, bytecode * code)
+{
+    machine->int_sp--;
+    machine->int_stack[machine->int_sp] -= machine->int_stack[machine->int_sp + 1];
+}
+
+VM_HANDLER void vm_execute_int_mul(vm * machine, bytecode * code)
+{
+    machine->int_sp--;
+    machine->int_stack[machine->int_sp] *= machine->int_stack[machine->int_sp + 1];
 }
 
-void vm_execute_int_add(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_int_div(vm * machine, bytecode * code)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    if (machine->int_stack[machine->int_sp] == 0)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        machine->state = VM_ERROR_DIV_BY_ZERO;
+        return;
     }
 
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
+    machine->int_sp--;
+    machine->int_stack[machine->int_sp] /= machine->int_stack[machine->int_sp + 1];
+}
+
+static inline void vm_int_shl(vm * machine, unsigned int bits)
+{
+    machine->int_stack[machine->int_sp] = (int)((unsigned int)machine->int_stack[machine->int_sp] << bits);
+}
+
+VM_HANDLER void vm_execute_int_shl(vm * machine, bytecode * code)
+{
+    vm_int_shl(machine, code->int_shl.bits);
+}
+
+/* division by 2^bits, negative values are rounded toward zero as INT_DIV does */
+static inline void vm_int_shr(vm * machine, unsigned int bits)
+{
+    int value = machine->int_stack[machine->int_sp];
+    if (value < 0)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        value += (1 << bits) - 1;
+    }
+    machine->int_stack[machine->int_sp] = value >> bits;
+}
+
+VM_HANDLER void vm_execute_int_shr(vm * machine, bytecode * code)
+{
+    vm_int_shr(machine, code->int_shr.bits);
+}
+
+static inline void vm_int_push(vm * machine, int value)
+{
+    machine->int_sp++;
+    machine->int_stack[machine->int_sp] = value;
+}
+
+VM_HANDLER void vm_execute_int_push(vm * machine, bytecode * code)
+{
+    vm_int_push(machine, code->int_push.value);
+}
+
+static inline void vm_int_push_ref(vm * machine, unsigned int index)
+{
+    int value;
+    if (!vm_int_value(machine, machine->stack[machine->fp + index].addr, &value))
+    {
+        return;
+    }
+
+    machine->int_sp++;
+    machine->int_stack[machine->int_sp] = value;
+}
+
+VM_HANDLER void vm_execute_int_push_ref(vm * machine, bytecode * code)
+{
+    vm_int_push_ref(machine, code->int_push_ref.index);
+}
+
+VM_HANDLER void vm_execute_int_unbox(vm * machine, bytecode * code)
+{
+    int value;
+    if (!vm_int_value(machine, machine->stack[machine->sp].addr, &value))
+    {
+        return;
     }
 
+    machine->sp--;
+    machine->int_sp++;
+    machine->int_stack[machine->int_sp] = value;
+}
+
+VM_HANDLER void vm_execute_int_box(vm * machine, bytecode * code)
+{
     gc_stack entry = { 0 };
     entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, gc_get_int_value(machine->collector, a_ref) + gc_get_int_value(machine->collector, b_ref));
+    entry.addr = gc_alloc_int(machine->collector, machine->int_stack[machine->int_sp]);
     if (entry.addr == 0)
     {
         machine->state = VM_ERROR_OUT_OF_MEMORY;
         return;
     }
 
-    machine->sp--;
+    machine->int_sp--;
+    machine->sp++;
     machine->stack[machine->sp] = entry;
 }
 
-void vm_execute_int_sub(vm * machine, bytecode * code)
+/* deterministic builtins return to caller without a choice point */
+static inline void vm_execute_builtin_result(vm * machine, builtin_result result)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    switch (result)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
+        case BUILTIN_FAIL:
+            if (machine->state == VM_RUNNING)
+            {
+                vm_execute_backtrack(machine);
+            }
         break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
+        case BUILTIN_DET:
+            vm_pop_env(machine);
         break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
+        case BUILTIN_NONDET:
         break;
     }
+}
 
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
-    {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
-    }
+static inline void vm_builtin(vm * machine, unsigned int id, atom_idx_t nil)
+{
+    const builtin_desc * desc = builtin_get(id);
 
-    gc_stack entry = { 0 };
-    entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, gc_get_int_value(machine->collector, a_ref) - gc_get_int_value(machine->collector, b_ref));
-    if (entry.addr == 0)
+    vm_execute_builtin_result(machine, desc->execute(machine, machine->fp + 1, nil));
+}
+
+VM_HANDLER void vm_execute_builtin(vm * machine, bytecode * code)
+{
+    vm_builtin(machine, code->builtin.id, code->builtin.nil);
+}
+
+/* deterministic builtin called inline with arguments on top of stack */
+static inline void vm_call_builtin(vm * machine, unsigned int id, atom_idx_t nil, unsigned int n)
+{
+    const builtin_desc * desc = builtin_get(id);
+    builtin_result result = desc->execute(machine, machine->sp - n + 1, nil);
+
+    machine->sp -= n;
+    if (result == BUILTIN_FAIL && machine->state == VM_RUNNING)
     {
-        machine->state = VM_ERROR_OUT_OF_MEMORY;
-        return;
+        vm_execute_backtrack(machine);
     }
+}
 
-    machine->sp--;
-    machine->stack[machine->sp] = entry;
+VM_HANDLER void vm_execute_call_builtin(vm * machine, bytecode * code)
+{
+    vm_call_builtin(machine, code->builtin.id, code->builtin.nil, code->builtin.n);
 }
 
-void vm_execute_int_mul(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_lt(vm * machine, bytecode * code)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    machine->int_sp -= 2;
+    if (machine->int_stack[machine->int_sp + 1] >= machine->int_stack[machine->int_sp + 2])
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        vm_execute_backtrack(machine);
     }
+}
 
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
+VM_HANDLER void vm_execute_gt(vm * machine, bytecode * code)
+{
+    machine->int_sp -= 2;
+    if (machine->int_stack[machine->int_sp + 1] <= machine->int_stack[machine->int_sp + 2])
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        vm_execute_backtrack(machine);
     }
+}
 
-    gc_stack entry = { 0 };
-    entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, gc_get_int_value(machine->collector, a_ref) * gc_get_int_value(machine->collector, b_ref));
-    if (entry.addr == 0)
+/**
+ * Decodes one compact instruction, see bytecode_array_encode. Operands
+ * are read with one unaligned 4 byte load and masked to their width,
+ * compact code is padded so the last load stays inside it.
+ */
+static inline unsigned int vm_decode(const unsigned char * ip, bytecode * value)
+{
+    static const unsigned int mask[] = { 0, 0xff, 0xffff, 0, 0xffffffff };
+    unsigned int i;
+    const bytecode_format * format = bytecode_format_arr + ip[0];
+
+    value->type = (bytecode_type)*ip++;
+    for (i = 0; i < format->count; i++)
     {
-        machine->state = VM_ERROR_OUT_OF_MEMORY;
-        return;
+        unsigned int operand;
+        memcpy(&operand, ip, sizeof(operand));
+        operand &= mask[format->fields[i].width];
+        memcpy((char *)value + format->fields[i].offset, &operand, sizeof(operand));
+        ip += format->fields[i].width;
     }
 
-    machine->sp--;
-    machine->stack[machine->sp] = entry;
+    return format->size;
 }
 
-void vm_execute_int_div(vm * machine, bytecode * code)
+/**
+ * Operands of compact code, see bytecode_array_encode. Loads may be
+ * unaligned, values are zero extended and signed ones are cast back.
+ */
+static inline unsigned int vm_read2(const unsigned char * ip)
+{
+    unsigned short value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
+
+static inline unsigned int vm_read4(const unsigned char * ip)
+{
+    unsigned int value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+}
+
+/* sizes of compact table entries, checked against bytecode_format_arr */
+#define VM_COMPACT_CASE_CONST_SIZE 10
+#define VM_COMPACT_CASE_STRUCT_SIZE 11
+
+/**
+ * First argument indexing. Arguments of the called predicate are at fp + 1,
+ * unbound first argument takes the var_offset path which tries all clauses.
+ */
+static inline void vm_switch_on_term(vm * machine, pc_ptr var_offset, pc_ptr const_offset, pc_ptr struct_offset)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    heap_ptr ref = vm_deref(machine->collector, machine->stack[machine->fp + 1].addr);
+    switch (gc_get_object_type(machine->collector, ref))
     {
         case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
+            printf("unknow object %u\n", ref);
+            assert(0);
         break;
         case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
-    }
-
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
-    {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
+            machine->pc = var_offset;
         break;
         case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
         case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
+            machine->pc = const_offset;
         break;
         case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
+            machine->pc = struct_offset;
         break;
     }
+}
 
-    if (gc_get_int_value(machine->collector, b_ref) == 0)
-    {
-        machine->state = VM_ERROR_DIV_BY_ZERO;
-        return;
-    }
-
-    gc_stack entry = { 0 };
-    entry.type = STACK_TYPE_HEAP_PTR;
-    entry.addr = gc_alloc_int(machine->collector, gc_get_int_value(machine->collector, a_ref) / gc_get_int_value(machine->collector, b_ref));
-    if (entry.addr == 0)
-    {
-        machine->state = VM_ERROR_OUT_OF_MEMORY;
-        return;
-    }
-
-    machine->sp--;
-    machine->stack[machine->sp] = entry;
+VM_HANDLER void vm_execute_switch_on_term(vm * machine, bytecode * code)
+{
+    vm_switch_on_term(machine, code->switch_on_term.var_offset,
+                      code->switch_on_term.const_offset, code->switch_on_term.struct_offset);
 }
 
-void vm_execute_builtin(vm * machine, bytecode * code)
+/* constant first argument as SWITCH_ON_CONST key */
+static inline unsigned int vm_switch_key(vm * machine, bytecode_case_type * type)
 {
-    unsigned int strtab_size = 0;
-    char ** strtab_array = NULL;
+    heap_ptr ref = vm_deref(machine->collector, machine->stack[machine->fp + 1].addr);
 
-    if (machine->binary_value_ref)
+    if (gc_get_object_type(machine->collector, ref) == OBJECT_ATOM)
     {
-        strtab_size = machine->binary_value_ref->strtab_size;
-        strtab_array = machine->binary_value_ref->strtab_array;
+        *type = BYTECODE_CASE_ATOM;
+        return gc_get_atom_idx(machine->collector, ref);
     }
+    *type = BYTECODE_CASE_INT;
+    return (unsigned int)gc_get_int_value(machine->collector, ref);
+}
 
-    switch (code->builtin.id)
+VM_HANDLER void vm_execute_switch_on_const(vm * machine, bytecode * code)
+{
+    bytecode_case_type type;
+    unsigned int key = vm_switch_key(machine, &type);
+    unsigned int size = code->switch_on_const.size;
+    unsigned int slot = bytecode_case_hash(key, size);
+    bytecode * table = code + 1;
+
+    while (table[slot].case_const.type != BYTECODE_CASE_EMPTY)
     {
-        case BUILT_IN_UKNOWN:
-            assert(0);
-        break;
-        case BUILT_IN_WRITE:
+        if (table[slot].case_const.type == type &&
+            table[slot].case_const.idx == key)
         {
-            heap_ptr h_ref = vm_execute_deref(machine, machine->stack[machine->fp + 1].addr);
-            gc_print_ref_str(machine->collector,
-                             vm_execute_deref(machine, h_ref),
-                             strtab_array, strtab_size);
-        }
-        break;
-        case BUILT_IN_NL:
-        {
-            printf("\n");
+            machine->pc = table[slot].case_const.offset;
+            return;
         }
-        break;
+        slot = (slot + 1) & (size - 1);
     }
+
+    /* no clause for this constant, continue after the table */
+    machine->pc += size;
 }
 
-void vm_execute_lt(vm * machine, bytecode * code)
+VM_HANDLER void vm_execute_switch_on_struct(vm * machine, bytecode * code)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
-    {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
-            return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
-    }
+    unsigned int i;
+    heap_ptr ref = vm_deref(machine->collector, machine->stack[machine->fp + 1].addr);
+    pc_ptr addr = gc_get_struct_addr(machine->collector, ref);
+    heap_size_t n = gc_get_struct_size(machine->collector, ref);
+    bytecode * table = code + 1;
 
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
+    for (i = 0; i < code->switch_on_struct.size; i++)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
+        if (table[i].case_struct.addr == addr &&
+            table[i].case_struct.n == n)
+        {
+            machine->pc = table[i].case_struct.offset;
             return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        }
     }
 
-    machine->sp -= 2;
-    if (gc_get_int_value(machine->collector, a_ref) >= gc_get_int_value(machine->collector, b_ref))
-    {
-        vm_execute_backtrack(machine);
-    }
+    machine->pc += code->switch_on_struct.size;
 }
 
-void vm_execute_gt(vm * machine, bytecode * code)
+/**
+ * Compact SWITCH_ON_CONST, pc is at the table which is searched in place.
+ * Entries are CASE_CONST with type, idx and offset operands.
+ */
+static inline void vm_compact_switch_on_const(vm * machine, unsigned int size)
 {
-    heap_ptr a_ref = machine->stack[machine->sp - 1].addr;
-    switch (gc_get_object_type(machine->collector, a_ref))
+    bytecode_case_type type;
+    unsigned int key = vm_switch_key(machine, &type);
+    unsigned int slot = bytecode_case_hash(key, size);
+    const unsigned char * table = machine->binary_value_ref->compact_code + machine->pc;
+    const unsigned char * entry = table + slot * VM_COMPACT_CASE_CONST_SIZE;
+
+    while (entry[1] != BYTECODE_CASE_EMPTY)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", a_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
+        if (entry[1] == type && vm_read4(entry + 2) == key)
+        {
+            machine->pc = vm_read4(entry + 6);
             return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            a_ref = vm_execute_deref(machine, a_ref);
-            if (gc_get_object_type(machine->collector, a_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        }
+        slot = (slot + 1) & (size - 1);
+        entry = table + slot * VM_COMPACT_CASE_CONST_SIZE;
     }
 
-    heap_ptr b_ref = machine->stack[machine->sp].addr;
-    switch (gc_get_object_type(machine->collector, b_ref))
+    machine->pc += size * VM_COMPACT_CASE_CONST_SIZE;
+}
+
+/* entries are CASE_STRUCT_ADDR with offset, n and addr operands */
+static inline void vm_compact_switch_on_struct(vm * machine, unsigned int size)
+{
+    unsigned int i;
+    heap_ptr ref = vm_deref(machine->collector, machine->stack[machine->fp + 1].addr);
+    pc_ptr addr = gc_get_struct_addr(machine->collector, ref);
+    heap_size_t n = gc_get_struct_size(machine->collector, ref);
+    const unsigned char * entry = machine->binary_value_ref->compact_code + machine->pc;
+
+    for (i = 0; i < size; i++, entry += VM_COMPACT_CASE_STRUCT_SIZE)
     {
-        case OBJECT_UNKNOWN:
-            printf("unknown object %u\n", b_ref);
-        break;
-        case OBJECT_ATOM:
-            machine->state = VM_ERROR;
+        if (vm_read4(entry + 7) == addr && vm_read2(entry + 5) == n)
+        {
+            machine->pc = vm_read4(entry + 1);
             return;
-        break;
-        case OBJECT_INT:
-        break;
-        case OBJECT_REF:
-            b_ref = vm_execute_deref(machine, b_ref);
-            if (gc_get_object_type(machine->collector, b_ref) != OBJECT_INT)
-            {
-                machine->state = VM_ERROR;
-                return;
-            }
-        break;
-        case OBJECT_STRUCT:
-            machine->state = VM_ERROR;
-        break;
+        }
     }
 
-    machine->sp -= 2;
-    if (gc_get_int_value(machine->collector, a_ref) <= gc_get_int_value(machine->collector, b_ref))
-    {
-        vm_execute_backtrack(machine);
-    }
+    machine->pc += size * VM_COMPACT_CASE_STRUCT_SIZE;
+}
+
+VM_HANDLER void vm_execute_case_const(vm * machine, bytecode * code)
+{
+    bytecode_print(code);
+    fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
+}
+
+VM_HANDLER void vm_execute_case_struct(vm * machine, bytecode * code)
+{
+    bytecode_print(code);
+    fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
+}
+
+VM_HANDLER void vm_execute_case_struct_addr(vm * machine, bytecode * code)
+{
+    bytecode_print(code);
+    fprintf(stderr, " %u: cannot execute bytecode %s\n", code->addr, bytecode_type_str(code->type));
+}
+
+VM_HANDLER void vm_execute_put_ref_ref(vm * machine, bytecode * code)
+{
+    vm_put_ref(machine, code->put_ref_ref.index);
+    vm_put_ref(machine, code->put_ref_ref.index2);
+}
+
+VM_HANDLER void vm_execute_put_ref_int(vm * machine, bytecode * code)
+{
+    vm_put_ref(machine, code->put_ref_int.index);
+    vm_put_int(machine, code->put_ref_int.value);
+}
+
+VM_HANDLER void vm_execute_put_ref_u_atom(vm * machine, bytecode * code)
+{
+    vm_put_ref(machine, code->put_ref_u_atom.index);
+    vm_u_atom(machine, code->put_ref_u_atom.idx);
+}
+
+VM_HANDLER void vm_execute_put_ref_u_struct_addr(vm * machine, bytecode * code)
+{
+    vm_put_ref(machine, code->put_ref_u_struct.index);
+    vm_u_struct(machine, code->put_ref_u_struct.offset,
+                code->put_ref_u_struct.n, code->put_ref_u_struct.addr);
+}
+
+/* argument goes straight to variable, it is not pushed */
+static inline void vm_son_u_var(vm * machine, unsigned int number, unsigned int index)
+{
+    gc_stack entry = { 0 };
+    entry.type = STACK_TYPE_HEAP_PTR;
+    entry.addr = vm_deref(machine->collector, gc_get_struct_ref(machine->collector, machine->stack[machine->sp].addr, number));
+
+    machine->stack[machine->fp + index] = entry;
+}
+
+VM_HANDLER void vm_execute_son_u_var(vm * machine, bytecode * code)
+{
+    vm_son_u_var(machine, code->son_u_var.number, code->son_u_var.index);
 }
 
 heap_ptr vm_execute_deref(vm * machine, heap_ptr ref)
 {
-    if (gc_get_object_type(machine->collector, ref) == OBJECT_REF &&
-        gc_get_ref_ref(machine->collector, ref) != ref) {
-            return vm_execute_deref(machine, gc_get_ref_ref(machine->collector, ref));
-    } else {
-        return ref;
-    }
+    return vm_deref(machine->collector, ref);
 }
 
 void vm_execute_trail(vm * machine, heap_ptr ref)
@@ -1204,6 +1423,10 @@ void vm_execute_trail(vm * machine, heap_ptr ref)
 
         machine->tp = machine->tp + 1;
         machine->trail[machine->tp] = entry;
+        if (machine->tp + 1 > machine->stats.max_trail)
+        {
+            machine->stats.max_trail = machine->tp + 1;
+        }
     }
 }
 
@@ -1233,157 +1456,1156 @@ void vm_execute_backtrack(vm * machine)
 
     assert(machine->stack[machine->fp - 5].type == STACK_TYPE_PC_OFFSET);
     machine->pc = machine->stack[machine->fp - 5].offset;
+    if (machine->pc >= machine->segment_addr)
+    {
+        machine->state = VM_SEGMENT;
+    }
+
+    if (machine->profiler != NULL)
+    {
+        profile_backtrack(machine->profiler, machine->stack, machine->pc, machine->bp);
+    }
 }
 
+static char vm_work_push(vm * machine, heap_ptr ref)
+{
+    if (machine->work_top == machine->work_size)
+    {
+        heap_ptr * work = (heap_ptr *)realloc(machine->work, sizeof(heap_ptr) * machine->work_size * 2);
+        if (work == NULL)
+        {
+            machine->state = VM_ERROR_OUT_OF_MEMORY;
+            return 0;
+        }
+        machine->work = work;
+        machine->work_size *= 2;
+    }
+    machine->work[machine->work_top++] = ref;
+    return 1;
+}
+
+static void vm_bind_ref(vm * machine, heap_ptr ref, heap_ptr value)
+{
+    gc_set_ref_ref(machine->collector, ref, value);
+    vm_execute_trail(machine, ref);
+}
+
+/**
+ * Pairs of terms still to unify are kept on the work stack, structure
+ * arguments are pushed in reverse so they are compared left to right.
+ */
 char vm_execute_unify(vm * machine, heap_ptr ref_u, heap_ptr ref_v)
 {
-    if (ref_u == ref_v)
+    gc * collector = machine->collector;
+    unsigned int base = machine->work_top;
+    char unified = 1;
+
+    if (!vm_work_push(machine, ref_u) || !vm_work_push(machine, ref_v))
     {
-        return 1;
+        machine->work_top = base;
+        return 0;
     }
-    if (gc_get_object_type(machine->collector, ref_u) == OBJECT_REF)
+    while (machine->work_top > base)
     {
-        if (gc_get_object_type(machine->collector, ref_v) == OBJECT_REF)
+        ref_v = vm_deref(collector, machine->work[--machine->work_top]);
+        ref_u = vm_deref(collector, machine->work[--machine->work_top]);
+        if (ref_u == ref_v)
+        {
+            continue;
+        }
+
+        gc_heap cell_u = GC_CELL(collector, ref_u);
+        gc_heap cell_v = GC_CELL(collector, ref_v);
+        if (GC_CELL_TAG(cell_u) == GC_TAG_REF)
         {
-            if (ref_u > ref_v)
+            if (GC_CELL_TAG(cell_v) == GC_TAG_REF)
             {
-                gc_set_ref_ref(machine->collector, ref_u, ref_v);
-                vm_execute_trail(machine, ref_u);
-                return 1;
+                if (ref_u > ref_v)
+                {
+                    vm_bind_ref(machine, ref_u, ref_v);
+                }
+                else
+                {
+                    vm_bind_ref(machine, ref_v, ref_u);
+                }
+                continue;
             }
-            else
+            if (vm_execute_occurs_check(machine, ref_u, ref_v))
             {
-                gc_set_ref_ref(machine->collector, ref_v, ref_u);
-                vm_execute_trail(machine, ref_v);
-                return 1;
+                vm_bind_ref(machine, ref_u, ref_v);
+                continue;
             }
+            unified = 0;
+            break;
         }
-        else if (vm_execute_check_low(machine, ref_u, ref_v))
+        if (GC_CELL_TAG(cell_v) == GC_TAG_REF)
         {
-            gc_set_ref_ref(machine->collector, ref_u, ref_v);
-            vm_execute_trail(machine, ref_u);
-            return 1;
+            if (vm_execute_occurs_check(machine, ref_v, ref_u))
+            {
+                vm_bind_ref(machine, ref_v, ref_u);
+                continue;
+            }
+            unified = 0;
+            break;
         }
-        else
+        if (GC_CELL_TAG(cell_u) == GC_TAG_ATOM || GC_CELL_TAG(cell_u) == GC_TAG_INT)
         {
-            vm_execute_backtrack(machine);
-            return 0;
+            /* same tag and payload */
+            if (cell_u == cell_v)
+            {
+                continue;
+            }
+            unified = 0;
+            break;
         }
-    }
-    if (gc_get_object_type(machine->collector, ref_v) == OBJECT_REF)
-    {
-        if (vm_execute_check_low(machine, ref_v, ref_u))
+        if (GC_CELL_TAG(cell_u) == GC_TAG_STRUCT && cell_u == cell_v)
         {
-            gc_set_ref_ref(machine->collector, ref_v, ref_u);
-            vm_execute_trail(machine, ref_v);
-            return 1;
+            heap_size_t i;
+            for (i = GC_CELL_STRUCT_SIZE(cell_u); i >= 1; i--)
+            {
+                if (!vm_work_push(machine, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, ref_u + i))) ||
+                    !vm_work_push(machine, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, ref_v + i))))
+                {
+                    machine->work_top = base;
+                    return 0;
+                }
+            }
+            continue;
         }
-        else
+        unified = 0;
+        break;
+    }
+    if (!unified)
+    {
+        machine->work_top = base;
+        if (machine->state == VM_RUNNING)
         {
             vm_execute_backtrack(machine);
-            return 0;
         }
+        return 0;
     }
-    if (gc_get_object_type(machine->collector, ref_u) == OBJECT_ATOM &&
-        gc_get_object_type(machine->collector, ref_v) == OBJECT_ATOM &&
-        gc_get_atom_idx(machine->collector, ref_u) == gc_get_atom_idx(machine->collector, ref_v))
+    return 1;
+}
+
+/* 1 when variable ref_u may be bound to ref_v in current occurs check mode */
+char vm_execute_occurs_check(vm * machine, heap_ptr ref_u, heap_ptr ref_v)
+{
+    if (machine->occurs_check == VM_OCCURS_CHECK_OFF ||
+        vm_execute_check_low(machine, ref_u, ref_v))
     {
         return 1;
     }
-    if (gc_get_object_type(machine->collector, ref_u) == OBJECT_INT &&
-        gc_get_object_type(machine->collector, ref_v) == OBJECT_INT &&
-        gc_get_int_value(machine->collector, ref_u) == gc_get_int_value(machine->collector, ref_v))
+    if (machine->state != VM_RUNNING)
     {
-        return 1;
+        /* work stack could not grow, state already tells why */
+        return 0;
     }
-    if (gc_get_object_type(machine->collector, ref_u) == OBJECT_STRUCT &&
-        gc_get_object_type(machine->collector, ref_v) == OBJECT_STRUCT &&
-        gc_get_struct_addr(machine->collector, ref_u) == gc_get_struct_addr(machine->collector, ref_v))
+    if (machine->occurs_check == VM_OCCURS_CHECK_ERROR)
     {
-        unsigned int i = 0;
-        unsigned int size = gc_get_struct_size(machine->collector, ref_u);
-        for (i = 0; i < size; i++)
-        {
-            if (!vm_execute_unify(machine,
-                                  vm_execute_deref(machine, gc_get_struct_ref(machine->collector, ref_u, i)),
-                                  vm_execute_deref(machine, gc_get_struct_ref(machine->collector, ref_v, i))))
-            {
-                return 0;
-            }
-            return 1;
-        }
+        fprintf(stderr, "occurs check: variable occurs in term it is bound to\n");
+        machine->state = VM_ERROR_OCCURS_CHECK;
     }
-    vm_execute_backtrack(machine);
     return 0;
 }
 
+/* occurs check, 0 when ref_u is found inside ref_v */
 char vm_execute_check_low(vm * machine, heap_ptr ref_u, heap_ptr ref_v)
 {
-    if (ref_u == ref_v)
+    gc * collector = machine->collector;
+    unsigned int base = machine->work_top;
+
+    if (!vm_work_push(machine, ref_v))
     {
         return 0;
     }
-    if (gc_get_object_type(machine->collector, ref_v) == OBJECT_STRUCT)
+    while (machine->work_top > base)
     {
-        unsigned int i = 0;
-        unsigned int size = gc_get_struct_size(machine->collector, ref_v);
-        for (i = 0; i < size; i++)
+        ref_v = machine->work[--machine->work_top];
+        if (ref_u == ref_v)
+        {
+            machine->work_top = base;
+            return 0;
+        }
+        gc_heap cell_v = GC_CELL(collector, ref_v);
+        if (GC_CELL_TAG(cell_v) == GC_TAG_STRUCT)
         {
-            if (!vm_execute_check_low(machine, ref_u,
-                                      vm_execute_deref(machine, gc_get_struct_ref(machine->collector, ref_v, i))))
+            heap_size_t i;
+            for (i = GC_CELL_STRUCT_SIZE(cell_v); i >= 1; i--)
             {
-                return 0;
+                if (!vm_work_push(machine, vm_deref(collector,
+                                  (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, ref_v + i)))))
+                {
+                    machine->work_top = base;
+                    return 0;
+                }
             }
         }
     }
     return 1;
 }
 
+static stack_size_t vm_grow_size(stack_size_t size, stack_size_t min_size, stack_size_t max_size)
+{
+    stack_size_t new_size = size > 0 ? size : 1;
+    while (new_size <= min_size)
+    {
+        new_size = new_size > max_size / 2 ? max_size : new_size * 2;
+    }
+    return new_size;
+}
+
 char vm_execute_check_size(vm * machine, stack_size_t new_stack_size, stack_size_t new_trail_size)
 {
-    char size_ok = 1;
+    if (new_stack_size >= machine->stack_size)
+    {
+        gc_stack * stack = NULL;
+        stack_size_t size = 0;
 
-    if (new_stack_size >= machine->stack_size ||
-        new_trail_size >= machine->trail_size)
+        if (new_stack_size < machine->max_stack_size)
+        {
+            size = vm_grow_size(machine->stack_size, new_stack_size, machine->max_stack_size);
+            stack = gc_stack_resize(machine->stack, size);
+        }
+        if (stack == NULL)
+        {
+            fprintf(stderr, "stack size %d exceeds maximum %d\n", new_stack_size, machine->max_stack_size);
+            machine->state = VM_ERROR_OUT_OF_MEMORY;
+            return 0;
+        }
+        machine->stack = stack;
+        machine->stack_size = size;
+    }
+    if (new_trail_size >= machine->trail_size)
     {
-        size_ok = 0;
-        machine->state = VM_ERROR_OUT_OF_MEMORY;
+        gc_stack * trail = NULL;
+        stack_size_t size = 0;
+
+        if (new_trail_size < machine->max_trail_size)
+        {
+            size = vm_grow_size(machine->trail_size, new_trail_size, machine->max_trail_size);
+            trail = gc_stack_resize(machine->trail, size);
+        }
+        if (trail == NULL)
+        {
+            fprintf(stderr, "trail size %d exceeds maximum %d\n", new_trail_size, machine->max_trail_size);
+            machine->state = VM_ERROR_OUT_OF_MEMORY;
+            return 0;
+        }
+        machine->trail = trail;
+        machine->trail_size = size;
     }
 
-    return size_ok;
+    return 1;
 }
 
-int vm_execute(vm * machine, gencode_binary * binary_value)
+int vm_execute(vm * machine, const gencode_binary * binary_value)
 {
-    bytecode * bc = NULL;
+    vm_execute_start(machine, binary_value);
+    vm_execute_run(machine);
+
+    if (machine->profiler != NULL)
+    {
+        profile_finish(machine->profiler);
+    }
+
+    if (machine->state == VM_ERROR ||
+        machine->state == VM_ERROR_OUT_OF_MEMORY ||
+        machine->state == VM_ERROR_DIV_BY_ZERO ||
+        machine->state == VM_ERROR_OCCURS_CHECK)
+    {
+        // print machine error state
+        vm_execute_print(machine);
+        return 1;
+    }
+    else if (machine->state == VM_STOP)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* prepares machine to run query of binary from its first instruction */
+void vm_execute_start(vm * machine, const gencode_binary * binary_value)
+{
+    vm_execute_start_segment(machine, binary_value, NULL);
+}
+
+/* runs query of segment generated for binary instead, see gencode_segment */
+void vm_execute_start_segment(vm * machine, const gencode_binary * binary_value, const gencode_segment * segment_value)
+{
+    unsigned int int_stack_size = binary_value->int_stack_size;
+
     machine->binary_value_ref = binary_value;
+    machine->segment_ref = segment_value;
+    machine->segment_addr = segment_value != NULL ? segment_value->code_addr : (pc_ptr)-1;
+    machine->stack_reserve = binary_value->stack_reserve;
+    machine->pc = 0;
+    if (segment_value != NULL)
+    {
+        if ((stack_size_t)segment_value->stack_reserve > machine->stack_reserve)
+        {
+            machine->stack_reserve = segment_value->stack_reserve;
+        }
+        if (segment_value->int_stack_size > int_stack_size)
+        {
+            int_stack_size = segment_value->int_stack_size;
+        }
+        machine->pc = segment_value->code_addr;
+    }
+    machine->int_stack = (int *)realloc(machine->int_stack, sizeof(int) * (int_stack_size + 1));
+    machine->int_sp = 0;
+
+    writer_set_binary(machine->out, binary_value);
+    writer_set_segment(machine->out, segment_value);
+    if (!machine->pause_on_answer && machine->out->format == WRITER_FORMAT_OBJECT)
+    {
+        writer_str(machine->out, "------------\n");
+    }
+
+    machine->state = segment_value != NULL ? VM_SEGMENT : VM_RUNNING;
+}
+
+/* runs from pc until machine stops, fails or pauses at an answer */
+void vm_execute_run(vm * machine)
+{
+    struct timespec start, end;
+    const gencode_binary * binary_value = machine->binary_value_ref;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    printf("------------\n");
+    do
+    {
+        if (machine->state == VM_SEGMENT)
+        {
+            machine->state = VM_RUNNING;
+            vm_execute_segment(machine);
+            if (machine->state != VM_RUNNING)
+            {
+                continue;
+            }
+        }
+        if (machine->ngrams != NULL)
+        {
+            vm_execute_ngram(machine);
+        }
+        else
+        {
+            switch (machine->dispatch)
+            {
+                case VM_DISPATCH_TABLE:
+                    vm_execute_table(machine);
+                break;
+                case VM_DISPATCH_THREADED:
+                    vm_execute_threaded(machine, binary_value);
+                break;
+                case VM_DISPATCH_COMPACT:
+                    if (binary_value->compact_code != NULL && machine->segment_ref == NULL)
+                    {
+                        vm_execute_compact(machine, binary_value);
+                    }
+                    else
+                    {
+                        vm_execute_table(machine);
+                    }
+                break;
+            }
+        }
+    } while (machine->state == VM_SEGMENT);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    machine->stats.exec_time += (end.tv_sec - start.tv_sec) +
+                                (end.tv_nsec - start.tv_nsec) / 1e9;
+    gc_update_max_used(machine->collector);
+    writer_flush(machine->out);
+}
+
+/**
+ * Resumes machine paused at an answer by backtracking into the most recent
+ * choice point. Returns 1 when machine is at next answer.
+ */
+char vm_execute_next(vm * machine)
+{
+    if (machine->state != VM_ANSWER)
+    {
+        return 0;
+    }
+    if (machine->max_solutions > 0 && machine->stats.solutions >= machine->max_solutions)
+    {
+        machine->state = VM_STOP;
+        return 0;
+    }
 
     machine->state = VM_RUNNING;
+    vm_execute_backtrack(machine);
+    vm_execute_run(machine);
+
+    return machine->state == VM_ANSWER;
+}
+
+/* values of query variables while machine is at an answer */
+gc_stack * vm_answer(vm * machine, unsigned int * size)
+{
+    assert(machine->state == VM_ANSWER);
+
+    *size = machine->answer_size;
+    return machine->stack + machine->fp + 1;
+}
+
+/**
+ * Segment code, see gencode_segment. Runs until pc leaves segment by a
+ * call, return or backtracking into code of binary. Returns and
+ * backtracking into segment set VM_SEGMENT, which stops dispatch loops
+ * of binary code, so they do not check pc on every instruction.
+ */
+void vm_execute_segment(vm * machine)
+{
+    const gencode_segment * segment_value = machine->segment_ref;
+    bytecode * bc = NULL;
+
+    while (machine->state == VM_RUNNING && machine->pc >= machine->segment_addr)
+    {
+        bc = segment_value->code_array + (machine->pc - segment_value->code_addr);
+        machine->pc++;
+        machine->stats.instr_count++;
+
+        vm_execute_op[bc->type].execute(machine, bc);
+        if (machine->state == VM_SEGMENT)
+        {
+            machine->state = VM_RUNNING;
+        }
+    }
+}
+
+void vm_execute_table(vm * machine)
+{
+    bytecode * bc = NULL;
+
     while (machine->state == VM_RUNNING)
     {
         bc = machine->binary_value_ref->code_array + machine->pc;
         machine->pc++;
+        machine->stats.instr_count++;
 
         // bytecode_print(bc);
         vm_execute_op[bc->type].execute(machine, bc);
     }
+}
 
-    if (machine->state == VM_ERROR ||
-        machine->state == VM_ERROR_OUT_OF_MEMORY ||
-        machine->state == VM_ERROR_DIV_BY_ZERO)
+/* table dispatch counting instruction sequences */
+void vm_execute_ngram(vm * machine)
+{
+    bytecode * bc = NULL;
+
+    while (machine->state == VM_RUNNING)
     {
-        // print machine error state
-        vm_execute_print(machine);
-        return 1;
+        bc = machine->binary_value_ref->code_array + machine->pc;
+        ngram_add(machine->ngrams, machine->pc, bc->type);
+        machine->pc++;
+        machine->stats.instr_count++;
+
+        vm_execute_op[bc->type].execute(machine, bc);
     }
-    else if (machine->state == VM_STOP)
+}
+
+/**
+ * Compact code, see gencode_binary_compact. Dispatch is an indirect jump
+ * on the opcode byte and each handler reads its operands from the code,
+ * widths follow bytecode_format_arr. Pc moves past the instruction before
+ * handler runs, so code addresses and jump offsets are byte offsets.
+ * Opcodes which cannot be encoded are decoded and reported by their
+ * vm_execute_op handler.
+ */
+#if defined(__GNUC__)
+#define VM_COMPACT_NEXT()                                     \
+    ip = compact_code + machine->pc;                          \
+    machine->stats.instr_count++;                             \
+    goto *compact_label[*ip]
+
+/* after instructions which fail, stop or report an error */
+#define VM_COMPACT_CHECK_NEXT()                               \
+    if (machine->state != VM_RUNNING)                         \
+    {                                                         \
+        return;                                               \
+    }                                                         \
+    VM_COMPACT_NEXT()
+
+void vm_execute_compact(vm * machine, const gencode_binary * binary_value)
+{
+    static void * compact_label[] = {
+        &&label_decode,
+        &&label_pop,
+        &&label_put_ref,
+        &&label_put_var,
+        &&label_u_ref,
+        &&label_u_var,
+        &&label_check,
+        &&label_put_anon,
+        &&label_put_atom,
+        &&label_put_int,
+        &&label_decode,
+        &&label_put_struct_addr,
+        &&label_u_atom,
+        &&label_u_int,
+        &&label_decode,
+        &&label_u_struct_addr,
+        &&label_up,
+        &&label_bind,
+        &&label_son,
+        &&label_mark,
+        &&label_last_mark,
+        &&label_decode,
+        &&label_call_addr,
+        &&label_decode,
+        &&label_last_call_addr,
+        &&label_push_env,
+        &&label_pop_env,
+        &&label_set_btp,
+        &&label_del_btp,
+        &&label_try,
+        &&label_prune,
+        &&label_set_cut,
+        &&label_fail,
+        &&label_init,
+        &&label_halt,
+        &&label_no,
+        &&label_jump,
+        &&label_label,
+        &&label_int_neg,
+        &&label_int_add,
+        &&label_int_sub,
+        &&label_int_mul,
+        &&label_int_div,
+        &&label_int_push,
+        &&label_int_push_ref,
+        &&label_int_unbox,
+        &&label_int_box,
+        &&label_int_shl,
+        &&label_int_shr,
+        &&label_builtin,
+        &&label_call_builtin,
+        &&label_lt,
+        &&label_gt,
+        &&label_switch_on_term,
+        &&label_switch_on_const,
+        &&label_switch_on_struct,
+        &&label_decode,
+        &&label_decode,
+        &&label_decode,
+        &&label_put_ref_ref,
+        &&label_put_ref_int,
+        &&label_put_ref_u_atom,
+        &&label_put_ref_u_struct_addr,
+        &&label_son_u_var
+    };
+    assert(sizeof(compact_label) / sizeof(compact_label[0]) == BYTECODE_END);
+    assert(bytecode_format_arr[BYTECODE_CASE_CONST].size == VM_COMPACT_CASE_CONST_SIZE);
+    assert(bytecode_format_arr[BYTECODE_CASE_STRUCT_ADDR].size == VM_COMPACT_CASE_STRUCT_SIZE);
+
+    const unsigned char * compact_code = binary_value->compact_code;
+    const unsigned char * ip = NULL;
+    bytecode bc = { 0 };
+
+    VM_COMPACT_CHECK_NEXT();
+
+    label_decode:
+        bc.addr = machine->pc;
+        machine->pc += vm_decode(ip, &bc);
+        vm_execute_op[bc.type].execute(machine, &bc);
+        VM_COMPACT_CHECK_NEXT();
+    label_pop:
+        machine->pc += 1;
+        vm_execute_pop(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_put_ref:
+        machine->pc += 3;
+        vm_put_ref(machine, vm_read2(ip + 1));
+        VM_COMPACT_NEXT();
+    label_put_var:
+        machine->pc += 3;
+        vm_put_var(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_u_ref:
+        machine->pc += 3;
+        vm_u_ref(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_u_var:
+        machine->pc += 3;
+        vm_u_var(machine, vm_read2(ip + 1));
+        VM_COMPACT_NEXT();
+    label_check:
+        machine->pc += 3;
+        vm_check(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_put_anon:
+        machine->pc += 1;
+        vm_execute_put_anon(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_put_atom:
+        machine->pc += 5;
+        vm_put_atom(machine, vm_read4(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_put_int:
+        machine->pc += 5;
+        vm_put_int(machine, (int)vm_read4(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_put_struct_addr:
+        machine->pc += 7;
+        vm_put_struct(machine, vm_read2(ip + 1), vm_read4(ip + 3));
+        VM_COMPACT_CHECK_NEXT();
+    label_u_atom:
+        machine->pc += 5;
+        vm_u_atom(machine, vm_read4(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_u_int:
+        machine->pc += 5;
+        vm_u_int(machine, (int)vm_read4(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_u_struct_addr:
+        machine->pc += 11;
+        vm_u_struct(machine, (pc_offset)vm_read4(ip + 1), vm_read2(ip + 5), vm_read4(ip + 7));
+        VM_COMPACT_CHECK_NEXT();
+    label_up:
+        machine->pc += 5;
+        vm_up(machine, vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_bind:
+        machine->pc += 1;
+        vm_execute_bind(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_son:
+        machine->pc += 3;
+        vm_son(machine, vm_read2(ip + 1));
+        VM_COMPACT_NEXT();
+    label_mark:
+        machine->pc += 5;
+        vm_mark(machine, vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_last_mark:
+        machine->pc += 1;
+        vm_execute_last_mark(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_call_addr:
+        machine->pc += 7;
+        vm_call(machine, vm_read2(ip + 1), vm_read4(ip + 3));
+        VM_COMPACT_NEXT();
+    label_last_call_addr:
+        machine->pc += 9;
+        vm_last_call(machine, vm_read2(ip + 1), vm_read2(ip + 3), vm_read4(ip + 5));
+        VM_COMPACT_NEXT();
+    label_push_env:
+        machine->pc += 3;
+        vm_push_env(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_pop_env:
+        machine->pc += 1;
+        vm_pop_env(machine);
+        VM_COMPACT_CHECK_NEXT();
+    label_set_btp:
+        machine->pc += 1;
+        vm_execute_set_btp(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_del_btp:
+        machine->pc += 1;
+        vm_execute_del_btp(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_try:
+        machine->pc += 5;
+        vm_try(machine, vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_prune:
+        machine->pc += 1;
+        vm_execute_prune(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_set_cut:
+        machine->pc += 1;
+        vm_execute_set_cut(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_fail:
+        machine->pc += 1;
+        vm_execute_fail(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_init:
+        machine->pc += 5;
+        vm_init(machine, vm_read4(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_halt:
+        machine->pc += 3;
+        vm_halt(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_no:
+        machine->pc += 1;
+        vm_execute_no(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_jump:
+        machine->pc += 5;
+        vm_jump(machine, (pc_offset)vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_label:
+        machine->pc += 1;
+        VM_COMPACT_NEXT();
+    label_int_neg:
+        machine->pc += 1;
+        vm_execute_int_neg(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_int_add:
+        machine->pc += 1;
+        vm_execute_int_add(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_int_sub:
+        machine->pc += 1;
+        vm_execute_int_sub(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_int_mul:
+        machine->pc += 1;
+        vm_execute_int_mul(machine, NULL);
+        VM_COMPACT_NEXT();
+    label_int_div:
+        machine->pc += 1;
+        vm_execute_int_div(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_int_push:
+        machine->pc += 5;
+        vm_int_push(machine, (int)vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_int_push_ref:
+        machine->pc += 3;
+        vm_int_push_ref(machine, vm_read2(ip + 1));
+        VM_COMPACT_CHECK_NEXT();
+    label_int_unbox:
+        machine->pc += 1;
+        vm_execute_int_unbox(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_int_box:
+        machine->pc += 1;
+        vm_execute_int_box(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_int_shl:
+        machine->pc += 2;
+        vm_int_shl(machine, ip[1]);
+        VM_COMPACT_NEXT();
+    label_int_shr:
+        machine->pc += 2;
+        vm_int_shr(machine, ip[1]);
+        VM_COMPACT_NEXT();
+    label_builtin:
+        machine->pc += 7;
+        vm_builtin(machine, vm_read2(ip + 1), vm_read4(ip + 3));
+        VM_COMPACT_CHECK_NEXT();
+    label_call_builtin:
+        machine->pc += 9;
+        vm_call_builtin(machine, vm_read2(ip + 1), vm_read4(ip + 3), vm_read2(ip + 7));
+        VM_COMPACT_CHECK_NEXT();
+    label_lt:
+        machine->pc += 1;
+        vm_execute_lt(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_gt:
+        machine->pc += 1;
+        vm_execute_gt(machine, NULL);
+        VM_COMPACT_CHECK_NEXT();
+    label_switch_on_term:
+        machine->pc += 13;
+        vm_switch_on_term(machine, vm_read4(ip + 1), vm_read4(ip + 5), vm_read4(ip + 9));
+        VM_COMPACT_NEXT();
+    label_switch_on_const:
+        machine->pc += 5;
+        vm_compact_switch_on_const(machine, vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_switch_on_struct:
+        machine->pc += 5;
+        vm_compact_switch_on_struct(machine, vm_read4(ip + 1));
+        VM_COMPACT_NEXT();
+    label_put_ref_ref:
+        machine->pc += 5;
+        vm_put_ref(machine, vm_read2(ip + 1));
+        vm_put_ref(machine, vm_read2(ip + 3));
+        VM_COMPACT_NEXT();
+    label_put_ref_int:
+        machine->pc += 7;
+        vm_put_ref(machine, vm_read2(ip + 1));
+        vm_put_int(machine, (int)vm_read4(ip + 3));
+        VM_COMPACT_CHECK_NEXT();
+    label_put_ref_u_atom:
+        machine->pc += 7;
+        vm_put_ref(machine, vm_read2(ip + 1));
+        vm_u_atom(machine, vm_read4(ip + 3));
+        VM_COMPACT_CHECK_NEXT();
+    label_put_ref_u_struct_addr:
+        machine->pc += 13;
+        vm_put_ref(machine, vm_read2(ip + 1));
+        vm_u_struct(machine, (pc_offset)vm_read4(ip + 3), vm_read2(ip + 7), vm_read4(ip + 9));
+        VM_COMPACT_CHECK_NEXT();
+    label_son_u_var:
+        machine->pc += 5;
+        vm_son_u_var(machine, vm_read2(ip + 1), vm_read2(ip + 3));
+        VM_COMPACT_NEXT();
+}
+#undef VM_COMPACT_NEXT
+#undef VM_COMPACT_CHECK_NEXT
+#else
+void vm_execute_compact(vm * machine, const gencode_binary * binary_value)
+{
+    bytecode bc = { 0 };
+    const unsigned char * compact_code = binary_value->compact_code;
+
+    /* no computed goto, decode into bc and call handler */
+    while (machine->state == VM_RUNNING)
     {
-        return 0;
+        bc.addr = machine->pc;
+        machine->pc += vm_decode(compact_code + machine->pc, &bc);
+        machine->stats.instr_count++;
+
+        switch (bc.type)
+        {
+            case BYTECODE_SWITCH_ON_CONST:
+                vm_compact_switch_on_const(machine, bc.switch_on_const.size);
+            break;
+            case BYTECODE_SWITCH_ON_STRUCT:
+                vm_compact_switch_on_struct(machine, bc.switch_on_struct.size);
+            break;
+            default:
+                vm_execute_op[bc.type].execute(machine, &bc);
+            break;
+        }
     }
+}
+#endif
 
-    return 1;
+/**
+ * Direct threaded code. Every instruction in code_array gets the address of
+ * its handler label in threaded_code, so dispatch is a single indirect jump
+ * at the end of each handler instead of a call through vm_execute_op.
+ * Label addresses are only visible inside this function, so called with
+ * machine == NULL it returns them indexed by bytecode type, see
+ * vm_thread_code. Binary is not written here, so it may be shared.
+ */
+#if defined(__GNUC__)
+#define VM_THREADED_NEXT()                                    \
+    bc = code_array + machine->pc;                            \
+    machine->stats.instr_count++;                             \
+    goto *threaded_code[machine->pc++]
+
+/* after instructions which fail, stop or report an error */
+#define VM_THREADED_CHECK_NEXT()                              \
+    if (machine->state != VM_RUNNING)                         \
+    {                                                         \
+        return NULL;                                          \
+    }                                                         \
+    VM_THREADED_NEXT()
+
+void ** vm_execute_threaded(vm * machine, const gencode_binary * binary_value)
+{
+    static void * threaded_label[] = {
+        &&label_unknown,
+        &&label_pop,
+        &&label_put_ref,
+        &&label_put_var,
+        &&label_u_ref,
+        &&label_u_var,
+        &&label_check,
+        &&label_put_anon,
+        &&label_put_atom,
+        &&label_put_int,
+        &&label_put_struct,
+        &&label_put_struct_addr,
+        &&label_u_atom,
+        &&label_u_int,
+        &&label_u_struct,
+        &&label_u_struct_addr,
+        &&label_up,
+        &&label_bind,
+        &&label_son,
+        &&label_mark,
+        &&label_last_mark,
+        &&label_call,
+        &&label_call_addr,
+        &&label_last_call,
+        &&label_last_call_addr,
+        &&label_push_env,
+        &&label_pop_env,
+        &&label_set_btp,
+        &&label_del_btp,
+        &&label_try,
+        &&label_prune,
+        &&label_set_cut,
+        &&label_fail,
+        &&label_init,
+        &&label_halt,
+        &&label_no,
+        &&label_jump,
+        &&label_label,
+        &&label_int_neg,
+        &&label_int_add,
+        &&label_int_sub,
+        &&label_int_mul,
+        &&label_int_div,
+        &&label_int_push,
+        &&label_int_push_ref,
+        &&label_int_unbox,
+        &&label_int_box,
+        &&label_int_shl,
+        &&label_int_shr,
+        &&label_builtin,
+        &&label_call_builtin,
+        &&label_lt,
+        &&label_gt,
+        &&label_switch_on_term,
+        &&label_switch_on_const,
+        &&label_switch_on_struct,
+        &&label_case_const,
+        &&label_case_struct,
+        &&label_case_struct_addr,
+        &&label_put_ref_ref,
+        &&label_put_ref_int,
+        &&label_put_ref_u_atom,
+        &&label_put_ref_u_struct_addr,
+        &&label_son_u_var
+    };
+    assert(sizeof(threaded_label) / sizeof(threaded_label[0]) == BYTECODE_END);
+
+    if (machine == NULL)
+    {
+        return threaded_label;
+    }
+    if (binary_value->threaded_code == NULL)
+    {
+        /* not prepared by vm_thread_code */
+        vm_execute_table(machine);
+        return NULL;
+    }
+
+    bytecode * code_array = binary_value->code_array;
+    void ** threaded_code = binary_value->threaded_code;
+    bytecode * bc = NULL;
+
+    VM_THREADED_CHECK_NEXT();
+
+    label_unknown:
+        vm_execute_unknown(machine, bc);
+        VM_THREADED_NEXT();
+    label_pop:
+        vm_execute_pop(machine, bc);
+        VM_THREADED_NEXT();
+    label_put_ref:
+        vm_execute_put_ref(machine, bc);
+        VM_THREADED_NEXT();
+    label_put_var:
+        vm_execute_put_var(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_u_ref:
+        vm_execute_u_ref(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_u_var:
+        vm_execute_u_var(machine, bc);
+        VM_THREADED_NEXT();
+    label_check:
+        vm_execute_check(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_anon:
+        vm_execute_put_anon(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_atom:
+        vm_execute_put_atom(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_int:
+        vm_execute_put_int(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_struct:
+        vm_execute_put_struct(machine, bc);
+        VM_THREADED_NEXT();
+    label_put_struct_addr:
+        vm_execute_put_struct_addr(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_u_atom:
+        vm_execute_u_atom(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_u_int:
+        vm_execute_u_int(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_u_struct:
+        vm_execute_u_struct(machine, bc);
+        VM_THREADED_NEXT();
+    label_u_struct_addr:
+        vm_execute_u_struct_addr(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_up:
+        vm_execute_up(machine, bc);
+        VM_THREADED_NEXT();
+    label_bind:
+        vm_execute_bind(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_son:
+        vm_execute_son(machine, bc);
+        VM_THREADED_NEXT();
+    label_mark:
+        vm_execute_mark(machine, bc);
+        VM_THREADED_NEXT();
+    label_last_mark:
+        vm_execute_last_mark(machine, bc);
+        VM_THREADED_NEXT();
+    label_call:
+        vm_execute_call(machine, bc);
+        VM_THREADED_NEXT();
+    label_call_addr:
+        vm_execute_call_addr(machine, bc);
+        VM_THREADED_NEXT();
+    label_last_call:
+        vm_execute_last_call(machine, bc);
+        VM_THREADED_NEXT();
+    label_last_call_addr:
+        vm_execute_last_call_addr(machine, bc);
+        VM_THREADED_NEXT();
+    label_push_env:
+        vm_execute_push_env(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_pop_env:
+        vm_execute_pop_env(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_set_btp:
+        vm_execute_set_btp(machine, bc);
+        VM_THREADED_NEXT();
+    label_del_btp:
+        vm_execute_del_btp(machine, bc);
+        VM_THREADED_NEXT();
+    label_try:
+        vm_execute_try(machine, bc);
+        VM_THREADED_NEXT();
+    label_prune:
+        vm_execute_prune(machine, bc);
+        VM_THREADED_NEXT();
+    label_set_cut:
+        vm_execute_set_cut(machine, bc);
+        VM_THREADED_NEXT();
+    label_fail:
+        vm_execute_fail(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_init:
+        vm_execute_init(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_halt:
+        vm_execute_halt(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_no:
+        vm_execute_no(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_jump:
+        vm_execute_jump(machine, bc);
+        VM_THREADED_NEXT();
+    label_label:
+        vm_execute_label(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_neg:
+        vm_execute_int_neg(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_add:
+        vm_execute_int_add(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_sub:
+        vm_execute_int_sub(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_mul:
+        vm_execute_int_mul(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_div:
+        vm_execute_int_div(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_int_push:
+        vm_execute_int_push(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_push_ref:
+        vm_execute_int_push_ref(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_int_unbox:
+        vm_execute_int_unbox(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_int_box:
+        vm_execute_int_box(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_int_shl:
+        vm_execute_int_shl(machine, bc);
+        VM_THREADED_NEXT();
+    label_int_shr:
+        vm_execute_int_shr(machine, bc);
+        VM_THREADED_NEXT();
+    label_builtin:
+        vm_execute_builtin(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_call_builtin:
+        vm_execute_call_builtin(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_lt:
+        vm_execute_lt(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_gt:
+        vm_execute_gt(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_switch_on_term:
+        vm_execute_switch_on_term(machine, bc);
+        VM_THREADED_NEXT();
+    label_switch_on_const:
+        vm_execute_switch_on_const(machine, bc);
+        VM_THREADED_NEXT();
+    label_switch_on_struct:
+        vm_execute_switch_on_struct(machine, bc);
+        VM_THREADED_NEXT();
+    label_case_const:
+        vm_execute_case_const(machine, bc);
+        VM_THREADED_NEXT();
+    label_case_struct:
+        vm_execute_case_struct(machine, bc);
+        VM_THREADED_NEXT();
+    label_case_struct_addr:
+        vm_execute_case_struct_addr(machine, bc);
+        VM_THREADED_NEXT();
+    label_put_ref_ref:
+        vm_execute_put_ref_ref(machine, bc);
+        VM_THREADED_NEXT();
+    label_put_ref_int:
+        vm_execute_put_ref_int(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_ref_u_atom:
+        vm_execute_put_ref_u_atom(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_put_ref_u_struct_addr:
+        vm_execute_put_ref_u_struct_addr(machine, bc);
+        VM_THREADED_CHECK_NEXT();
+    label_son_u_var:
+        vm_execute_son_u_var(machine, bc);
+        VM_THREADED_NEXT();
+}
+#undef VM_THREADED_NEXT
+#undef VM_THREADED_CHECK_NEXT
+#else
+void ** vm_execute_threaded(vm * machine, const gencode_binary * binary_value)
+{
+    /* no computed goto, fall back to table dispatch */
+    if (machine != NULL)
+    {
+        vm_execute_table(machine);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * Resolves handler labels of threaded dispatch. Must be called before
+ * binary is shared by machines running in other threads.
+ */
+void vm_thread_code(gencode_binary * binary_value)
+{
+    void ** threaded_label = vm_execute_threaded(NULL, binary_value);
+    unsigned int i;
+
+    if (threaded_label == NULL || binary_value->threaded_code != NULL)
+    {
+        return;
+    }
+    binary_value->threaded_code = (void **)malloc(sizeof(void *) * binary_value->code_size);
+    for (i = 0; i < binary_value->code_size; i++)
+    {
+        binary_value->threaded_code[i] = threaded_label[binary_value->code_array[i].type];
+    }
 }
 
 const char * vm_state_to_str(vm_state state)
@@ -1395,6 +2617,31 @@ const char * vm_state_to_str(vm_state state)
         case VM_STOP: return "VM_STOP";
         case VM_ERROR_OUT_OF_MEMORY: return "VM_ERROR_OUT_OF_MEMORY";
         case VM_ERROR_DIV_BY_ZERO: return "VM_ERROR_DIV_BY_ZERO";
+        case VM_ERROR_OCCURS_CHECK: return "VM_ERROR_OCCURS_CHECK";
+        case VM_ANSWER: return "VM_ANSWER";
+        case VM_SEGMENT: return "VM_SEGMENT";
     }
     return "VM_UNKNOWN";
 }
+
+const char * vm_dispatch_to_str(vm_dispatch dispatch)
+{
+    switch (dispatch)
+    {
+        case VM_DISPATCH_TABLE: return "table";
+        case VM_DISPATCH_THREADED: return "threaded";
+        case VM_DISPATCH_COMPACT: return "compact";
+    }
+    return "unknown";
+}
+
+const char * vm_occurs_check_to_str(vm_occurs_check occurs_check)
+{
+    switch (occurs_check)
+    {
+        case VM_OCCURS_CHECK_OFF: return "off";
+        case VM_OCCURS_CHECK_ON: return "on";
+        case VM_OCCURS_CHECK_ERROR: return "error";
+    }
+    return "unknown";
+}
@@ -25,6 +25,13 @@
 #include "bytecode.h"
 #include "gencode.h"
 #include "gc.h"
+#include "profile.h"
+#include "ngram.h"
+#include "writer.h"
+
+#define VM_MAX_HEAP_SIZE (16 * 1024 * 1024)
+#define VM_MAX_STACK_SIZE (4 * 1024 * 1024)
+#define VM_MAX_TRAIL_SIZE (4 * 1024 * 1024)
 
 typedef enum vm_state
 {
@@ -32,9 +39,36 @@ typedef enum vm_state
     VM_RUNNING = 1,
     VM_ERROR = 2,
     VM_ERROR_OUT_OF_MEMORY = 3,
-    VM_ERROR_DIV_BY_ZERO = 4
+    VM_ERROR_DIV_BY_ZERO = 4,
+    VM_ERROR_OCCURS_CHECK = 5,
+    VM_ANSWER = 6, /* stopped at HALT with answer in query frame, see vm_execute_next */
+    VM_SEGMENT = 7 /* running, pc moved into segment code, see vm_execute_segment */
 } vm_state;
 
+typedef enum vm_occurs_check
+{
+    VM_OCCURS_CHECK_OFF = 0, /* bind without looking into the term */
+    VM_OCCURS_CHECK_ON = 1, /* binding variable into a term containing it fails */
+    VM_OCCURS_CHECK_ERROR = 2 /* such binding stops the machine with error */
+} vm_occurs_check;
+
+typedef enum vm_dispatch
+{
+    VM_DISPATCH_TABLE = 0, /* indirect call through vm_execute_op */
+    VM_DISPATCH_THREADED = 1, /* direct threaded code, computed goto */
+    VM_DISPATCH_COMPACT = 2 /* variable length code decoded in dispatch loop */
+} vm_dispatch;
+
+typedef struct vm_stats
+{
+    unsigned long instr_count; /* executed instructions */
+    unsigned long call_count; /* logical inferences, executed calls */
+    stack_size_t max_stack; /* largest stack use (entries) */
+    stack_size_t max_trail; /* largest trail use (entries) */
+    double exec_time; /* wall time spent in vm_execute (seconds) */
+    unsigned long solutions; /* answers reached by HALT */
+} vm_stats;
+
 typedef struct vm {
     pc_ptr pc; /* program counter */
     heap_ptr hp; /* heap pointer */
@@ -45,13 +79,32 @@ typedef struct vm {
     heap_size_t heap_size; /* heap size */
     stack_size_t stack_size; /* stack size */
     stack_size_t trail_size; /* trail size */
+    stack_size_t max_stack_size; /* stack grows on demand up to max size */
+    stack_size_t max_trail_size; /* trail grows on demand up to max size */
+    stack_size_t stack_reserve; /* checked above frame, see gencode_stack_reserve */
+    int * int_stack; /* unboxed arithmetic, int_stack[0] is unused */
+    unsigned int int_sp; /* int stack pointer */
 
     gc * collector;
     gc_stack * stack;
     gc_stack * trail;
+    heap_ptr * work; /* explicit stack of unification and occurs check */
+    unsigned int work_size;
+    unsigned int work_top;
 
     vm_state state;
-    gencode_binary * binary_value_ref;
+    vm_dispatch dispatch;
+    vm_occurs_check occurs_check;
+    unsigned long max_solutions; /* stop after that many answers, 0 for all */
+    char pause_on_answer; /* HALT stops with VM_ANSWER instead of printing */
+    unsigned int answer_size; /* query variables at fp + 1 when stopped at HALT */
+    vm_stats stats;
+    profile * profiler; /* port profiler, NULL when not profiling */
+    ngram * ngrams; /* instruction sequence counts, NULL when not counting */
+    writer * out; /* answers and write/1 output */
+    const gencode_binary * binary_value_ref; /* shared by machines, never written while running */
+    const gencode_segment * segment_ref; /* query code after binary code, NULL when running query of binary */
+    pc_ptr segment_addr; /* first address of segment, past any pc without segment */
 } vm;
 
 typedef struct vm_execute_str
@@ -62,18 +115,33 @@ typedef struct vm_execute_str
 
 vm * vm_new(heap_size_t heap_size, stack_size_t stack_size, stack_size_t trail_size);
 void vm_delete(vm * machine);
+void vm_set_max_size(vm * machine, heap_size_t max_heap_size,
+                     stack_size_t max_stack_size, stack_size_t max_trail_size);
 
 heap_ptr vm_execute_deref(vm * machine, heap_ptr ref);
 void vm_execute_trail(vm * machine, heap_ptr ref);
 void vm_execute_reset(vm * machine, stack_ptr ref_x, stack_ptr ref_y);
 void vm_execute_backtrack(vm *machine);
 char vm_execute_unify(vm * machine, heap_ptr ref_u, heap_ptr ref_v);
+char vm_execute_occurs_check(vm * machine, heap_ptr ref_u, heap_ptr ref_v);
 char vm_execute_check_low(vm * machine, heap_ptr ref_u, heap_ptr ref_v);
 char vm_execute_check_size(vm * machine, stack_size_t new_stack_size, stack_size_t new_trail_size);
 
-int vm_execute(vm * machine, gencode_binary * binary_value);
+int vm_execute(vm * machine, const gencode_binary * binary_value);
+void vm_execute_start(vm * machine, const gencode_binary * binary_value);
+void vm_execute_start_segment(vm * machine, const gencode_binary * binary_value, const gencode_segment * segment_value);
+void vm_execute_run(vm * machine);
+char vm_execute_next(vm * machine);
+gc_stack * vm_answer(vm * machine, unsigned int * size);
+void vm_execute_segment(vm * machine);
+void vm_execute_table(vm * machine);
+void vm_execute_ngram(vm * machine);
+void vm_execute_compact(vm * machine, const gencode_binary * binary_value);
+void ** vm_execute_threaded(vm * machine, const gencode_binary * binary_value);
+void vm_thread_code(gencode_binary * binary_value);
 void vm_execute_test();
 void vm_execute_print(vm * machine);
+void vm_print_stats(vm * machine);
 
 void vm_execute_unknown(vm * machine, bytecode * code);
 void vm_execute_pop(vm * machine, bytecode * code);
@@ -118,10 +186,30 @@ void vm_execute_int_add(vm * machine, bytecode * code);
 void vm_execute_int_sub(vm * machine, bytecode * code);
 void vm_execute_int_mul(vm * machine, bytecode * code);
 void vm_execute_int_div(vm * machine, bytecode * code);
+void vm_execute_int_push(vm * machine, bytecode * code);
+void vm_execute_int_push_ref(vm * machine, bytecode * code);
+void vm_execute_int_unbox(vm * machine, bytecode * code);
+void vm_execute_int_box(vm * machine, bytecode * code);
+void vm_execute_int_shl(vm * machine, bytecode * code);
+void vm_execute_int_shr(vm * machine, bytecode * code);
 void vm_execute_builtin(vm * machine, bytecode * code);
+void vm_execute_call_builtin(vm * machine, bytecode * code);
 void vm_execute_lt(vm * machine, bytecode * code);
 void vm_execute_gt(vm * machine, bytecode * code);
+void vm_execute_switch_on_term(vm * machine, bytecode * code);
+void vm_execute_switch_on_const(vm * machine, bytecode * code);
+void vm_execute_switch_on_struct(vm * machine, bytecode * code);
+void vm_execute_case_const(vm * machine, bytecode * code);
+void vm_execute_case_struct(vm * machine, bytecode * code);
+void vm_execute_case_struct_addr(vm * machine, bytecode * code);
+void vm_execute_put_ref_ref(vm * machine, bytecode * code);
+void vm_execute_put_ref_int(vm * machine, bytecode * code);
+void vm_execute_put_ref_u_atom(vm * machine, bytecode * code);
+void vm_execute_put_ref_u_struct_addr(vm * machine, bytecode * code);
+void vm_execute_son_u_var(vm * machine, bytecode * code);
 
 const char * vm_state_to_str(vm_state state);
+const char * vm_dispatch_to_str(vm_dispatch dispatch);
+const char * vm_occurs_check_to_str(vm_occurs_check occurs_check);
 
 #endif /* __VM_H__ */
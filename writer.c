@@ -0,0 +1,432 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "writer.h"
+#include "builtin.h"
+#include "object.h"
+
+writer * writer_new(FILE * file, writer_format format)
+{
+    writer * value = (writer *)malloc(sizeof(writer));
+
+    value->file = file;
+    value->format = format;
+
+    value->capacity = 2 * WRITER_FLUSH_SIZE;
+    value->size = 0;
+    value->buf = (char *)malloc(value->capacity);
+
+    value->item_size = 64;
+    value->item_top = 0;
+    value->items = (writer_item *)malloc(sizeof(writer_item) * value->item_size);
+
+    value->strtab_array = NULL;
+    value->strtab_size = 0;
+    value->nil = 0;
+    value->binary_value = NULL;
+    value->segment_value = NULL;
+
+    return value;
+}
+
+void writer_delete(writer * value)
+{
+    writer_flush(value);
+    free(value->buf);
+    free(value->items);
+    free(value);
+}
+
+void writer_set_binary(writer * value, const gencode_binary * binary_value)
+{
+    unsigned int i;
+
+    value->strtab_array = binary_value->strtab_array;
+    value->strtab_size = binary_value->strtab_size;
+    value->binary_value = binary_value;
+
+    value->nil = value->strtab_size;
+    for (i = 0; i < value->strtab_size; i++)
+    {
+        if (value->strtab_array[i] != NULL && strcmp(value->strtab_array[i], "[]") == 0)
+        {
+            value->nil = i;
+            break;
+        }
+    }
+}
+
+void writer_set_segment(writer * value, const gencode_segment * segment_value)
+{
+    value->segment_value = segment_value;
+}
+
+/* name of atom from binary or segment, NULL if not known */
+static const char * writer_atom_name(writer * value, atom_idx_t idx)
+{
+    const gencode_segment * segment_value = value->segment_value;
+
+    if (value->strtab_array != NULL && idx < value->strtab_size)
+    {
+        return value->strtab_array[idx];
+    }
+    if (segment_value != NULL && idx >= segment_value->strtab_addr &&
+        idx - segment_value->strtab_addr < segment_value->strtab_size)
+    {
+        return segment_value->strtab_array[idx - segment_value->strtab_addr];
+    }
+    return NULL;
+}
+
+void writer_flush(writer * value)
+{
+    if (value->size > 0)
+    {
+        fwrite(value->buf, 1, value->size, value->file);
+        value->size = 0;
+    }
+    fflush(value->file);
+}
+
+static void writer_reserve(writer * value, size_t len)
+{
+    if (value->size + len > value->capacity)
+    {
+        while (value->size + len > value->capacity)
+        {
+            value->capacity *= 2;
+        }
+        value->buf = (char *)realloc(value->buf, value->capacity);
+    }
+}
+
+static inline void writer_char(writer * value, char c)
+{
+    writer_reserve(value, 1);
+    value->buf[value->size++] = c;
+}
+
+static void writer_mem(writer * value, const char * str, size_t len)
+{
+    writer_reserve(value, len);
+    memcpy(value->buf + value->size, str, len);
+    value->size += len;
+}
+
+void writer_str(writer * value, const char * str)
+{
+    writer_mem(value, str, strlen(str));
+    if (value->size >= WRITER_FLUSH_SIZE)
+    {
+        writer_flush(value);
+    }
+}
+
+static void writer_uint(writer * value, unsigned int number)
+{
+    char digits[10];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    writer_reserve(value, n);
+    while (n > 0)
+    {
+        value->buf[value->size++] = digits[--n];
+    }
+}
+
+static void writer_int(writer * value, int number)
+{
+    if (number < 0)
+    {
+        writer_char(value, '-');
+        writer_uint(value, 0u - (unsigned int)number);
+    }
+    else
+    {
+        writer_uint(value, (unsigned int)number);
+    }
+}
+
+static void writer_push(writer * value, writer_item_type type, heap_ptr addr, const char * text)
+{
+    if (value->item_top == value->item_size)
+    {
+        value->item_size *= 2;
+        value->items = (writer_item *)realloc(value->items, sizeof(writer_item) * value->item_size);
+    }
+    value->items[value->item_top].type = type;
+    value->items[value->item_top].addr = addr;
+    value->items[value->item_top].text = text;
+    value->item_top++;
+}
+
+static inline heap_ptr writer_deref(gc * collector, heap_ptr addr)
+{
+    gc_heap cell = GC_CELL(collector, addr);
+    while (GC_CELL_TAG(cell) == GC_TAG_REF && GC_CELL_VALUE(cell) != addr)
+    {
+        addr = (heap_ptr)GC_CELL_VALUE(cell);
+        cell = GC_CELL(collector, addr);
+    }
+    return addr;
+}
+
+/* same lines as gc_print_ref_str */
+static void writer_object(writer * value, gc * collector, heap_ptr addr)
+{
+    gc_heap cell = GC_CELL(collector, addr);
+    switch (GC_CELL_TAG(cell))
+    {
+        case GC_TAG_EMPTY:
+            writer_mem(value, "OBJECT_UNKNOWN\n", 15);
+        break;
+        case GC_TAG_ATOM:
+        {
+            atom_idx_t idx = (atom_idx_t)GC_CELL_VALUE(cell);
+            const char * name = writer_atom_name(value, idx);
+            writer_mem(value, "OBJECT_ATOM ", 12);
+            writer_uint(value, idx);
+            if (name != NULL)
+            {
+                writer_char(value, ':');
+                writer_mem(value, name, strlen(name));
+            }
+            writer_char(value, '\n');
+        }
+        break;
+        case GC_TAG_INT:
+            writer_mem(value, "OBJECT_INT ", 11);
+            writer_int(value, GC_CELL_INT(cell));
+            writer_char(value, '\n');
+        break;
+        case GC_TAG_REF:
+        break;
+        case GC_TAG_STRUCT:
+        {
+            heap_size_t i = GC_CELL_STRUCT_SIZE(cell);
+            writer_mem(value, "OBJECT_STRUCT/", 14);
+            writer_uint(value, i);
+            writer_char(value, '\n');
+            for (; i > 0; i--)
+            {
+                writer_push(value, WRITER_ITEM_TERM, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + i)), NULL);
+            }
+        }
+        break;
+    }
+}
+
+/* atoms other than [] and lower case words are quoted */
+static void writer_atom(writer * value, atom_idx_t idx)
+{
+    const char * name = NULL;
+    const char * c = NULL;
+
+    name = writer_atom_name(value, idx);
+    if (name == NULL)
+    {
+        writer_char(value, '$');
+        writer_uint(value, idx);
+        return;
+    }
+
+    if (idx == value->nil)
+    {
+        writer_mem(value, "[]", 2);
+        return;
+    }
+    for (c = name; *c != '\0'; c++)
+    {
+        if (!((*c >= 'a' && *c <= 'z') ||
+              (c != name && ((*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_'))))
+        {
+            break;
+        }
+    }
+    if (*c == '\0' && c != name)
+    {
+        writer_mem(value, name, c - name);
+        return;
+    }
+
+    writer_char(value, '\'');
+    for (c = name; *c != '\0'; c++)
+    {
+        if (*c == '\'' || *c == '\\')
+        {
+            writer_char(value, '\\');
+        }
+        writer_char(value, *c);
+    }
+    writer_char(value, '\'');
+}
+
+/* name of structure from predicate with the same address */
+static void writer_functor(writer * value, pc_ptr addr)
+{
+    const gencode_predicate * predicate = value->binary_value != NULL ?
+                                    gencode_binary_predicate(value->binary_value, addr) : NULL;
+    if (predicate != NULL)
+    {
+        writer_atom(value, predicate->name);
+    }
+    else
+    {
+        writer_char(value, '$');
+        writer_uint(value, addr);
+    }
+}
+
+static inline char writer_is_list(gc_heap cell)
+{
+    return GC_CELL_TAG(cell) == GC_TAG_STRUCT &&
+           GC_CELL_STRUCT_ADDR(cell) == BUILTIN_LIST_ADDR &&
+           GC_CELL_STRUCT_SIZE(cell) == 2;
+}
+
+/* f(a,[1,2|T],_G12) */
+static void writer_canonical(writer * value, gc * collector, writer_item item)
+{
+    heap_ptr addr = writer_deref(collector, item.addr);
+    gc_heap cell = GC_CELL(collector, addr);
+
+    if (item.type == WRITER_ITEM_TAIL)
+    {
+        if (GC_CELL_TAG(cell) == GC_TAG_ATOM && GC_CELL_VALUE(cell) == value->nil)
+        {
+            return;
+        }
+        if (writer_is_list(cell))
+        {
+            writer_char(value, ',');
+            writer_push(value, WRITER_ITEM_TAIL, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + 2)), NULL);
+            writer_push(value, WRITER_ITEM_TERM, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + 1)), NULL);
+            return;
+        }
+        writer_char(value, '|');
+    }
+
+    switch (GC_CELL_TAG(cell))
+    {
+        case GC_TAG_EMPTY:
+            writer_char(value, '?');
+        break;
+        case GC_TAG_ATOM:
+            writer_atom(value, (atom_idx_t)GC_CELL_VALUE(cell));
+        break;
+        case GC_TAG_INT:
+            writer_int(value, GC_CELL_INT(cell));
+        break;
+        case GC_TAG_REF:
+            writer_mem(value, "_G", 2);
+            writer_uint(value, addr);
+        break;
+        case GC_TAG_STRUCT:
+        {
+            heap_size_t i = GC_CELL_STRUCT_SIZE(cell);
+            if (writer_is_list(cell))
+            {
+                writer_char(value, '[');
+                writer_push(value, WRITER_ITEM_TEXT, 0, "]");
+                writer_push(value, WRITER_ITEM_TAIL, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + 2)), NULL);
+                writer_push(value, WRITER_ITEM_TERM, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + 1)), NULL);
+                break;
+            }
+            writer_functor(value, GC_CELL_STRUCT_ADDR(cell));
+            if (i == 0)
+            {
+                break;
+            }
+            writer_char(value, '(');
+            writer_push(value, WRITER_ITEM_TEXT, 0, ")");
+            for (; i > 0; i--)
+            {
+                writer_push(value, WRITER_ITEM_TERM, (heap_ptr)GC_CELL_VALUE(GC_CELL(collector, addr + i)), NULL);
+                if (i > 1)
+                {
+                    writer_push(value, WRITER_ITEM_TEXT, 0, ",");
+                }
+            }
+        }
+        break;
+    }
+}
+
+void writer_term(writer * value, gc * collector, heap_ptr addr)
+{
+    unsigned int bottom = value->item_top;
+
+    writer_push(value, WRITER_ITEM_TERM, addr, NULL);
+    while (value->item_top > bottom)
+    {
+        writer_item item = value->items[--value->item_top];
+
+        if (item.type == WRITER_ITEM_TEXT)
+        {
+            writer_mem(value, item.text, strlen(item.text));
+        }
+        else if (value->format == WRITER_FORMAT_OBJECT)
+        {
+            writer_object(value, collector, writer_deref(collector, item.addr));
+        }
+        else
+        {
+            writer_canonical(value, collector, item);
+        }
+
+        if (value->size >= WRITER_FLUSH_SIZE)
+        {
+            writer_flush(value);
+        }
+    }
+}
+
+/* values of query variables */
+void writer_answer(writer * value, gc * collector, gc_stack * args, unsigned int size)
+{
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+    {
+        if (value->format == WRITER_FORMAT_CANONICAL && i > 0)
+        {
+            writer_mem(value, ", ", 2);
+        }
+        writer_term(value, collector, args[i].addr);
+    }
+    if (value->format == WRITER_FORMAT_OBJECT)
+    {
+        writer_str(value, "-----------------\n");
+    }
+    else
+    {
+        writer_str(value, size > 0 ? "\n" : "yes\n");
+    }
+}
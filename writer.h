@@ -0,0 +1,83 @@
+/**
+ * Copyright 2023 Slawomir Maludzinski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <stdio.h>
+#include "vm_types.h"
+#include "gencode.h"
+#include "gc.h"
+
+/**
+ * Term writer. Output is collected in a growable buffer and written to
+ * file in blocks of WRITER_FLUSH_SIZE bytes. Terms are walked with an
+ * explicit stack of items so deep terms and long lists do not recurse.
+ */
+#define WRITER_FLUSH_SIZE (64 * 1024)
+
+typedef enum writer_format {
+    WRITER_FORMAT_OBJECT = 0, /* one object per line, OBJECT_ATOM 1:a */
+    WRITER_FORMAT_CANONICAL = 1 /* term syntax, one answer per line */
+} writer_format;
+
+typedef enum writer_item_type {
+    WRITER_ITEM_TERM = 0,
+    WRITER_ITEM_TAIL = 1, /* rest of list after an element */
+    WRITER_ITEM_TEXT = 2
+} writer_item_type;
+
+typedef struct writer_item {
+    writer_item_type type;
+    heap_ptr addr;
+    const char * text;
+} writer_item;
+
+typedef struct writer {
+    FILE * file;
+    writer_format format;
+
+    char * buf;
+    size_t size;
+    size_t capacity;
+
+    writer_item * items;
+    unsigned int item_top;
+    unsigned int item_size;
+
+    char ** strtab_array;
+    unsigned int strtab_size;
+    atom_idx_t nil; /* index of [] or strtab_size when program has none */
+    const gencode_binary * binary_value; /* names of structures */
+    const gencode_segment * segment_value; /* atoms added by query segment, may be NULL */
+} writer;
+
+writer * writer_new(FILE * file, writer_format format);
+void writer_delete(writer * value);
+void writer_set_binary(writer * value, const gencode_binary * binary_value);
+void writer_set_segment(writer * value, const gencode_segment * segment_value);
+
+void writer_str(writer * value, const char * str);
+void writer_term(writer * value, gc * collector, heap_ptr addr);
+void writer_answer(writer * value, gc * collector, gc_stack * args, unsigned int size);
+void writer_flush(writer * value);
+
+#endif /* __WRITER_H__ */